@@ -3,6 +3,7 @@
 #include "core/DiagnosticEmitter.h"
 #include "core/Expression.h"
 #include "core/IR.h"
+#include "core/IRBuilder.h"
 #include "core/Task.h"
 #include "core/CLIDriver.h"
 #include "core/OutputHandlerBase.h"
@@ -13,6 +14,7 @@
 #include <QJsonObject>
 #include <QDebug>
 
+#include <cmath>
 #include <stdexcept>
 #include <memory>
 
@@ -30,6 +32,17 @@ const QString STR_EXPR_TYPE_VAR_READ = QStringLiteral("VariableRead");
 const QString STR_EXPR_TYPE_VAR_ADDR = QStringLiteral("VariableAddress");
 const QString STR_EXPR_LITERAL_VALUE = QStringLiteral("LiteralValue");
 const QString STR_EXPR_VAR_NAME      = QStringLiteral("VariableName");
+const QString STR_EXPR_TYPE_NODE_OF_TYPE        = QStringLiteral("NodeOfType");
+const QString STR_EXPR_TYPE_NODE_COUNT_OF_TYPE  = QStringLiteral("NodeCountOfType");
+const QString STR_EXPR_NODE_TYPE_NAME           = QStringLiteral("NodeTypeName");
+const QString STR_EXPR_ORDINAL                  = QStringLiteral("Ordinal");
+const QString STR_EXPR_TYPE_CHILD_WITH_KEY      = QStringLiteral("ChildWithKey");
+const QString STR_EXPR_TYPE_CHILD_COUNT_WITH_KEY= QStringLiteral("ChildCountWithKey");
+const QString STR_EXPR_NODE                     = QStringLiteral("Node");
+const QString STR_EXPR_CHILD_NAME               = QStringLiteral("ChildName");
+const QString STR_EXPR_KEY_NAME                 = QStringLiteral("KeyName");
+const QString STR_EXPR_KEY_TYPE                 = QStringLiteral("KeyType");
+const QString STR_EXPR_KEY                      = QStringLiteral("Key");
 const QString STR_DECL_INITIALIZER   = QStringLiteral("Initializer");
 const QString STR_FUNCTION_PARAM_REQ = QStringLiteral("ParameterRequired");
 const QString STR_FUNCTION_PARAM_OPT = QStringLiteral("ParameterOptional");
@@ -60,6 +73,7 @@ const QString STR_STMT_LABEL         = QStringLiteral("LabelPseudoStatement");
 const QString STR_STMT_LABEL_NAME    = QStringLiteral("LabelName");
 const QString STR_IRNODE_PARAM       = QStringLiteral("Parameter");
 const QString STR_IRNODE_PARAM_UNIQUE= QStringLiteral("Unique");
+const QString STR_IRNODE_PARAM_INDEXED=QStringLiteral("Indexed");
 const QString STR_IRNODE_KEY         = QStringLiteral("PrimaryKey");
 const QString STR_IRNODE_CHILD       = QStringLiteral("Child");
 const QString STR_IRROOT_NODE        = QStringLiteral("Node");
@@ -131,6 +145,24 @@ int getExpression(DiagnosticEmitterBase& diagnostic, const QJsonObject& json, Fu
     }else if(exprTy == STR_EXPR_TYPE_VAR_ADDR){
         QString name = json.value(STR_EXPR_VAR_NAME).toString();
         return f.addExpression(new VariableAddressExpression(name));
+    }else if(exprTy == STR_EXPR_TYPE_NODE_OF_TYPE){
+        QString nodeTypeName = json.value(STR_EXPR_NODE_TYPE_NAME).toString();
+        int ordinalExprIndex = getExpression(diagnostic, json.value(STR_EXPR_ORDINAL).toObject(), f);
+        return f.addExpression(new NodeOfTypeExpression(nodeTypeName, ordinalExprIndex));
+    }else if(exprTy == STR_EXPR_TYPE_NODE_COUNT_OF_TYPE){
+        QString nodeTypeName = json.value(STR_EXPR_NODE_TYPE_NAME).toString();
+        return f.addExpression(new NodeCountOfTypeExpression(nodeTypeName));
+    }else if(exprTy == STR_EXPR_TYPE_CHILD_WITH_KEY || exprTy == STR_EXPR_TYPE_CHILD_COUNT_WITH_KEY){
+        QString childName = json.value(STR_EXPR_CHILD_NAME).toString();
+        QString keyField = json.value(STR_EXPR_KEY_NAME).toString();
+        ValueType keyTy = getValueTypeFromString(diagnostic, json.value(STR_EXPR_KEY_TYPE).toString());
+        int srcExprIndex = getExpression(diagnostic, json.value(STR_EXPR_NODE).toObject(), f);
+        int keyExprIndex = getExpression(diagnostic, json.value(STR_EXPR_KEY).toObject(), f);
+        if(exprTy == STR_EXPR_TYPE_CHILD_COUNT_WITH_KEY){
+            return f.addExpression(new ChildCountWithKeyExpression(childName, keyField, keyTy, srcExprIndex, keyExprIndex));
+        }
+        int ordinalExprIndex = getExpression(diagnostic, json.value(STR_EXPR_ORDINAL).toObject(), f);
+        return f.addExpression(new ChildNodeWithKeyExpression(childName, keyField, keyTy, srcExprIndex, keyExprIndex, ordinalExprIndex));
     }
 
     diagnostic(Diag::Error_Json_UnknownType_String, exprTy);
@@ -285,7 +317,8 @@ IRNodeType* getIRNodeType(DiagnosticEmitterBase& diagnostic, const QJsonObject&
         QString paramName = entry.value(STR_NAME).toString();
         ValueType paramTy = getValueTypeFromString(diagnostic, entry.value(STR_TYPE).toString());
         bool isUnique = entry.value(STR_IRNODE_PARAM_UNIQUE).toBool(false);
-        ptr->addParameter(paramName, paramTy, isUnique);
+        bool isIndexed = entry.value(STR_IRNODE_PARAM_INDEXED).toBool(false);
+        ptr->addParameter(paramName, paramTy, isUnique, isIndexed);
     }
     QJsonValue primaryKeyVal = json.value(STR_IRNODE_KEY);
     if(primaryKeyVal.isString()){
@@ -454,20 +487,46 @@ IRRootInstance* Bundle::readIRFromJson(int irIndex, const QByteArray& json, Diag
     }
     try {
         const IRRootType& rootTy = *irTypes.at(irIndex);
-        std::unique_ptr<IRRootInstance> ptr(new IRRootInstance(rootTy));
+        IRBuilder builder(rootTy, nodeArray.size());
         for(auto iter = nodeArray.begin(), iterEnd = nodeArray.end(); iter != iterEnd; ++iter){
             QJsonObject node = iter->toObject();
             QString nodeTypeName = node.value(STR_TYPE).toString();
             int typeIndex = rootTy.getNodeTypeIndex(nodeTypeName);
-            int nodeIndex = ptr->addNode(typeIndex);
-            IRNodeInstance& inst = ptr->getNode(nodeIndex);
             int parentIndex = node.value(STR_INSTANCE_PARENT).toInt();
-            inst.setParent(parentIndex);
-            inst.setParameters(node.value(STR_INSTANCE_PARAM).toArray().toVariantList());
-            if(parentIndex >= 0){
-                ptr->getNode(parentIndex).addChildNode(nodeIndex);
+            int nodeIndex = builder.addNode(typeIndex, parentIndex);
+            if(Q_UNLIKELY(nodeIndex == -1)){
+                // nodes must be in pre-order
+                return nullptr;
+            }
+            // convert parameters according to parameter type in IR; mismatches are reported by validate()
+            QJsonArray paramArray = node.value(STR_INSTANCE_PARAM).toArray();
+            QList<IRParameterValue> params;
+            params.reserve(paramArray.size());
+            for(int i = 0, n = paramArray.size(); i < n; ++i){
+                QJsonValue param = paramArray.at(i);
+                ValueType paramTy = ValueType::Void;
+                if(rootTy.isNodeTypeIndexValid(typeIndex) && i < rootTy.getNodeType(typeIndex).getNumParameter()){
+                    paramTy = rootTy.getNodeType(typeIndex).getParameterType(i);
+                }
+                if(paramTy == ValueType::Int64 && param.isDouble()){
+                    // JSON numbers are doubles; only integers that are exactly representable are accepted,
+                    // others are left as a type mismatch instead of being truncated or rounded
+                    const double maxExactInteger = 9007199254740992.0; // 2^53
+                    double value = param.toDouble();
+                    if(std::isfinite(value) && std::floor(value) == value && std::fabs(value) <= maxExactInteger){
+                        params.push_back(IRParameterValue(static_cast<qint64>(value)));
+                    }else{
+                        params.push_back(IRParameterValue());
+                    }
+                }else if(paramTy == ValueType::String && param.isString()){
+                    params.push_back(IRParameterValue(param.toString()));
+                }else{
+                    params.push_back(IRParameterValue());
+                }
             }
+            builder.setParameters(nodeIndex, params);
         }
+        std::unique_ptr<IRRootInstance> ptr(builder.finish());
         if(ptr->validate(diagnostic)){
             return ptr.release();
         }
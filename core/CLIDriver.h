@@ -1,7 +1,14 @@
 #ifndef CLIDRIVER_H
 #define CLIDRIVER_H
 
+#include <QString>
+
 // currently in core/test.cpp
 void testerEntry();
+void stressTestEntry();
+
+// in core/IRCodegen.cpp
+// write a C++ accessor header (see IRCodegen::generateHeader()) for each IR type in the bundle; return 0 on success
+int generateIRHeaderEntry(const QString& bundlePath, const QString& outputDir);
 
 #endif // CLIDRIVER_H
@@ -2,6 +2,9 @@
 
 #include <QDebug>
 
+#include <memory>
+#include <vector>
+
 DiagnosticPathNode::DiagnosticPathNode(DiagnosticEmitterBase& d, const QString& pathName)
     : d(d), prev(d.head), pathName(pathName), hierarchyIndex(d.hierarchyCount)
 {
@@ -116,6 +119,39 @@ void ConsoleDiagnosticEmitter::diagnosticHandle(Diag::ID id, const QList<QVarian
     testDump(pathList, QStringLiteral("Diagnostic"), Diag::getString(id), QString(), optionalText);
 }
 
+void RecordingDiagnosticEmitter::diagnosticHandle(Diag::ID id, const QList<QVariant>& data)
+{
+    Record record{id, data, QList<PathEntry>()};
+    auto ptr = currentHead();
+    // skip the first pushed node; it is the replay target's head
+    while(ptr && ptr->getPrev()){
+        record.path.push_front(PathEntry{ptr->getPathName(), ptr->getDetailedName()});
+        ptr = ptr->getPrev();
+    }
+    records.push_back(record);
+}
+
+void RecordingDiagnosticEmitter::replay(DiagnosticEmitterBase& dest, const QString& rootDetailedName) const
+{
+    if(!rootDetailedName.isEmpty()){
+        dest.setDetailedName(rootDetailedName);
+    }
+    for(const auto& record : records){
+        // path nodes must be destructed in reverse order of construction
+        std::vector<std::unique_ptr<DiagnosticPathNode>> pathNodes;
+        pathNodes.reserve(static_cast<std::size_t>(record.path.size()));
+        for(const auto& entry : record.path){
+            pathNodes.emplace_back(new DiagnosticPathNode(dest, entry.pathName));
+            pathNodes.back()->setDetailedName(entry.detailedName);
+        }
+        dest.handle(record.id, record.data);
+        while(!pathNodes.empty()){
+            pathNodes.back()->pop();
+            pathNodes.pop_back();
+        }
+    }
+}
+
 /*
 DiagnosticEmitter::DiagnosticEmitter(QObject *parent) : QObject(parent)
 {
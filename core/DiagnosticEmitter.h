@@ -48,6 +48,7 @@ public:
         Error_IR_BadTree_ConflictingParentReference,        //!< [ChildNodeIndex][ParentIndexFromChild][ParentIndexFromTraversal]
         Error_IR_BadTree_BadNodeTypeIndex,                  //!< [NodeIndex][NodeTypeIndex]
         Error_IR_BadTree_UnreachableNode,                   //!< [NodeIndex]
+        Error_IR_BadTree_NotPreOrder,                       //!< [NodeIndex][ExpectedNodeIndex]
 
         Error_Task_BadInitializer_ExternVariable,           //!< [VarName][VarType][InitializerType]
         Error_Task_NameClash_ExternVariable,                //!< [VarName][FirstDeclIndex][SecondDeclIndex]
@@ -99,7 +100,9 @@ public:
         Error_Exec_BadTraverse_PrimaryKeyTypeMismatch,      //!< [ProvidedKeyTy][ActualKeyTy][ChildNodeTypeName][KeyName][PtrDescriptionString]
         Error_Exec_BadTraverse_ParameterNotFound,           //!< [ChildNodeTypeName][KeyName][PtrDescriptionString]
         Error_Exec_BadTraverse_ParameterNotUnique,          //!< [ChildNodeTypeName][KeyName][PtrDescriptionString]
+        Error_Exec_BadTraverse_ParameterNotIndexed,         //!< [ChildNodeTypeName][KeyName][PtrDescriptionString]
         Error_Exec_BadTraverse_UniqueKeyTypeMismatch,       //!< [ProvidedKeyTy][ActualKeyTy][ChildNodeTypeName][KeyName][PtrDescriptionString]
+        Error_Exec_BadReference_NodeType,                   //!< [NodeTypeName]
         Error_Exec_Unreachable,                             //!< (no argument)
         Error_Exec_Assign_InvalidLHSType,                   //!< [ProvidedLHSType]
         Error_Exec_Output_Unknown_String,                   //!< [OutputString]
@@ -172,6 +175,7 @@ public:
         Warn_Parser_UnreachableNode,                        //!< [ParserNodeName]
 
         Warn_Parser_Matching_Ambiguous,                     //!< [InputString], [list of tuple of [NodeName][NodeParamStringList][PatternIndex]]
+        Warn_Parser_Matching_AmbiguousSummary,              //!< [OccurrenceCount][SampleCount], [list of tuple of [NodeName][PatternIndex]]
 
         Error_Parser_Matching_NoMatch,                      //!< (no argument)
         Error_Parser_Matching_GarbageAtEnd,                 //!< (no argument)
@@ -208,6 +212,17 @@ public:
         Error_XML_IRNode_Param_MultipleValue,       //!< [LineNumber][ColumnNumber][ParameterName]
         Error_XML_IRNode_ParamAfterChildNode,       //!< [LineNumber][ColumnNumber]
 
+        Error_Binary_BadHeader,                     //!< (no argument)
+        Error_Binary_UnsupportedVersion,            //!< [FileVersion][SupportedVersion]
+        Error_Binary_MismatchedIRType,              //!< [ExpectedIRRootTypeName]
+        Error_Binary_Truncated,                     //!< [SectionName]
+        Error_Binary_BadData,                       //!< [SectionName]
+        Error_Binary_NotValidated,                  //!< (no argument)
+        Error_Binary_CannotOpenFile,                //!< [FileName][ErrorString]
+
+        Error_Codegen_IdentifierCollision,          //!< [Identifier][FirstName][SecondName]
+        Error_Codegen_CannotOpenFile,               //!< [FileName][ErrorString]
+
         InvalidID
     };
     Q_ENUM(ID)
@@ -364,6 +379,40 @@ public:
     virtual void diagnosticHandle(Diag::ID id, const QList<QVariant>& data) override;
 };
 
+/**
+ * @brief The RecordingDiagnosticEmitter class buffers diagnostics so that they can be replayed to another emitter later
+ *
+ * This is used when diagnostics are generated on worker threads and must be merged in a deterministic order.
+ * The path node pushed first on this emitter corresponds to the current head of the replay target;
+ * its detailed name is applied to the target's head, and deeper path nodes are pushed again for each diagnostic.
+ */
+class RecordingDiagnosticEmitter: public DiagnosticEmitterBase
+{
+public:
+    virtual ~RecordingDiagnosticEmitter() override {}
+    virtual void diagnosticHandle(Diag::ID id, const QList<QVariant>& data) override;
+
+    bool isEmpty() const {return records.isEmpty();}
+
+    /**
+     * @brief replay send all recorded diagnostics to dest, in the order they are generated
+     * @param rootDetailedName detailed name of the first pushed path node on this emitter; applied to dest's head if not empty
+     */
+    void replay(DiagnosticEmitterBase& dest, const QString& rootDetailedName = QString()) const;
+
+private:
+    struct PathEntry{
+        QString pathName;
+        QString detailedName;
+    };
+    struct Record{
+        Diag::ID id;
+        QList<QVariant> data;
+        QList<PathEntry> path; //!< path nodes below the first pushed one, outermost first
+    };
+    QList<Record> records;
+};
+
 /*
 class DiagnosticEmitter : public QObject
 {
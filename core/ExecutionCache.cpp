@@ -0,0 +1,17 @@
+#include "core/ExecutionCache.h"
+
+int ExecutionCache::getNumEntry() const
+{
+    int count = 0;
+    for(const auto& passEntries : entries){
+        count += passEntries.size();
+    }
+    return count;
+}
+
+void ExecutionCache::clear()
+{
+    taskGeneration = 0;
+    entries.clear();
+    pendingEntries.clear();
+}
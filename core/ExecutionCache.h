@@ -0,0 +1,50 @@
+#ifndef EXECUTIONCACHE_H
+#define EXECUTIONCACHE_H
+
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <QVariant>
+#include <QVector>
+
+/**
+ * @brief The ExecutionCache class keeps results of subtree traversals across ExecutionContext runs
+ *
+ * For each pass and subtree content hash (IRRootInstance::getSubtreeHash()) it records the output produced
+ * by traversing the subtree and the node members of the subtree afterwards. A later run of the same Task
+ * (same Task::getGeneration(); the cache is cleared otherwise) reuses them instead of executing callbacks in an unchanged subtree, so re-running on a slightly edited
+ * document only executes the changed subtrees and their ancestors.
+ *
+ * It is only used when the task is subtree-local (Task::isSubtreeLocal()) and the instance has subtree hash
+ * enabled; otherwise execution proceeds as if there is no cache.
+ * Diagnostics (e.g. warnings) from callbacks in a reused subtree are not emitted again.
+ */
+class ExecutionCache
+{
+    friend class ExecutionContext;
+public:
+    ExecutionCache() = default;
+
+    /**
+     * @brief setMinimumSubtreeSize set the minimum number of nodes for a subtree to be cached
+     *
+     * Small subtrees are cheaper to execute than to record.
+     */
+    void setMinimumSubtreeSize(int size) {minimumSubtreeSize = size;}
+
+    int getNumEntry() const;
+    void clear();
+
+private:
+    struct Entry{
+        QList<QString> outputs;                 //!< outputs from the traversal of the subtree, in order
+        QList<QList<QVariant>> nodeMembers;     //!< node members of all nodes in the subtree after traversal, in pre-order
+    };
+
+    quint64 taskGeneration = 0;                     //!< Task::getGeneration() of the task the entries are from
+    int minimumSubtreeSize = 8;
+    QVector<QHash<quint64, Entry>> entries;         //!< [pass] -> (subtree hash -> entry), from last successful run
+    QVector<QHash<quint64, Entry>> pendingEntries;  //!< [pass] -> (subtree hash -> entry), of the current run
+};
+
+#endif // EXECUTIONCACHE_H
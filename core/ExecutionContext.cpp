@@ -1,22 +1,43 @@
 #include "core/ExecutionContext.h"
 
 #include "core/DiagnosticEmitter.h"
+#include "core/ExecutionCache.h"
 #include "core/Expression.h"
 #include "core/IR.h"
 #include "core/OutputHandlerBase.h"
 #include "core/Task.h"
+#include "util/MemoryUsage.h"
 
 #include <stdexcept>
 
 ExecutionContext::ExecutionContext(const Task& t, const IRRootInstance &root, DiagnosticEmitterBase& diagnostic, OutputHandlerBase& out, QObject* parent)
+    : QObject(parent),
+      rootReader(new IRRootInstanceReader(root)),
+      t(t),
+      root(*rootReader),
+      diagnostic(diagnostic),
+      out(out)
+{
+    initialize();
+}
+
+ExecutionContext::ExecutionContext(const Task& t, const IRInstanceReaderBase& root, DiagnosticEmitterBase& diagnostic, OutputHandlerBase& out, QObject* parent)
     : QObject(parent),
       t(t),
       root(root),
       diagnostic(diagnostic),
       out(out)
+{
+    initialize();
+}
+
+ExecutionContext::~ExecutionContext()
+{
+}
+
+void ExecutionContext::initialize()
 {
     Q_ASSERT(t.validated());
-    Q_ASSERT(root.validated());
 
     // initialize global variables
     int gvCnt = t.getNumGlobalVariable();
@@ -33,7 +54,7 @@ ExecutionContext::ExecutionContext(const Task& t, const IRRootInstance &root, Di
     nodeMembers.reserve(nodeCount);
     QHash<int, QList<QVariant>> initializerListTemplate;//[nodeTypeIndex] -> combined member initialization list
     for(int i = 0; i < nodeCount; ++i){
-        int typeIndex = root.getNode(i).getTypeIndex();
+        int typeIndex = root.getTypeIndex(i);
         auto iter = initializerListTemplate.find(typeIndex);
         if(iter == initializerListTemplate.end()){
             QList<QVariant> initializerList;
@@ -52,13 +73,13 @@ ExecutionContext::ExecutionContext(const Task& t, const IRRootInstance &root, Di
     currentActivationCount = 0;
 }
 
-bool ExecutionContext::read(const QString& name, ValueType& ty, QVariant& val)
+bool ExecutionContext::read(int symbol, ValueType& ty, QVariant& val)
 {
     Q_ASSERT(!stack.empty());
     const auto& frame = stack.top();
 
     {
-        int localVariableIndex = frame.f.getLocalVariableIndex(name);
+        int localVariableIndex = frame.f.getLocalVariableIndex(symbol);
         if(localVariableIndex >= 0){
             ty = frame.f.getLocalVariableType(localVariableIndex);
             val = frame.localVariables.at(localVariableIndex);
@@ -68,7 +89,7 @@ bool ExecutionContext::read(const QString& name, ValueType& ty, QVariant& val)
     }
 
     {
-        int nodeMemberIndex = t.getNodeMemberIndex(frame.irNodeTypeIndex, name);
+        int nodeMemberIndex = t.getNodeMemberIndex(frame.irNodeTypeIndex, symbol);
         if(nodeMemberIndex >= 0){
             ty = t.getNodeMemberType(frame.irNodeTypeIndex, nodeMemberIndex);
             val = nodeMembers.at(frame.irNodeIndex).at(nodeMemberIndex);
@@ -79,18 +100,17 @@ bool ExecutionContext::read(const QString& name, ValueType& ty, QVariant& val)
 
     {
         const auto& nodeTy = root.getType().getNodeType(frame.irNodeTypeIndex);
-        int nodeParameterIndex = nodeTy.getParameterIndex(name);
+        int nodeParameterIndex = t.getNodeParameterIndex(frame.irNodeTypeIndex, symbol);
         if(nodeParameterIndex >= 0){
-            const auto& nodeInst = root.getNode(frame.irNodeIndex);
             ty = nodeTy.getParameterType(nodeParameterIndex);
-            val = nodeInst.getParameter(nodeParameterIndex);
+            val = rootReader? rootReader->getParameter(frame.irNodeIndex, nodeParameterIndex) : root.getParameter(frame.irNodeIndex, nodeParameterIndex);
             checkUninitializedRead(ty, val);
             return true;
         }
     }
 
     {
-        int globalVariableIndex = t.getGlobalVariableIndex(name);
+        int globalVariableIndex = t.getGlobalVariableIndex(symbol);
         if(globalVariableIndex >= 0){
             ty = t.getGlobalVariableType(globalVariableIndex);
             val = globalVariables.at(globalVariableIndex);
@@ -99,7 +119,7 @@ bool ExecutionContext::read(const QString& name, ValueType& ty, QVariant& val)
         }
     }
 
-    diagnostic(Diag::Error_Exec_BadReference_VariableRead, name);
+    diagnostic(Diag::Error_Exec_BadReference_VariableRead, t.getSymbolTable().getName(symbol));
     return false;
 }
 
@@ -138,16 +158,16 @@ bool ExecutionContext::read(const ValuePtrType& valuePtr, ValueType& ty, QVarian
     }/*break;*/
     case ValuePtrType::PtrType::NodeRWMember:{
         ty = t.getNodeMemberType(
-                    /* node type index */root.getNode(valuePtr.nodeIndex).getTypeIndex(),
+                    /* node type index */root.getTypeIndex(valuePtr.nodeIndex),
                     /* member index    */valuePtr.valueIndex);
         val = nodeMembers.at(valuePtr.nodeIndex).at(valuePtr.valueIndex);
         checkUninitializedRead(ty, val);
         return true;
     }/*break;*/
     case ValuePtrType::PtrType::NodeROParameter:{
-        const auto& nodeTy = root.getType().getNodeType(valuePtr.nodeIndex);
+        const auto& nodeTy = root.getType().getNodeType(root.getTypeIndex(valuePtr.nodeIndex));
         ty = nodeTy.getParameterType(valuePtr.valueIndex);
-        val = root.getNode(valuePtr.nodeIndex).getParameter(valuePtr.valueIndex);
+        val = rootReader? rootReader->getParameter(valuePtr.nodeIndex, valuePtr.valueIndex) : root.getParameter(valuePtr.nodeIndex, valuePtr.valueIndex);
         checkUninitializedRead(ty, val);
         return true;
     }/*break;*/
@@ -193,14 +213,14 @@ void ExecutionContext::checkUninitializedRead(ValueType ty, QVariant& readVal)
     }
 }
 
-bool ExecutionContext::takeAddress(const QString& name, ValuePtrType& val)
+bool ExecutionContext::takeAddress(int symbol, ValuePtrType& val)
 {
     Q_ASSERT(!stack.empty());
     const auto& frame = stack.top();
 
     val.head = getPtrSrcHead();
     {
-        int localVariableIndex = frame.f.getLocalVariableIndex(name);
+        int localVariableIndex = frame.f.getLocalVariableIndex(symbol);
         if(localVariableIndex >= 0){
             val.ty = ValuePtrType::PtrType::LocalVariable;
             val.nodeIndex = -1;
@@ -210,7 +230,7 @@ bool ExecutionContext::takeAddress(const QString& name, ValuePtrType& val)
     }
 
     {
-        int nodeMemberIndex = t.getNodeMemberIndex(frame.irNodeTypeIndex, name);
+        int nodeMemberIndex = t.getNodeMemberIndex(frame.irNodeTypeIndex, symbol);
         if(nodeMemberIndex >= 0){
             val.ty = ValuePtrType::PtrType::NodeRWMember;
             val.nodeIndex = frame.irNodeIndex;
@@ -220,8 +240,7 @@ bool ExecutionContext::takeAddress(const QString& name, ValuePtrType& val)
     }
 
     {
-        const auto& nodeTy = root.getType().getNodeType(frame.irNodeTypeIndex);
-        int nodeParameterIndex = nodeTy.getParameterIndex(name);
+        int nodeParameterIndex = t.getNodeParameterIndex(frame.irNodeTypeIndex, symbol);
         if(nodeParameterIndex >= 0){
             val.ty = ValuePtrType::PtrType::NodeROParameter;
             val.nodeIndex = frame.irNodeIndex;
@@ -231,7 +250,7 @@ bool ExecutionContext::takeAddress(const QString& name, ValuePtrType& val)
     }
 
     {
-        int globalVariableIndex = t.getGlobalVariableIndex(name);
+        int globalVariableIndex = t.getGlobalVariableIndex(symbol);
         if(globalVariableIndex >= 0){
             val.ty = ValuePtrType::PtrType::GlobalVariable;
             val.nodeIndex = -1;
@@ -240,11 +259,11 @@ bool ExecutionContext::takeAddress(const QString& name, ValuePtrType& val)
         }
     }
 
-    diagnostic(Diag::Error_Exec_BadReference_VariableTakeAddress, name);
+    diagnostic(Diag::Error_Exec_BadReference_VariableTakeAddress, t.getSymbolTable().getName(symbol));
     return false;
 }
 
-bool ExecutionContext::write(const QString& name, const ValueType& ty, const QVariant& val)
+bool ExecutionContext::write(int symbol, const ValueType& ty, const QVariant& val)
 {
     Q_ASSERT(!stack.empty());
     auto& frame = stack.top();
@@ -252,7 +271,7 @@ bool ExecutionContext::write(const QString& name, const ValueType& ty, const QVa
     QVariant* valPtr = nullptr;
 
     {
-        int localVariableIndex = frame.f.getLocalVariableIndex(name);
+        int localVariableIndex = frame.f.getLocalVariableIndex(symbol);
         if(localVariableIndex >= 0){
             actualTy = frame.f.getLocalVariableType(localVariableIndex);
             valPtr = &frame.localVariables[localVariableIndex];
@@ -260,7 +279,7 @@ bool ExecutionContext::write(const QString& name, const ValueType& ty, const QVa
     }
 
     if(!valPtr){
-        int nodeMemberIndex = t.getNodeMemberIndex(frame.irNodeTypeIndex, name);
+        int nodeMemberIndex = t.getNodeMemberIndex(frame.irNodeTypeIndex, symbol);
         if(nodeMemberIndex >= 0){
             actualTy = t.getNodeMemberType(frame.irNodeTypeIndex, nodeMemberIndex);
             valPtr = &nodeMembers[frame.irNodeIndex][nodeMemberIndex];
@@ -269,16 +288,15 @@ bool ExecutionContext::write(const QString& name, const ValueType& ty, const QVa
 
     // we block write to read-only node parameters
     if(!valPtr){
-        const auto& nodeTy = root.getType().getNodeType(frame.irNodeTypeIndex);
-        int nodeParameterIndex = nodeTy.getParameterIndex(name);
+        int nodeParameterIndex = t.getNodeParameterIndex(frame.irNodeTypeIndex, symbol);
         if(Q_UNLIKELY(nodeParameterIndex >= 0)){
-            diagnostic(Diag::Error_Exec_WriteToConst_WriteNodeParamByName, name);
+            diagnostic(Diag::Error_Exec_WriteToConst_WriteNodeParamByName, t.getSymbolTable().getName(symbol));
             return false;
         }
     }
 
     if(!valPtr){
-        int globalVariableIndex = t.getGlobalVariableIndex(name);
+        int globalVariableIndex = t.getGlobalVariableIndex(symbol);
         if(globalVariableIndex >= 0){
             actualTy = t.getGlobalVariableType(globalVariableIndex);
             valPtr = &globalVariables[globalVariableIndex];
@@ -286,10 +304,10 @@ bool ExecutionContext::write(const QString& name, const ValueType& ty, const QVa
     }
 
     if(Q_UNLIKELY(!valPtr)){
-        diagnostic(Diag::Error_Exec_BadReference_VariableWrite, name);
+        diagnostic(Diag::Error_Exec_BadReference_VariableWrite, t.getSymbolTable().getName(symbol));
         return false;
     }else if(Q_UNLIKELY(actualTy != ty)){
-        diagnostic(Diag::Error_Exec_TypeMismatch_WriteByName, ty, actualTy, name);
+        diagnostic(Diag::Error_Exec_TypeMismatch_WriteByName, ty, actualTy, t.getSymbolTable().getName(symbol));
         return false;
     }else{
         *valPtr = val;
@@ -331,7 +349,7 @@ bool ExecutionContext::write(const ValuePtrType& valuePtr, const ValueType& ty,
     }break;
     case ValuePtrType::PtrType::NodeRWMember:{
         actualTy = t.getNodeMemberType(
-                    /* node type index */root.getNode(valuePtr.nodeIndex).getTypeIndex(),
+                    /* node type index */root.getTypeIndex(valuePtr.nodeIndex),
                     /* member index    */valuePtr.valueIndex);
         valPtr = &nodeMembers[valuePtr.nodeIndex][valuePtr.valueIndex];
     }break;
@@ -379,22 +397,26 @@ bool ExecutionContext::getParentNode(const NodePtrType& src, NodePtrType& result
     }
 
     result.head = getPtrSrcHead();
-    result.nodeIndex = root.getNode(src.nodeIndex).getParentIndex();
+    result.nodeIndex = root.getParentIndex(src.nodeIndex);
     return true;
 }
 
-bool ExecutionContext::getChildNode(const NodePtrType& src, const QString& childName, NodePtrType& result, ValueType keyTy, const QVariant& primaryKey)
+bool ExecutionContext::getChildNode(const NodePtrType& src, int childSymbol, NodePtrType& result, ValueType keyTy, const QVariant& primaryKey)
 {
     if(Q_UNLIKELY(src.nodeIndex < 0)){
         diagnostic(Diag::Error_Exec_BadNodePointer_TraverseToChild, getPointerSrcDescription(src.head));
         return false;
     }
 
-    int childTyIndex = root.getType().getNodeTypeIndex(childName);
+    int childTyIndex = t.getNodeTypeIndex(childSymbol);
+    if(Q_UNLIKELY(childTyIndex < 0)){
+        diagnostic(Diag::Error_Exec_BadReference_NodeType, t.getSymbolTable().getName(childSymbol));
+        return false;
+    }
     const IRNodeType& childTy = root.getType().getNodeType(childTyIndex);
     int primaryKeyIndex = childTy.getPrimaryKeyParameterIndex();
     if(Q_UNLIKELY(primaryKeyIndex < 0)){
-        diagnostic(Diag::Error_Exec_BadTraverse_ChildWithoutPrimaryKey, childName, getNodePtrDescription(src));
+        diagnostic(Diag::Error_Exec_BadTraverse_ChildWithoutPrimaryKey, childTy.getName(), getNodePtrDescription(src));
         return false;
     }
     if(Q_UNLIKELY(childTy.getParameterType(primaryKeyIndex) != keyTy)){
@@ -406,25 +428,30 @@ bool ExecutionContext::getChildNode(const NodePtrType& src, const QString& child
                    getNodePtrDescription(src));
         return false;
     }
-    const IRNodeInstance& inst = root.getNode(src.nodeIndex);
-    int childTyLocalIndex = inst.getLocalTypeIndex(childTyIndex);
-    int childIndex = inst.getChildNodeIndex(childTyLocalIndex, primaryKeyIndex, primaryKey);
+    int childTyLocalIndex = root.getLocalTypeIndex(src.nodeIndex, childTyIndex);
+    int childIndex = root.getChildNodeIndex(src.nodeIndex, childTyLocalIndex, primaryKeyIndex, primaryKey);
 
     result.head = getPtrSrcHead();
     result.nodeIndex = childIndex;
     return true;
 }
 
-bool ExecutionContext::getChildNode(const NodePtrType& src, const QString& childName, NodePtrType& result, const QString& keyField, ValueType keyTy, const QVariant& keyValue)
+bool ExecutionContext::getChildNode(const NodePtrType& src, int childSymbol, NodePtrType& result, int keyFieldSymbol, ValueType keyTy, const QVariant& keyValue)
 {
     if(Q_UNLIKELY(src.nodeIndex < 0)){
         diagnostic(Diag::Error_Exec_BadNodePointer_TraverseToChild, getPointerSrcDescription(src.head));
         return false;
     }
 
-    int childTyIndex = root.getType().getNodeTypeIndex(childName);
+    const QString& childName = t.getSymbolTable().getName(childSymbol);
+    const QString& keyField = t.getSymbolTable().getName(keyFieldSymbol);
+    int childTyIndex = t.getNodeTypeIndex(childSymbol);
+    if(Q_UNLIKELY(childTyIndex < 0)){
+        diagnostic(Diag::Error_Exec_BadReference_NodeType, childName);
+        return false;
+    }
     const IRNodeType& childTy = root.getType().getNodeType(childTyIndex);
-    int paramIndex = childTy.getParameterIndex(keyField);
+    int paramIndex = t.getNodeParameterIndex(childTyIndex, keyFieldSymbol);
     if(Q_UNLIKELY(paramIndex < 0)){
         diagnostic(Diag::Error_Exec_BadTraverse_ParameterNotFound,
                    childName,
@@ -448,15 +475,114 @@ bool ExecutionContext::getChildNode(const NodePtrType& src, const QString& child
                    getNodePtrDescription(src));
         return false;
     }
-    const IRNodeInstance& inst = root.getNode(src.nodeIndex);
-    int childTyLocalIndex = inst.getLocalTypeIndex(childTyIndex);
-    int childIndex = inst.getChildNodeIndex(childTyLocalIndex, paramIndex, keyValue);
+    int childTyLocalIndex = root.getLocalTypeIndex(src.nodeIndex, childTyIndex);
+    int childIndex = root.getChildNodeIndex(src.nodeIndex, childTyLocalIndex, paramIndex, keyValue);
 
     result.head = getPtrSrcHead();
     result.nodeIndex = childIndex;
     return true;
 }
 
+bool ExecutionContext::checkChildKeyLookup(const NodePtrType& src, int childSymbol, int keyFieldSymbol, ValueType keyTy, int& childTyLocalIndex, int& paramIndex)
+{
+    if(Q_UNLIKELY(src.nodeIndex < 0)){
+        diagnostic(Diag::Error_Exec_BadNodePointer_TraverseToChild, getPointerSrcDescription(src.head));
+        return false;
+    }
+
+    const QString& childName = t.getSymbolTable().getName(childSymbol);
+    const QString& keyField = t.getSymbolTable().getName(keyFieldSymbol);
+    int childTyIndex = t.getNodeTypeIndex(childSymbol);
+    if(Q_UNLIKELY(childTyIndex < 0)){
+        diagnostic(Diag::Error_Exec_BadReference_NodeType, childName);
+        return false;
+    }
+    const IRNodeType& childTy = root.getType().getNodeType(childTyIndex);
+    paramIndex = t.getNodeParameterIndex(childTyIndex, keyFieldSymbol);
+    if(Q_UNLIKELY(paramIndex < 0)){
+        diagnostic(Diag::Error_Exec_BadTraverse_ParameterNotFound,
+                   childName,
+                   keyField,
+                   getNodePtrDescription(src));
+        return false;
+    }
+    if(Q_UNLIKELY(!childTy.getParameterIsUnique(paramIndex) && !childTy.getParameterIsIndexed(paramIndex))){
+        diagnostic(Diag::Error_Exec_BadTraverse_ParameterNotIndexed,
+                   childName,
+                   keyField,
+                   getNodePtrDescription(src));
+        return false;
+    }
+    if(Q_UNLIKELY(childTy.getParameterType(paramIndex) != keyTy)){
+        diagnostic(Diag::Error_Exec_BadTraverse_UniqueKeyTypeMismatch,
+                   keyTy,
+                   childTy.getParameterType(paramIndex),
+                   childName,
+                   keyField,
+                   getNodePtrDescription(src));
+        return false;
+    }
+    childTyLocalIndex = root.getLocalTypeIndex(src.nodeIndex, childTyIndex);
+    return true;
+}
+
+bool ExecutionContext::getNumChildNodeWithKey(const NodePtrType& src, int childSymbol, int keyFieldSymbol, ValueType keyTy, const QVariant& keyValue, qint64& result)
+{
+    int childTyLocalIndex = -1;
+    int paramIndex = -1;
+    if(!checkChildKeyLookup(src, childSymbol, keyFieldSymbol, keyTy, childTyLocalIndex, paramIndex))
+        return false;
+
+    result = 0;
+    if(childTyLocalIndex >= 0){
+        result = root.getNumChildNodeWithKey(src.nodeIndex, childTyLocalIndex, paramIndex, keyValue);
+    }
+    return true;
+}
+
+bool ExecutionContext::getChildNodeWithKey(const NodePtrType& src, int childSymbol, int keyFieldSymbol, ValueType keyTy, const QVariant& keyValue, qint64 ordinal, NodePtrType& result)
+{
+    int childTyLocalIndex = -1;
+    int paramIndex = -1;
+    if(!checkChildKeyLookup(src, childSymbol, keyFieldSymbol, keyTy, childTyLocalIndex, paramIndex))
+        return false;
+
+    result.head = getPtrSrcHead();
+    result.nodeIndex = -1;
+    if(childTyLocalIndex >= 0){
+        int count = root.getNumChildNodeWithKey(src.nodeIndex, childTyLocalIndex, paramIndex, keyValue);
+        if(ordinal >= 0 && ordinal < count){
+            result.nodeIndex = root.getChildNodeIndexWithKey(src.nodeIndex, childTyLocalIndex, paramIndex, keyValue, static_cast<int>(ordinal));
+        }
+    }
+    return true;
+}
+
+bool ExecutionContext::getNodeOfType(int typeSymbol, qint64 ordinal, NodePtrType& result)
+{
+    int typeIndex = t.getNodeTypeIndex(typeSymbol);
+    if(Q_UNLIKELY(typeIndex < 0)){
+        diagnostic(Diag::Error_Exec_BadReference_NodeType, t.getSymbolTable().getName(typeSymbol));
+        return false;
+    }
+    int count = root.getNumNodeOfType(typeIndex);
+
+    result.head = getPtrSrcHead();
+    result.nodeIndex = (ordinal >= 0 && ordinal < count)? root.getNodeOfType(typeIndex, static_cast<int>(ordinal)) : -1;
+    return true;
+}
+
+bool ExecutionContext::getNumNodeOfType(int typeSymbol, qint64& result)
+{
+    int typeIndex = t.getNodeTypeIndex(typeSymbol);
+    if(Q_UNLIKELY(typeIndex < 0)){
+        diagnostic(Diag::Error_Exec_BadReference_NodeType, t.getSymbolTable().getName(typeSymbol));
+        return false;
+    }
+    result = root.getNumNodeOfType(typeIndex);
+    return true;
+}
+
 void ExecutionContext::continueExecution()
 {
     // we havn't implement pausing execution yet
@@ -474,6 +600,49 @@ void ExecutionContext::continueExecution()
     }
 }
 
+void ExecutionContext::setExecutionCache(ExecutionCache* cachePtr)
+{
+    cache = nullptr;
+    subtreeSize.clear();
+    if(cachePtr == nullptr || !t.isSubtreeLocal() || !root.hasSubtreeHash())
+        return;
+
+    cache = cachePtr;
+    if(cache->taskGeneration != t.getGeneration()){
+        cache->clear();
+        cache->taskGeneration = t.getGeneration();
+    }
+    int numNode = root.getNumNode();
+    subtreeSize.fill(1, numNode);
+    for(int i = numNode-1; i > 0; --i){
+        subtreeSize[root.getParentIndex(i)] += subtreeSize.at(i);
+    }
+}
+
+ExecutionMemoryUsage ExecutionContext::getMemoryUsage() const
+{
+    ExecutionMemoryUsage usage;
+    usage.nodeMembers = MemoryUsage::ofList(nodeMembers);
+    for(const auto& members : nodeMembers){
+        usage.nodeMembers += MemoryUsage::ofVariantList(members);
+    }
+    usage.globalVariables = MemoryUsage::ofVariantList(globalVariables);
+    usage.stack = static_cast<qint64>(stack.size()) * static_cast<qint64>(sizeof(CallStackEntry))
+                + MemoryUsage::ofVector(nodeTraverseStack);
+    for(const auto& frame : stack){
+        usage.stack += MemoryUsage::ofVariantList(frame.localVariables);
+    }
+    usage.other = static_cast<qint64>(sizeof(ExecutionContext))
+                + MemoryUsage::ofHash(breakpoints)
+                + MemoryUsage::ofList(allowedOutputTypes)
+                + MemoryUsage::ofVector(subtreeSize)
+                + MemoryUsage::ofList(outputLog);
+    for(const auto& str : outputLog){
+        usage.other += MemoryUsage::ofString(str);
+    }
+    return usage;
+}
+
 void ExecutionContext::mainExecutionEntry()
 {
     // reset state first
@@ -481,21 +650,72 @@ void ExecutionContext::mainExecutionEntry()
     nodeTraverseStack.clear();
     stack.clear();
     isInExecution = true;
+    if(cache){
+        cache->entries.resize(t.getNumPass());
+        cache->pendingEntries.clear();
+        cache->pendingEntries.resize(t.getNumPass());
+    }
 
     for(int passIndex = 0, numPass = t.getNumPass(); passIndex < numPass; ++passIndex){
         DiagnosticPathNode dnode(diagnostic, tr("Pass %1").arg(passIndex));
         DiagnosticPathNode dnodeRoot(diagnostic, tr("Root"));
-        nodeTraverseEntry(passIndex, 0);
+        outputLog.clear();
+        if(rootReader){
+            nodeTraverseEntry(*rootReader, passIndex, 0);
+        }else{
+            nodeTraverseEntry(root, passIndex, 0);
+        }
         dnodeRoot.pop();// "Root"
         dnode.pop();// "Pass %1"
     }
+
+    if(cache){
+        // entries not used in this run are dropped
+        cache->entries.swap(cache->pendingEntries);
+        cache->pendingEntries.clear();
+    }
 }
 
-void ExecutionContext::nodeTraverseEntry(int passIndex, int nodeIndex)
+bool ExecutionContext::tryReuseSubtree(int passIndex, int nodeIndex)
 {
-    const IRNodeInstance& inst = root.getNode(nodeIndex);
-    int nodeTypeIndex = inst.getTypeIndex();
-    const IRNodeType& ty = root.getType().getNodeType(nodeTypeIndex);
+    quint64 hash = root.getSubtreeHash(nodeIndex);
+    QHash<quint64, ExecutionCache::Entry>& pending = cache->pendingEntries[passIndex];
+    // identical subtrees earlier in this run are as good as ones from previous runs
+    auto iter = pending.constFind(hash);
+    if(iter == pending.constEnd()){
+        const QHash<quint64, ExecutionCache::Entry>& previous = cache->entries.at(passIndex);
+        auto prevIter = previous.constFind(hash);
+        if(prevIter == previous.constEnd())
+            return false;
+        iter = pending.insert(hash, prevIter.value());
+    }
+
+    const ExecutionCache::Entry& entry = iter.value();
+    Q_ASSERT(entry.nodeMembers.size() == subtreeSize.at(nodeIndex));
+    for(const QString& data : entry.outputs){
+        if(Q_UNLIKELY(!out.addOutput(data))){
+            diagnostic(Diag::Error_Exec_Output_Unknown_String, data);
+            throw std::runtime_error("Output failure");
+        }
+        outputLog.push_back(data);
+    }
+    for(int i = 0, n = entry.nodeMembers.size(); i < n; ++i){
+        nodeMembers[nodeIndex + i] = entry.nodeMembers.at(i);
+    }
+    return true;
+}
+
+template<typename Reader>
+void ExecutionContext::nodeTraverseEntry(const Reader& reader, int passIndex, int nodeIndex)
+{
+    // nodes are in pre-order (checked by IRRootInstance::validate()), so the subtree of a node is [nodeIndex, nodeIndex + subtreeSize)
+    bool isCaching = (cache != nullptr && subtreeSize.at(nodeIndex) >= cache->minimumSubtreeSize);
+    if(isCaching && tryReuseSubtree(passIndex, nodeIndex))
+        return;
+    int outputStart = outputLog.size();
+
+    int nodeTypeIndex = reader.getTypeIndex(nodeIndex);
+    const IRNodeType& ty = reader.getType().getNodeType(nodeTypeIndex);
     diagnostic.setDetailedName(ty.getName());
     int entryCB = t.getNodeCallback(nodeTypeIndex, Task::CallbackType::OnEntry, passIndex);
     int exitCB = t.getNodeCallback(nodeTypeIndex, Task::CallbackType::OnExit, passIndex);
@@ -507,9 +727,9 @@ void ExecutionContext::nodeTraverseEntry(int passIndex, int nodeIndex)
         dnode.pop();
     }
 
-    for(int i = 0, numChild = inst.getNumChildNode(); i < numChild; ++i){
+    for(int i = 0, numChild = reader.getNumChildNode(nodeIndex); i < numChild; ++i){
         DiagnosticPathNode dnode(diagnostic, tr("Child %1").arg(i));
-        nodeTraverseEntry(passIndex, inst.getChildNodeByOrder(i));
+        nodeTraverseEntry(reader, passIndex, reader.getChildNodeByOrder(nodeIndex, i));
         dnode.pop();
     }
 
@@ -519,6 +739,13 @@ void ExecutionContext::nodeTraverseEntry(int passIndex, int nodeIndex)
         functionMainLoop();
         dnode.pop();
     }
+
+    if(isCaching){
+        ExecutionCache::Entry entry;
+        entry.outputs = outputLog.mid(outputStart);
+        entry.nodeMembers = nodeMembers.mid(nodeIndex, subtreeSize.at(nodeIndex));
+        cache->pendingEntries[passIndex].insert(reader.getSubtreeHash(nodeIndex), entry);
+    }
 }
 
 void ExecutionContext::pushFunctionStackframe(int functionIndex, int nodeIndex, QList<QVariant> params)
@@ -530,7 +757,7 @@ void ExecutionContext::pushFunctionStackframe(int functionIndex, int nodeIndex,
     const Function& f = t.getFunction(functionIndex);
     if(f.getNumStatement() > 0){
         diagnostic.setDetailedName(f.getName());
-        CallStackEntry entry(f, functionIndex, nodeIndex, root.getNode(nodeIndex).getTypeIndex(), activationIndex);
+        CallStackEntry entry(f, functionIndex, nodeIndex, root.getTypeIndex(nodeIndex), activationIndex);
         int localVariableCnt = f.getNumLocalVariable();
         entry.localVariables.reserve(localVariableCnt);
         for(int i = 0; i < localVariableCnt; ++i){
@@ -573,7 +800,7 @@ void ExecutionContext::functionMainLoop()
                 throw std::runtime_error("Expression evaluation fail");
             }
             if(assign.lvalueExprIndex == -1){
-                isGood = write(assign.lvalueName, rhsTy, rhsVal);
+                isGood = write(assign.lvalueSymbol, rhsTy, rhsVal);
             }else{
                 ValueType lhsTy = ValueType::Void;
                 QVariant lhsVal;
@@ -606,6 +833,9 @@ void ExecutionContext::functionMainLoop()
                 default: Q_UNREACHABLE();
                 case ValueType::String:
                     isGood = out.addOutput(rhsVal.toString());
+                    if(cache && isGood){
+                        outputLog.push_back(rhsVal.toString());
+                    }
                     break;
                 }
                 if(Q_UNLIKELY(!isGood)){
@@ -619,7 +849,7 @@ void ExecutionContext::functionMainLoop()
         }break;
         case StatementType::Call:{
             const CallStatement& call = frame.f.getCallStatement(stmt.statementIndexInType);
-            int functionIndex = t.getFunctionIndex(call.functionName);
+            int functionIndex = call.functionIndex;
             if(Q_UNLIKELY(functionIndex < 0)){
                 diagnostic(Diag::Error_Exec_Call_BadReference, call.functionName);
                 throw std::runtime_error("Function not found");
@@ -749,24 +979,11 @@ QString ExecutionContext::getNodeDescription(int nodeIndex)
     QStringList path;
     int currentNodeIndex = nodeIndex;
     while(currentNodeIndex > 0){
-        const IRNodeInstance& inst = root.getNode(currentNodeIndex);
-        const IRNodeType& ty = root.getType().getNodeType(inst.getTypeIndex());
-        const QString& name = ty.getName();
-        int parent = inst.getParentIndex();
-        const IRNodeInstance& parentInst = root.getNode(parent);
-        const IRNodeType& parentTy = root.getType().getNodeType(parentInst.getTypeIndex());
-        int localTyIndex = parentTy.getChildNodeTypeIndex(name);
-        int index = 0;
-        int numInst = parentInst.getNumChildNodeUnderType(localTyIndex);
-        while(index < numInst){
-            if(parentInst.getChildNodeIndex(localTyIndex, index) == currentNodeIndex)
-                break;
-            ++index;
-        }
-        Q_ASSERT(index < numInst);
-        path.push_back(tr("/%1[%2]").arg(name,QString::number(index)));
+        const IRNodeType& ty = root.getType().getNodeType(root.getTypeIndex(currentNodeIndex));
+        int index = root.getIndexUnderType(currentNodeIndex);
+        path.push_back(tr("/%1[%2]").arg(ty.getName(),QString::number(index)));
 
-        currentNodeIndex = parent;
+        currentNodeIndex = root.getParentIndex(currentNodeIndex);
     }
     for(int i = path.size() -1; i >= 0; --i){
         result.append(path.at(i));
@@ -797,14 +1014,12 @@ QString ExecutionContext::getValuePtrDescription(const ValuePtrType& ptr)
                     QString::number(ptr.head.activationIndex));
     }break;
     case ValuePtrType::PtrType::NodeRWMember:{
-        const IRNodeInstance& inst = root.getNode(ptr.nodeIndex);
         result = tr("&%1 in %2").arg(
-                    t.getNodeMemberName(inst.getTypeIndex(), ptr.valueIndex),
+                    t.getNodeMemberName(root.getTypeIndex(ptr.nodeIndex), ptr.valueIndex),
                     getNodeDescription(ptr.nodeIndex));
     }break;
     case ValuePtrType::PtrType::NodeROParameter:{
-        const IRNodeInstance& inst = root.getNode(ptr.nodeIndex);
-        const IRNodeType& ty = root.getType().getNodeType(inst.getTypeIndex());
+        const IRNodeType& ty = root.getType().getNodeType(root.getTypeIndex(ptr.nodeIndex));
         result = tr("&%1 in %2").arg(
                     ty.getParameterName(ptr.valueIndex),
                     getNodeDescription(ptr.nodeIndex));
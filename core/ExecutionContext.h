@@ -5,6 +5,7 @@
 #include <QString>
 #include <QVariant>
 #include <QStack>
+#include <QVector>
 #include <QEventLoop>
 
 #include <memory>
@@ -13,10 +14,27 @@
 #include "util/ADT.h"
 
 class DiagnosticEmitterBase;
+class ExecutionCache;
 class OutputHandlerBase;
 class Function;
 class Task;
 class IRRootInstance;
+class IRInstanceReaderBase;
+class IRRootInstanceReader;
+
+/**
+ * @brief The ExecutionMemoryUsage struct is an estimated breakdown (in bytes) of memory used by an ExecutionContext
+ *
+ * The IR instance, the task and the execution cache are not included; they are shared with others and have their own reports.
+ */
+struct ExecutionMemoryUsage{
+    qint64 nodeMembers      = 0;    //!< read-writeable node members of all nodes
+    qint64 globalVariables  = 0;
+    qint64 stack            = 0;    //!< function call frames with their local variables, and the node traversal stack
+    qint64 other            = 0;    //!< the context itself, breakpoints and bookkeeping for subtree result reuse
+
+    qint64 getTotal() const {return nodeMembers + globalVariables + stack + other;}
+};
 
 // you probably want to move ExecutionContext to another thread
 
@@ -25,7 +43,9 @@ class ExecutionContext: public QObject
     Q_OBJECT
 public:
     ExecutionContext(const Task& t, const IRRootInstance& root, DiagnosticEmitterBase& diagnostic, OutputHandlerBase& out, QObject* parent = nullptr);
-    virtual ~ExecutionContext() override{}
+    // run over any IR storage (e.g. IRPagedInstance); root must be validated and outlive the context
+    ExecutionContext(const Task& t, const IRInstanceReaderBase& root, DiagnosticEmitterBase& diagnostic, OutputHandlerBase& out, QObject* parent = nullptr);
+    virtual ~ExecutionContext() override;
 
     // interface exposed to everyone
     const Task& getTask()const{return t;}
@@ -41,12 +61,12 @@ public:
     // there must be a stack frame set
     /**
      * @brief read read from local variable, node member, or global variable by name reference
-     * @param name variable name for lookup
+     * @param symbol symbol id of the variable name (see Task::getSymbolTable())
      * @param ty value type of result
      * @param dest read value
      * @return true if read is successful; false otherwise
      */
-    bool read(const QString& name, ValueType& ty, QVariant& val);
+    bool read(int symbol, ValueType& ty, QVariant& val);
 
     /**
      * @brief read read a value by dereferencing a pointer
@@ -59,11 +79,11 @@ public:
 
     /**
      * @brief takeAddress create a pointer from variable name lookup
-     * @param name variable name for lookup
+     * @param symbol symbol id of the variable name (see Task::getSymbolTable())
      * @param val pointer value
      * @return true if lookup successful; false otherwise
      */
-    bool takeAddress(const QString& name, ValuePtrType& val);
+    bool takeAddress(int symbol, ValuePtrType& val);
 
     // used to construct node reference
     // these three never fails
@@ -71,10 +91,20 @@ public:
     bool getRootNodePtr(NodePtrType& result);
     bool getParentNode(const NodePtrType& src, NodePtrType& result);
 
-    bool getChildNode(const NodePtrType &src, const QString& childName, NodePtrType& result, ValueType keyTy, const QVariant& primaryKey);
-    bool getChildNode(const NodePtrType& src, const QString& childName, NodePtrType& result, const QString& keyField,  ValueType keyTy, const QVariant& keyValue);
+    bool getChildNode(const NodePtrType &src, int childSymbol, NodePtrType& result, ValueType keyTy, const QVariant& primaryKey);
+    bool getChildNode(const NodePtrType& src, int childSymbol, NodePtrType& result, int keyFieldSymbol, ValueType keyTy, const QVariant& keyValue);
     // no indexing by child node index yet.. should be there later on
 
+    // lookup by a unique or indexed (IRNodeType::getParameterIsIndexed()) parameter that can match multiple children
+    // matches are in document order; out of range ordinal gives null pointer (nodeIndex == -1)
+    bool getNumChildNodeWithKey(const NodePtrType& src, int childSymbol, int keyFieldSymbol, ValueType keyTy, const QVariant& keyValue, qint64& result);
+    bool getChildNodeWithKey(const NodePtrType& src, int childSymbol, int keyFieldSymbol, ValueType keyTy, const QVariant& keyValue, qint64 ordinal, NodePtrType& result);
+
+    // lookup through per-type node index of IRRootInstance
+    // out of range ordinal gives null pointer (nodeIndex == -1)
+    bool getNodeOfType(int typeSymbol, qint64 ordinal, NodePtrType& result);
+    bool getNumNodeOfType(int typeSymbol, qint64& result);
+
     //*************************************************************************
     // interface exposed to environment
 
@@ -91,6 +121,20 @@ public:
      */
     void removeBreakpoint(int breakpointIndex);
 
+    /**
+     * @brief setExecutionCache reuse results of unchanged subtrees from previous runs, and record results of this run
+     *
+     * The cache is only used if the task is subtree-local and the IR instance has subtree hash enabled;
+     * it is updated only when execution finishes successfully. Breakpoints in reused subtrees are not hit.
+     * @param cache the cache to use; nullptr to disable. The cache must outlive execution.
+     */
+    void setExecutionCache(ExecutionCache* cache);
+
+    /**
+     * @brief getMemoryUsage estimates memory used by execution state; only call it when execution is paused or finished
+     */
+    ExecutionMemoryUsage getMemoryUsage() const;
+
 signals:
     void executionFinished(int retval);// 0: success; -1: fail
     void executionPaused();
@@ -98,13 +142,20 @@ public slots:
     void continueExecution();
 
 private:
+    void initialize();
     void mainExecutionEntry();
-    void nodeTraverseEntry(int passIndex, int nodeIndex);
+    // templated on the reader so that traversal over IRRootInstance does not go through virtual calls
+    template<typename Reader>
+    void nodeTraverseEntry(const Reader& reader, int passIndex, int nodeIndex);
+    bool tryReuseSubtree(int passIndex, int nodeIndex);
+
+    // common checks for getNumChildNodeWithKey() and getChildNodeWithKey(); return false if lookup is not possible
+    bool checkChildKeyLookup(const NodePtrType& src, int childSymbol, int keyFieldSymbol, ValueType keyTy, int& childTyLocalIndex, int& paramIndex);
     void pushFunctionStackframe(int functionIndex, int nodeIndex, QList<QVariant> params = QList<QVariant>());
     void functionMainLoop();
 
     void checkUninitializedRead(ValueType ty, QVariant& readVal);
-    bool write(const QString& name, const ValueType& ty, const QVariant& val);
+    bool write(int symbol, const ValueType& ty, const QVariant& val);
     bool write(const ValuePtrType& valuePtr, const ValueType& ty, const QVariant& dest);
     /**
      * @brief evaluateExpression evaluates the expression in current stack frame's current function
@@ -175,9 +226,18 @@ private:
     QList<ValueType> allowedOutputTypes;
     QEventLoop eventLoop;
 
+    // subtree result reuse; see setExecutionCache()
+    ExecutionCache* cache = nullptr;
+    QVector<int> subtreeSize;   //!< [node] -> number of nodes in subtree; only computed if cache is used
+    QList<QString> outputLog;   //!< all outputs of the current pass; only recorded if cache is used
+
+    // owned adapter when constructed from IRRootInstance, or nullptr; must be declared before root
+    // it is used directly (non-virtual) on hot paths
+    std::unique_ptr<IRRootInstanceReader> rootReader;
+
     // references
     const Task& t;
-    const IRRootInstance& root;
+    const IRInstanceReaderBase& root;
     DiagnosticEmitterBase& diagnostic;
     OutputHandlerBase& out;
 };
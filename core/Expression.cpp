@@ -15,7 +15,7 @@ bool VariableAddressExpression::evaluate(ExecutionContext& ctx, QVariant& retVal
 {
     Q_UNUSED(dependentExprResults)
     ValuePtrType val = {};
-    if(ctx.takeAddress(variableName, val)){
+    if(ctx.takeAddress(variableSymbol, val)){
         retVal.setValue(val);
         return true;
     }
@@ -27,7 +27,7 @@ bool VariableReadExpression::evaluate(ExecutionContext& ctx, QVariant& retVal, c
     Q_UNUSED(dependentExprResults)
     ValueType actualTy;
     QVariant val;
-    if(ctx.read(variableName, actualTy, val)){
+    if(ctx.read(variableSymbol, actualTy, val)){
         if(Q_LIKELY(actualTy == ty)){
             retVal = val;
             return true;
@@ -57,3 +57,49 @@ bool NodePtrExpression::evaluate(ExecutionContext& ctx, QVariant& retVal, const
     retVal.setValue(ptr);
     return true;
 }
+
+bool NodeOfTypeExpression::evaluate(ExecutionContext& ctx, QVariant& retVal, const QList<QVariant>& dependentExprResults) const
+{
+    Q_ASSERT(dependentExprResults.size() == 1);
+    NodePtrType ptr = {};
+    if(ctx.getNodeOfType(nodeTypeSymbol, dependentExprResults.front().toLongLong(), ptr)){
+        retVal.setValue(ptr);
+        return true;
+    }
+    return false;
+}
+
+bool NodeCountOfTypeExpression::evaluate(ExecutionContext& ctx, QVariant& retVal, const QList<QVariant>& dependentExprResults) const
+{
+    Q_UNUSED(dependentExprResults)
+    qint64 count = 0;
+    if(ctx.getNumNodeOfType(nodeTypeSymbol, count)){
+        retVal.setValue(count);
+        return true;
+    }
+    return false;
+}
+
+bool ChildNodeWithKeyExpression::evaluate(ExecutionContext& ctx, QVariant& retVal, const QList<QVariant>& dependentExprResults) const
+{
+    Q_ASSERT(dependentExprResults.size() == 3);
+    NodePtrType ptr = {};
+    if(ctx.getChildNodeWithKey(dependentExprResults.at(0).value<NodePtrType>(), childSymbol, keyFieldSymbol, keyTy,
+                               dependentExprResults.at(1), dependentExprResults.at(2).toLongLong(), ptr)){
+        retVal.setValue(ptr);
+        return true;
+    }
+    return false;
+}
+
+bool ChildCountWithKeyExpression::evaluate(ExecutionContext& ctx, QVariant& retVal, const QList<QVariant>& dependentExprResults) const
+{
+    Q_ASSERT(dependentExprResults.size() == 2);
+    qint64 count = 0;
+    if(ctx.getNumChildNodeWithKey(dependentExprResults.at(0).value<NodePtrType>(), childSymbol, keyFieldSymbol, keyTy,
+                                  dependentExprResults.at(1), count)){
+        retVal.setValue(count);
+        return true;
+    }
+    return false;
+}
@@ -7,6 +7,7 @@
 #include <QList>
 
 #include "core/Value.h"
+#include "core/SymbolTable.h"
 
 class ExecutionContext;
 
@@ -33,6 +34,14 @@ public:
      */
     virtual void getVariableNameReference(QList<QString>& name) const {Q_UNUSED(name)}
 
+    /**
+     * @brief resolveSymbols intern all names used by this expression, so that evaluate() looks them up by symbol id
+     *
+     * Called by Task::validate(); clone() keeps the resolved ids.
+     * @param symbols the symbol table of the task
+     */
+    virtual void resolveSymbols(SymbolTable& symbols) {Q_UNUSED(symbols)}
+
     /**
      * @brief getDependency get list of expression indices that this expression depends upon
      * @param dependentExprIndexList
@@ -49,6 +58,13 @@ public:
      * @return true if execution is successful; false if there is any fatal error that should abort the evaluation
      */
     virtual bool evaluate(ExecutionContext& ctx, QVariant& retVal, const QList<QVariant>& dependentExprResults) const = 0;
+
+    /**
+     * @brief isSubtreeLocal whether the expression only reaches data in the subtree of current node
+     *
+     * Used by Task::isSubtreeLocal(); expressions that can reach other parts of the tree (e.g. the root) should return false.
+     */
+    virtual bool isSubtreeLocal() const {return true;}
 };
 
 // an expression list that use deep copy
@@ -110,12 +126,14 @@ public:
         : variableName(varName)
     {}
     virtual ~VariableAddressExpression() override {}
-    virtual VariableAddressExpression* clone() const override{return new VariableAddressExpression(variableName);}
+    virtual VariableAddressExpression* clone() const override{return new VariableAddressExpression(*this);}
     virtual ValueType getExpressionType() const override {return ValueType::ValuePtr;}
     virtual void getVariableNameReference(QList<QString>& name) const override {name.push_back(variableName);}
+    virtual void resolveSymbols(SymbolTable& symbols) override {variableSymbol = symbols.intern(variableName);}
     virtual bool evaluate(ExecutionContext& ctx, QVariant& retVal, const QList<QVariant>& dependentExprResults) const override;
 private:
     QString variableName;
+    int variableSymbol = -1;
 };
 
 /**
@@ -130,13 +148,15 @@ public:
         : ty(ty), variableName(varName)
     {}
     virtual ~VariableReadExpression() override {}
-    virtual VariableReadExpression* clone() const override {return new VariableReadExpression(ty, variableName);}
+    virtual VariableReadExpression* clone() const override {return new VariableReadExpression(*this);}
     virtual ValueType getExpressionType() const override {return ty;}
     virtual void getVariableNameReference(QList<QString>& name) const override {name.push_back(variableName);}
+    virtual void resolveSymbols(SymbolTable& symbols) override {variableSymbol = symbols.intern(variableName);}
     virtual bool evaluate(ExecutionContext& ctx, QVariant& retVal, const QList<QVariant>& dependentExprResults) const override;
 private:
     ValueType ty;
     QString variableName;
+    int variableSymbol = -1;
 };
 
 /**
@@ -158,8 +178,135 @@ public:
     virtual NodePtrExpression* clone() const override {return new NodePtrExpression(specifier);}
     virtual ValueType getExpressionType() const override {return ValueType::NodePtr;}
     virtual bool evaluate(ExecutionContext& ctx, QVariant& retVal, const QList<QVariant>& dependentExprResults) const override;
+    virtual bool isSubtreeLocal() const override {return specifier == NodeSpecifier::CurrentNode;}
 private:
     NodeSpecifier specifier;
 };
 
+/**
+ * @brief The NodeOfTypeExpression class
+ *
+ * Create a node pointer to the N-th node (in document order) of given node type, without traversing the tree.
+ * N is the result of an Int64 expression; out of range N gives null pointer.
+ */
+class NodeOfTypeExpression: public ExpressionBase
+{
+public:
+    explicit NodeOfTypeExpression(QString nodeTypeName, int ordinalExprIndex)
+        : nodeTypeName(nodeTypeName), ordinalExprIndex(ordinalExprIndex)
+    {}
+    virtual ~NodeOfTypeExpression() override {}
+    virtual NodeOfTypeExpression* clone() const override {return new NodeOfTypeExpression(*this);}
+    virtual ValueType getExpressionType() const override {return ValueType::NodePtr;}
+    virtual void getDependency(QList<int>& dependentExprIndexList, QList<ValueType>& exprTypeList) const override{
+        dependentExprIndexList.push_back(ordinalExprIndex);
+        exprTypeList.push_back(ValueType::Int64);
+    }
+    virtual void resolveSymbols(SymbolTable& symbols) override {nodeTypeSymbol = symbols.intern(nodeTypeName);}
+    virtual bool evaluate(ExecutionContext& ctx, QVariant& retVal, const QList<QVariant>& dependentExprResults) const override;
+    virtual bool isSubtreeLocal() const override {return false;}
+private:
+    QString nodeTypeName;
+    int ordinalExprIndex;
+    int nodeTypeSymbol = -1;
+};
+
+/**
+ * @brief The NodeCountOfTypeExpression class
+ *
+ * Number of nodes of given node type in the IR, as Int64
+ */
+class NodeCountOfTypeExpression: public ExpressionBase
+{
+public:
+    explicit NodeCountOfTypeExpression(QString nodeTypeName)
+        : nodeTypeName(nodeTypeName)
+    {}
+    virtual ~NodeCountOfTypeExpression() override {}
+    virtual NodeCountOfTypeExpression* clone() const override {return new NodeCountOfTypeExpression(*this);}
+    virtual ValueType getExpressionType() const override {return ValueType::Int64;}
+    virtual void resolveSymbols(SymbolTable& symbols) override {nodeTypeSymbol = symbols.intern(nodeTypeName);}
+    virtual bool evaluate(ExecutionContext& ctx, QVariant& retVal, const QList<QVariant>& dependentExprResults) const override;
+    virtual bool isSubtreeLocal() const override {return false;}
+private:
+    QString nodeTypeName;
+    int nodeTypeSymbol = -1;
+};
+
+/**
+ * @brief The ChildNodeWithKeyExpression class
+ *
+ * Create a node pointer to the N-th child (in document order) of given type whose key parameter equals given value.
+ * The key parameter must be unique or indexed; out of range N gives null pointer.
+ * Dependencies are: source node pointer, key value, N (Int64).
+ */
+class ChildNodeWithKeyExpression: public ExpressionBase
+{
+public:
+    explicit ChildNodeWithKeyExpression(QString childName, QString keyField, ValueType keyTy, int srcExprIndex, int keyExprIndex, int ordinalExprIndex)
+        : childName(childName), keyField(keyField), keyTy(keyTy), srcExprIndex(srcExprIndex), keyExprIndex(keyExprIndex), ordinalExprIndex(ordinalExprIndex)
+    {}
+    virtual ~ChildNodeWithKeyExpression() override {}
+    virtual ChildNodeWithKeyExpression* clone() const override {return new ChildNodeWithKeyExpression(*this);}
+    virtual ValueType getExpressionType() const override {return ValueType::NodePtr;}
+    virtual void getDependency(QList<int>& dependentExprIndexList, QList<ValueType>& exprTypeList) const override{
+        dependentExprIndexList.push_back(srcExprIndex);
+        exprTypeList.push_back(ValueType::NodePtr);
+        dependentExprIndexList.push_back(keyExprIndex);
+        exprTypeList.push_back(keyTy);
+        dependentExprIndexList.push_back(ordinalExprIndex);
+        exprTypeList.push_back(ValueType::Int64);
+    }
+    virtual void resolveSymbols(SymbolTable& symbols) override {
+        childSymbol = symbols.intern(childName);
+        keyFieldSymbol = symbols.intern(keyField);
+    }
+    virtual bool evaluate(ExecutionContext& ctx, QVariant& retVal, const QList<QVariant>& dependentExprResults) const override;
+private:
+    QString childName;
+    QString keyField;
+    ValueType keyTy;
+    int srcExprIndex;
+    int keyExprIndex;
+    int ordinalExprIndex;
+    int childSymbol = -1;
+    int keyFieldSymbol = -1;
+};
+
+/**
+ * @brief The ChildCountWithKeyExpression class
+ *
+ * Number of children of given type whose key parameter equals given value, as Int64.
+ * Dependencies are: source node pointer, key value.
+ */
+class ChildCountWithKeyExpression: public ExpressionBase
+{
+public:
+    explicit ChildCountWithKeyExpression(QString childName, QString keyField, ValueType keyTy, int srcExprIndex, int keyExprIndex)
+        : childName(childName), keyField(keyField), keyTy(keyTy), srcExprIndex(srcExprIndex), keyExprIndex(keyExprIndex)
+    {}
+    virtual ~ChildCountWithKeyExpression() override {}
+    virtual ChildCountWithKeyExpression* clone() const override {return new ChildCountWithKeyExpression(*this);}
+    virtual ValueType getExpressionType() const override {return ValueType::Int64;}
+    virtual void getDependency(QList<int>& dependentExprIndexList, QList<ValueType>& exprTypeList) const override{
+        dependentExprIndexList.push_back(srcExprIndex);
+        exprTypeList.push_back(ValueType::NodePtr);
+        dependentExprIndexList.push_back(keyExprIndex);
+        exprTypeList.push_back(keyTy);
+    }
+    virtual void resolveSymbols(SymbolTable& symbols) override {
+        childSymbol = symbols.intern(childName);
+        keyFieldSymbol = symbols.intern(keyField);
+    }
+    virtual bool evaluate(ExecutionContext& ctx, QVariant& retVal, const QList<QVariant>& dependentExprResults) const override;
+private:
+    QString childName;
+    QString keyField;
+    ValueType keyTy;
+    int srcExprIndex;
+    int keyExprIndex;
+    int childSymbol = -1;
+    int keyFieldSymbol = -1;
+};
+
 #endif // EXPRESSION_H
@@ -0,0 +1,750 @@
+#include "core/IR.h"
+
+#include "util/MemoryUsage.h"
+
+#include <QMutexLocker>
+#include <QSet>
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <memory>
+
+namespace{
+template<typename KeyType>
+void buildUniqueKeyHash(QHash<KeyType, int>& hash, const ChunkedVector<KeyType>& column,
+                        const ChunkedVector<int>& nodeRow, const QVector<int>& childByType, int first, int last)
+{
+    // uniqueness is already checked by validate()
+    hash.reserve(last - first);
+    for(int i = first; i < last; ++i){
+        int childNodeIndex = childByType.at(i);
+        hash.insert(column.at(nodeRow.at(childNodeIndex)), childNodeIndex);
+    }
+}
+
+template<typename KeyType, typename RangeType>
+void buildSecondaryKeyIndex(QHash<KeyType, RangeType>& hash, QVector<int>& nodeList, const ChunkedVector<KeyType>& column,
+                            const ChunkedVector<int>& nodeRow, const QVector<int>& childByType, int first, int last)
+{
+    // first pass counts children per value, second pass places them; this keeps document order within each value
+    for(int i = first; i < last; ++i){
+        hash[column.at(nodeRow.at(childByType.at(i)))].count += 1;
+    }
+    int start = 0;
+    for(auto iter = hash.begin(), iterEnd = hash.end(); iter != iterEnd; ++iter){
+        iter.value().start = start;
+        start += iter.value().count;
+        iter.value().count = 0;
+    }
+    nodeList.resize(last - first);
+    for(int i = first; i < last; ++i){
+        int childNodeIndex = childByType.at(i);
+        RangeType& range = hash[column.at(nodeRow.at(childNodeIndex))];
+        nodeList[range.start + range.count] = childNodeIndex;
+        range.count += 1;
+    }
+}
+
+// 64-bit mixing from splitmix64; all inputs to subtree hash go through this
+quint64 mixHash(quint64 seed, quint64 value)
+{
+    value += seed + 0x9e3779b97f4a7c15ULL;
+    value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+    return value ^ (value >> 31);
+}
+
+// FNV-1a over UTF-16 code units; unlike qHash() this does not depend on a per-process seed
+quint64 hashString(const QString& str)
+{
+    quint64 hash = 0xcbf29ce484222325ULL;
+    for(const QChar& c : str){
+        hash = (hash ^ c.unicode()) * 0x100000001b3ULL;
+    }
+    return hash;
+}
+}
+
+template<typename Hash>
+void IRStringPool::LayeredHash<Hash>::prepareInsert()
+{
+    // the shared empty hash is not detached, but there is nothing to keep
+    if(top.isEmpty() || top.isDetached())
+        return;
+    // top is shared with a copy of the pool; freeze it instead of detaching it
+    layers.push_back(std::shared_ptr<const Hash>(new Hash(top)));
+    top = Hash();
+    while(layers.size() >= 2 && layers.last()->size() * 2 >= layers.at(layers.size() - 2)->size()){
+        Hash merged = *layers.at(layers.size() - 2);
+        const Hash& newer = *layers.last();
+        for(auto iter = newer.constBegin(), iterEnd = newer.constEnd(); iter != iterEnd; ++iter){
+            merged.insert(iter.key(), iter.value());
+        }
+        layers.removeLast();
+        layers.last() = std::shared_ptr<const Hash>(new Hash(merged));
+    }
+}
+
+template<typename Hash>
+qint64 IRStringPool::LayeredHash<Hash>::getMemoryUsage() const
+{
+    qint64 usage = MemoryUsage::ofHash(top) + MemoryUsage::ofVector(layers);
+    for(const auto& layer : layers){
+        usage += static_cast<qint64>(sizeof(Hash)) + MemoryUsage::ofHash(*layer);
+    }
+    return usage;
+}
+
+IRStringPool::IRStringPool()
+{
+    intern(QString());
+}
+
+int IRStringPool::intern(const QString& str)
+{
+    if(mode == StorageMode::Utf8){
+        QByteArray utf8 = str.toUtf8();
+        uint hash = qHashBits(utf8.constData(), static_cast<size_t>(utf8.size()));
+        int id = findUtf8(utf8, hash);
+        if(id < 0){
+            id = size();
+            appendUtf8(utf8, hash);
+        }
+        return id;
+    }
+    int id = find(str);
+    if(id >= 0)
+        return id;
+    id = strings.size();
+    strings.push_back(str);
+    stringToId.prepareInsert();
+    stringToId.top.insert(str, id);
+    return id;
+}
+
+int IRStringPool::find(const QString& str) const
+{
+    if(mode == StorageMode::Utf8){
+        QByteArray utf8 = str.toUtf8();
+        return findUtf8(utf8, qHashBits(utf8.constData(), static_cast<size_t>(utf8.size())));
+    }
+    int id = stringToId.top.value(str, -1);
+    for(int i = stringToId.layers.size() - 1; id < 0 && i >= 0; --i){
+        id = stringToId.layers.at(i)->value(str, -1);
+    }
+    return id;
+}
+
+QByteArray IRStringPool::getUtf8(int start, int length) const
+{
+    QByteArray result;
+    result.reserve(length);
+    while(length > 0){
+        const QVector<char>& chunk = utf8Data.getChunk(start >> Utf8ChunkShift);
+        int offset = start & (Utf8Buffer::ChunkSize - 1);
+        int n = qMin(length, chunk.size() - offset);
+        result.append(chunk.constData() + offset, n);
+        start += n;
+        length -= n;
+    }
+    return result;
+}
+
+int IRStringPool::findUtf8(const QByteArray& utf8, uint hash) const
+{
+    auto helper_find = [&](const QMultiHash<uint, int>& layer)->int{
+        for(auto iter = layer.constFind(hash), iterEnd = layer.constEnd(); iter != iterEnd && iter.key() == hash; ++iter){
+            int id = iter.value();
+            int start = utf8Start.at(id);
+            int length = utf8Start.at(id + 1) - start;
+            if(length == utf8.size() && getUtf8(start, length) == utf8)
+                return id;
+        }
+        return -1;
+    };
+    int id = helper_find(utf8HashToId.top);
+    for(int i = utf8HashToId.layers.size() - 1; id < 0 && i >= 0; --i){
+        id = helper_find(*utf8HashToId.layers.at(i));
+    }
+    return id;
+}
+
+void IRStringPool::appendUtf8(const QByteArray& utf8, uint hash)
+{
+    utf8HashToId.prepareInsert();
+    utf8HashToId.top.insert(hash, utf8Start.size() - 1);
+    utf8Data.append(utf8.constData(), utf8.size());
+    utf8Start.push_back(utf8Data.size());
+}
+
+void IRStringPool::setStorageMode(StorageMode newMode)
+{
+    if(newMode == mode)
+        return;
+
+    if(newMode == StorageMode::Utf8){
+        utf8Data.clear();
+        utf8Start.clear();
+        utf8HashToId = LayeredHash<QMultiHash<uint, int>>();
+        utf8Start.reserve(strings.size() + 1);
+        utf8Start.push_back(0);
+        utf8HashToId.top.reserve(strings.size());
+        for(const auto& str : strings){
+            QByteArray utf8 = str.toUtf8();
+            appendUtf8(utf8, qHashBits(utf8.constData(), static_cast<size_t>(utf8.size())));
+        }
+        strings.clear();
+        stringToId = LayeredHash<QHash<QString, int>>();
+    }else{
+        // read everything through get() before switching mode
+        int numString = size();
+        ChunkedVector<QString> decoded;
+        decoded.reserve(numString);
+        for(int id = 0; id < numString; ++id){
+            decoded.push_back(get(id));
+        }
+        strings.swap(decoded);
+        stringToId = LayeredHash<QHash<QString, int>>();
+        stringToId.top.reserve(numString);
+        for(int id = 0; id < numString; ++id){
+            stringToId.top.insert(strings.at(id), id);
+        }
+        utf8Data.clear();
+        utf8Start.clear();
+        utf8HashToId = LayeredHash<QMultiHash<uint, int>>();
+    }
+    mode = newMode;
+}
+
+qint64 IRStringPool::getMemoryUsage() const
+{
+    qint64 usage = static_cast<qint64>(sizeof(IRStringPool));
+    usage += MemoryUsage::ofChunkedVector(strings);
+    for(const auto& str : strings){
+        // keys in stringToId share data with strings, so count them only once
+        usage += MemoryUsage::ofString(str);
+    }
+    usage += stringToId.getMemoryUsage();
+    usage += MemoryUsage::ofChunkedVector(utf8Data);
+    usage += MemoryUsage::ofChunkedVector(utf8Start);
+    usage += utf8HashToId.getMemoryUsage();
+    return usage;
+}
+
+IRRootInstance::IRRootInstance(const IRRootType& ty)
+    : ty(ty)
+{
+    Q_ASSERT(ty.validated());
+    int numNodeType = ty.getNumNodeType();
+    typeTables.resize(numNodeType);
+    childTypeToLocal.resize(numNodeType);
+    for(int i = 0; i < numNodeType; ++i){
+        const IRNodeType& nodeTy = ty.getNodeType(i);
+        NodeTypeTable& table = typeTables[i];
+        table.columns.resize(nodeTy.getNumParameter());
+        for(int j = 0, numParam = table.columns.size(); j < numParam; ++j){
+            table.columns[j].ty = nodeTy.getParameterType(j);
+        }
+        QHash<int,int>& localIndexMap = childTypeToLocal[i];
+        for(int j = 0, numChild = nodeTy.getNumChildNode(); j < numChild; ++j){
+            localIndexMap.insert(ty.getNodeTypeIndex(nodeTy.getChildNodeName(j)), j);
+        }
+    }
+    childStart.push_back(0);
+}
+
+IRRootInstance::~IRRootInstance()
+{
+    resetLookupIndex(0);
+}
+
+IRRootInstance* IRRootInstance::createSnapshot() const
+{
+    std::unique_ptr<IRRootInstance> ptr(new IRRootInstance(ty));
+    IRRootInstance& dest = *ptr;
+    // following assignments only increase reference counts; data is copied on write
+    dest.isValidated = isValidated;
+    dest.parallelValidationThreshold = parallelValidationThreshold;
+    dest.parallelValidationThreadCount = parallelValidationThreadCount;
+    dest.isSubtreeHashEnabled = isSubtreeHashEnabled;
+    dest.isStructureDirty = isStructureDirty;
+    dest.dirtyNodes = dirtyNodes;
+    dest.nodeTypeIndex = nodeTypeIndex;
+    dest.nodeParent = nodeParent;
+    dest.nodeRow = nodeRow;
+    dest.typeTables = typeTables;
+    dest.stringPool = stringPool;
+    dest.badParameterTypes = badParameterTypes;
+    dest.pendingChildEdges = pendingChildEdges;
+    dest.childStart = childStart;
+    dest.childList = childList;
+    dest.childTypeSlotStart = childTypeSlotStart;
+    dest.childTypeRange = childTypeRange;
+    dest.childByType = childByType;
+    dest.nodeOrderInParent = nodeOrderInParent;
+    dest.nodeIndexUnderType = nodeIndexUnderType;
+    dest.subtreeHash = subtreeHash;
+    if(isValidated){
+        // lookup index is cheap to rebuild lazily and is not shared
+        dest.resetLookupIndex(childTypeRange.size());
+    }
+    return ptr.release();
+}
+
+IRMemoryUsage IRRootInstance::getMemoryUsage() const
+{
+    IRMemoryUsage usage;
+    usage.nodeStructure = MemoryUsage::ofChunkedVector(nodeTypeIndex)
+                        + MemoryUsage::ofChunkedVector(nodeParent)
+                        + MemoryUsage::ofChunkedVector(nodeRow)
+                        + MemoryUsage::ofVector(dirtyNodes);
+    usage.childList = MemoryUsage::ofVector(pendingChildEdges)
+                    + MemoryUsage::ofVector(childStart)
+                    + MemoryUsage::ofVector(childList)
+                    + MemoryUsage::ofVector(childTypeSlotStart)
+                    + MemoryUsage::ofVector(childTypeRange)
+                    + MemoryUsage::ofVector(childByType)
+                    + MemoryUsage::ofVector(nodeOrderInParent)
+                    + MemoryUsage::ofVector(nodeIndexUnderType);
+    // stringPool::getMemoryUsage() includes the pool object, which is a member of this one
+    usage.stringPool = stringPool.getMemoryUsage() - static_cast<qint64>(sizeof(IRStringPool));
+    usage.subtreeHash = MemoryUsage::ofChunkedVector(subtreeHash);
+    usage.other = static_cast<qint64>(sizeof(IRRootInstance))
+                + MemoryUsage::ofVector(typeTables)
+                + MemoryUsage::ofVector(childTypeToLocal)
+                + MemoryUsage::ofHash(badParameterTypes);
+    for(const auto& localIndexMap : childTypeToLocal){
+        usage.other += MemoryUsage::ofHash(localIndexMap);
+    }
+    for(auto iter = badParameterTypes.constBegin(), iterEnd = badParameterTypes.constEnd(); iter != iterEnd; ++iter){
+        usage.other += MemoryUsage::ofVector(iter.value());
+    }
+
+    usage.perNodeType.fill(0, typeTables.size());
+    for(int i = 0, numNodeType = typeTables.size(); i < numNodeType; ++i){
+        const NodeTypeTable& table = typeTables.at(i);
+        qint64 nodeListUsage = MemoryUsage::ofChunkedVector(table.nodeList);
+        qint64 typeUsage = nodeListUsage + MemoryUsage::ofVector(table.columns);
+        usage.nodeStructure += nodeListUsage;
+        usage.other += MemoryUsage::ofVector(table.columns);
+        for(const auto& column : table.columns){
+            qint64 intUsage = MemoryUsage::ofChunkedVector(column.intData);
+            qint64 stringUsage = MemoryUsage::ofChunkedVector(column.stringData);
+            usage.intParameter += intUsage;
+            usage.stringParameter += stringUsage;
+            typeUsage += intUsage + stringUsage;
+        }
+        usage.perNodeType[i] = typeUsage;
+    }
+
+    // lookup indexes are built concurrently by getLookupIndex(); built ones are never changed until reset
+    usage.lookupIndex = static_cast<qint64>(numLookupIndex) * static_cast<qint64>(sizeof(QAtomicPointer<LookupIndex>));
+    for(int i = 0; i < numLookupIndex; ++i){
+        const LookupIndex* index = lookupIndex[i].loadAcquire();
+        if(index == nullptr)
+            continue;
+        usage.lookupIndex += static_cast<qint64>(sizeof(LookupIndex))
+                           + MemoryUsage::ofVector(index->perParamHash)
+                           + MemoryUsage::ofVector(index->perParamGroup);
+        for(const auto& hash : index->perParamHash){
+            usage.lookupIndex += MemoryUsage::ofHash(hash.intKey) + MemoryUsage::ofHash(hash.stringKey);
+        }
+        for(const auto& group : index->perParamGroup){
+            usage.lookupIndex += MemoryUsage::ofHash(group.intKey) + MemoryUsage::ofHash(group.stringKey) + MemoryUsage::ofVector(group.nodeList);
+        }
+    }
+    return usage;
+}
+
+bool IRRootInstance::isParameterStorageShared(const IRRootInstance& other, int nodeIndex, int parameterIndex) const
+{
+    if(&other.ty != &ty || nodeIndex < 0 || nodeIndex >= nodeTypeIndex.size() || nodeIndex >= other.nodeTypeIndex.size())
+        return false;
+    int typeIndex = nodeTypeIndex.at(nodeIndex);
+    int row = nodeRow.at(nodeIndex);
+    if(typeIndex != other.nodeTypeIndex.at(nodeIndex) || row < 0 || row != other.nodeRow.at(nodeIndex)
+            || parameterIndex < 0 || parameterIndex >= typeTables.at(typeIndex).columns.size())
+        return false;
+    const ParameterColumn& column = typeTables.at(typeIndex).columns.at(parameterIndex);
+    const ParameterColumn& otherColumn = other.typeTables.at(typeIndex).columns.at(parameterIndex);
+    switch(column.ty){
+    case ValueType::Int64:
+        return column.intData.isChunkSharedWith(otherColumn.intData, row / ChunkedVector<qint64>::ChunkSize);
+    case ValueType::String:
+        return column.stringData.isChunkSharedWith(otherColumn.stringData, row / ChunkedVector<int>::ChunkSize);
+    default:
+        return false;
+    }
+}
+
+void IRRootInstance::resetLookupIndex(int numSlot)
+{
+    for(int i = 0; i < numLookupIndex; ++i){
+        delete lookupIndex[i].loadAcquire();
+    }
+    lookupIndex.reset(numSlot > 0? new QAtomicPointer<LookupIndex>[numSlot] : nullptr);
+    numLookupIndex = numSlot;
+}
+
+const IRRootInstance::LookupIndex& IRRootInstance::getLookupIndex(int slot) const
+{
+    Q_ASSERT(isValidated && slot >= 0 && slot < numLookupIndex);
+    QAtomicPointer<LookupIndex>& entry = lookupIndex[slot];
+    LookupIndex* index = entry.loadAcquire();
+    if(Q_UNLIKELY(index == nullptr)){
+        // double-checked: only one thread builds the index for a slot
+        QMutexLocker locker(&lookupIndexLock);
+        index = entry.loadAcquire();
+        if(index == nullptr){
+            index = buildLookupIndex(slot);
+            entry.storeRelease(index);
+        }
+    }
+    return *index;
+}
+
+IRRootInstance::LookupIndex* IRRootInstance::buildLookupIndex(int slot) const
+{
+    std::unique_ptr<LookupIndex> index(new LookupIndex);
+    const IndexRange& range = childTypeRange.at(slot);
+    if(range.count == 0)
+        return index.release();
+
+    int childTypeIndex = nodeTypeIndex.at(childByType.at(range.start));
+    const IRNodeType& childTy = ty.getNodeType(childTypeIndex);
+    const NodeTypeTable& childTable = typeTables.at(childTypeIndex);
+    index->perParamHash.resize(childTy.getNumParameter());
+    index->perParamGroup.resize(childTy.getNumParameter());
+    for(int i = 0, numParam = childTy.getNumParameter(); i < numParam; ++i){
+        const ParameterColumn& column = childTable.columns.at(i);
+        if(childTy.getParameterIsUnique(i)){
+            switch(column.ty){
+            case ValueType::Int64:
+                buildUniqueKeyHash(index->perParamHash[i].intKey, column.intData, nodeRow, childByType, range.start, range.start + range.count);
+                break;
+            case ValueType::String:
+                buildUniqueKeyHash(index->perParamHash[i].stringKey, column.stringData, nodeRow, childByType, range.start, range.start + range.count);
+                break;
+            default: Q_UNREACHABLE();
+            }
+        }else if(childTy.getParameterIsIndexed(i)){
+            SecondaryKeyIndex& group = index->perParamGroup[i];
+            switch(column.ty){
+            case ValueType::Int64:
+                buildSecondaryKeyIndex(group.intKey, group.nodeList, column.intData, nodeRow, childByType, range.start, range.start + range.count);
+                break;
+            case ValueType::String:
+                buildSecondaryKeyIndex(group.stringKey, group.nodeList, column.stringData, nodeRow, childByType, range.start, range.start + range.count);
+                break;
+            default: Q_UNREACHABLE();
+            }
+        }
+    }
+    return index.release();
+}
+
+const int* IRConstNodeInstance::findChildNodesWithKey(int nodeLocalTypeIndex, int nodeParamIndex, const QVariant& key, int& count) const
+{
+    count = 0;
+    const IRRootInstance::LookupIndex& index = root->getLookupIndex(root->childTypeSlotStart.at(nodeIndex) + nodeLocalTypeIndex);
+    if(nodeParamIndex < 0 || nodeParamIndex >= index.perParamHash.size())
+        return nullptr;
+
+    bool isIntKey = false;
+    qint64 intKey = 0;
+    switch(static_cast<QMetaType::Type>(key.userType())){
+    case QMetaType::LongLong:{
+        isIntKey = true;
+        intKey = key.toLongLong();
+    }break;
+    case QMetaType::QString:{
+        intKey = root->stringPool.find(key.toString());
+        if(intKey == -1)
+            return nullptr;
+    }break;
+    default: return nullptr;
+    }
+
+    const IRRootInstance::UniqueKeyHash& hash = index.perParamHash.at(nodeParamIndex);
+    if(!hash.intKey.isEmpty() || !hash.stringKey.isEmpty()){
+        // unique parameter: at most one match, pointing into the hash
+        if(isIntKey){
+            auto iter = hash.intKey.constFind(intKey);
+            if(iter == hash.intKey.constEnd())
+                return nullptr;
+            count = 1;
+            return &iter.value();
+        }
+        auto iter = hash.stringKey.constFind(static_cast<int>(intKey));
+        if(iter == hash.stringKey.constEnd())
+            return nullptr;
+        count = 1;
+        return &iter.value();
+    }
+
+    const IRRootInstance::SecondaryKeyIndex& group = index.perParamGroup.at(nodeParamIndex);
+    IRRootInstance::IndexRange range = isIntKey? group.intKey.value(intKey) : group.stringKey.value(static_cast<int>(intKey));
+    if(range.count == 0)
+        return nullptr;
+    count = range.count;
+    return group.nodeList.constData() + range.start;
+}
+
+int IRRootInstance::addNode(int typeIndex)
+{
+    isValidated = false;
+    isStructureDirty = true;
+    return appendNode(typeIndex);
+}
+
+int IRRootInstance::appendNode(int typeIndex)
+{
+    int index = nodeTypeIndex.size();
+    nodeTypeIndex.push_back(typeIndex);
+    nodeParent.push_back(-1);
+    if(ty.isNodeTypeIndexValid(typeIndex)){
+        NodeTypeTable& table = typeTables[typeIndex];
+        nodeRow.push_back(table.nodeList.size());
+        table.nodeList.push_back(index);
+        for(auto& column : table.columns){
+            switch(column.ty){
+            case ValueType::Int64:  column.intData.push_back(0); break;
+            case ValueType::String: column.stringData.push_back(0); break; // empty string
+            default: Q_UNREACHABLE();
+            }
+        }
+        if(!table.columns.isEmpty()){
+            // no parameter provided yet; validate() reports a count mismatch until they are set
+            badParameterTypes.insert(index, QVector<ValueType>());
+        }
+    }else{
+        // the node will be rejected by validate()
+        nodeRow.push_back(-1);
+    }
+    return index;
+}
+
+void IRRootInstance::buildChildList()
+{
+    int numNode = nodeTypeIndex.size();
+    if(pendingChildEdges.isEmpty() && childStart.size() == numNode+1)
+        return;
+
+    // merge existing child list with pending edges
+    // existing children come first, then pending ones in the order they are added
+    int numOldNode = childStart.size()-1;
+    QVector<int> newChildStart(numNode+1, 0);
+    for(int i = 0; i < numOldNode; ++i){
+        newChildStart[i+1] = childStart.at(i+1) - childStart.at(i);
+    }
+    for(const auto& edge : pendingChildEdges){
+        newChildStart[edge.parent+1] += 1;
+    }
+    for(int i = 0; i < numNode; ++i){
+        newChildStart[i+1] += newChildStart.at(i);
+    }
+
+    QVector<int> newChildList(newChildStart.back());
+    QVector<int> cursor(newChildStart);
+    for(int i = 0; i < numOldNode; ++i){
+        for(int j = childStart.at(i), n = childStart.at(i+1); j < n; ++j){
+            newChildList[cursor[i]++] = childList.at(j);
+        }
+    }
+    for(const auto& edge : pendingChildEdges){
+        newChildList[cursor[edge.parent]++] = edge.child;
+    }
+
+    childStart.swap(newChildStart);
+    childList.swap(newChildList);
+    pendingChildEdges.clear();
+}
+
+void IRNodeInstance::addChildNode(int childIndex)
+{
+    mutableRoot->pendingChildEdges.push_back(IRRootInstance::ChildEdge{nodeIndex, childIndex});
+    mutableRoot->isStructureDirty = true;
+}
+
+void IRNodeInstance::setParent(int index)
+{
+    int& parent = mutableRoot->nodeParent[nodeIndex];
+    if(parent != index){
+        parent = index;
+        mutableRoot->isStructureDirty = true;
+    }
+}
+
+void IRNodeInstance::setParameters(const QList<QVariant>& parameters)
+{
+    QList<IRParameterValue> values;
+    values.reserve(parameters.size());
+    for(const auto& param : parameters){
+        values.push_back(IRParameterValue::fromVariant(param));
+    }
+    setParameters(values);
+}
+
+void IRNodeInstance::setParameters(const QList<IRParameterValue>& parameters)
+{
+    if(mutableRoot->nodeRow.at(nodeIndex) >= 0){
+        mutableRoot->dirtyNodes.push_back(nodeIndex);
+    }
+    mutableRoot->storeParameters(nodeIndex, parameters);
+}
+
+void IRRootInstance::storeParameters(int nodeIndex, const QList<IRParameterValue>& parameters)
+{
+    int row = nodeRow.at(nodeIndex);
+    if(row < 0){
+        // bad node type; nothing to store
+        return;
+    }
+    NodeTypeTable& table = typeTables[nodeTypeIndex.at(nodeIndex)];
+    bool isMatching = (parameters.size() == table.columns.size());
+    for(int i = 0, n = parameters.size(); isMatching && i < n; ++i){
+        isMatching = (parameters.at(i).getType() == table.columns.at(i).ty);
+    }
+    if(Q_UNLIKELY(!isMatching)){
+        // keep the given types so that validate() can report them
+        QVector<ValueType> types;
+        types.reserve(parameters.size());
+        for(const auto& param : parameters){
+            types.push_back(param.getType());
+        }
+        badParameterTypes.insert(nodeIndex, types);
+        return;
+    }
+    badParameterTypes.remove(nodeIndex);
+    for(int i = 0, n = parameters.size(); i < n; ++i){
+        ParameterColumn& column = table.columns[i];
+        const IRParameterValue& value = parameters.at(i);
+        switch(column.ty){
+        case ValueType::Int64:  column.intData[row] = value.toInt64(); break;
+        case ValueType::String: column.stringData[row] = stringPool.intern(value.toString()); break;
+        default: Q_UNREACHABLE();
+        }
+    }
+}
+
+bool IRRootInstance::recordParameterType(int nodeIndex, int parameterIndex, ValueType givenTy)
+{
+    if(nodeRow.at(nodeIndex) < 0){
+        // bad node type; nothing to store
+        return false;
+    }
+    const NodeTypeTable& table = typeTables.at(nodeTypeIndex.at(nodeIndex));
+    int numParam = table.columns.size();
+    if(Q_UNLIKELY(parameterIndex < 0 || parameterIndex >= numParam)){
+        return false;
+    }
+    bool isMatching = (table.columns.at(parameterIndex).ty == givenTy);
+    auto iter = badParameterTypes.find(nodeIndex);
+    if(iter == badParameterTypes.end()){
+        if(Q_LIKELY(isMatching))
+            return true;
+        // all other parameters are good
+        QVector<ValueType> types;
+        types.reserve(numParam);
+        for(const auto& column : table.columns){
+            types.push_back(column.ty);
+        }
+        iter = badParameterTypes.insert(nodeIndex, types);
+    }
+    QVector<ValueType>& types = iter.value();
+    if(types.size() != numParam){
+        // parameters were never (successfully) set; mark the others as missing
+        types.fill(ValueType::Void, numParam);
+    }
+    types[parameterIndex] = givenTy;
+    bool isAllMatching = true;
+    for(int i = 0; isAllMatching && i < numParam; ++i){
+        isAllMatching = (types.at(i) == table.columns.at(i).ty);
+    }
+    if(isAllMatching){
+        badParameterTypes.erase(iter);
+    }
+    return isMatching;
+}
+
+void IRNodeInstance::setParameter(int parameterIndex, qint64 value)
+{
+    mutableRoot->dirtyNodes.push_back(nodeIndex);
+    if(Q_UNLIKELY(!mutableRoot->recordParameterType(nodeIndex, parameterIndex, ValueType::Int64)))
+        return;
+    IRRootInstance::ParameterColumn& column = mutableRoot->typeTables[getTypeIndex()].columns[parameterIndex];
+    column.intData[mutableRoot->nodeRow.at(nodeIndex)] = value;
+}
+
+void IRNodeInstance::setParameter(int parameterIndex, const QString& value)
+{
+    mutableRoot->dirtyNodes.push_back(nodeIndex);
+    if(Q_UNLIKELY(!mutableRoot->recordParameterType(nodeIndex, parameterIndex, ValueType::String)))
+        return;
+    IRRootInstance::ParameterColumn& column = mutableRoot->typeTables[getTypeIndex()].columns[parameterIndex];
+    column.stringData[mutableRoot->nodeRow.at(nodeIndex)] = mutableRoot->stringPool.intern(value);
+}
+
+quint64 IRRootInstance::computeNodeHash(int nodeIndex) const
+{
+    int typeIndex = nodeTypeIndex.at(nodeIndex);
+    quint64 hash = mixHash(0, static_cast<quint64>(typeIndex));
+    const NodeTypeTable& table = typeTables.at(typeIndex);
+    int row = nodeRow.at(nodeIndex);
+    for(const auto& column : table.columns){
+        switch(column.ty){
+        case ValueType::Int64:  hash = mixHash(hash, static_cast<quint64>(column.intData.at(row))); break;
+        case ValueType::String: hash = mixHash(hash, hashString(stringPool.get(column.stringData.at(row)))); break;
+        default: Q_UNREACHABLE();
+        }
+    }
+    int first = childStart.at(nodeIndex);
+    int last = childStart.at(nodeIndex+1);
+    hash = mixHash(hash, static_cast<quint64>(last - first));
+    for(int i = first; i < last; ++i){
+        hash = mixHash(hash, subtreeHash.at(childList.at(i)));
+    }
+    return hash;
+}
+
+void IRRootInstance::buildSubtreeHash()
+{
+    // nodes are in pre-order, so children are always hashed before their parent
+    int numNode = nodeTypeIndex.size();
+    subtreeHash.fill(0, numNode);
+    for(int i = numNode-1; i >= 0; --i){
+        subtreeHash[i] = computeNodeHash(i);
+    }
+}
+
+void IRRootInstance::updateSubtreeHash(const QVector<int>& changedNodes)
+{
+    // rehash changed nodes and their ancestors, deepest (largest index) first
+    QVector<int> pending;
+    QSet<int> visited;
+    for(int nodeIndex : changedNodes){
+        for(int current = nodeIndex; current >= 0 && !visited.contains(current); current = nodeParent.at(current)){
+            visited.insert(current);
+            pending.push_back(current);
+        }
+    }
+    std::sort(pending.begin(), pending.end(), std::greater<int>());
+    for(int nodeIndex : pending){
+        subtreeHash[nodeIndex] = computeNodeHash(nodeIndex);
+    }
+}
+
+int IRInstanceReaderBase::getIndexUnderType(int nodeIndex) const
+{
+    int parent = getParentIndex(nodeIndex);
+    if(parent < 0)
+        return 0;
+    int localTyIndex = getLocalTypeIndex(parent, getTypeIndex(nodeIndex));
+    for(int i = 0, num = getNumChildNodeUnderType(parent, localTyIndex); i < num; ++i){
+        if(getChildNodeIndex(parent, localTyIndex, i) == nodeIndex)
+            return i;
+    }
+    Q_UNREACHABLE();
+    return -1;
+}
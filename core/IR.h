@@ -4,16 +4,25 @@
 #include <QCoreApplication>
 #include <QVariant>
 #include <QString>
+#include <QByteArray>
 #include <QList>
 #include <QStringList>
 #include <QHash>
+#include <QVector>
+#include <QMutex>
+#include <QAtomicPointer>
 
 #include "core/Value.h"
+#include "util/ChunkedVector.h"
+
+#include <memory>
+#include <stdexcept>
 
 class DiagnosticEmitterBase;
 
 class IRNodeType;
 class IRRootType;
+class IRConstNodeInstance;
 class IRNodeInstance;
 class IRRootInstance;
 
@@ -38,6 +47,7 @@ public:
     QString     getParameterName    (int parameterIndex) const {return parameterNameList.at(parameterIndex);}
     ValueType   getParameterType    (int parameterIndex) const {return parameterList.at(parameterIndex).paramType;}
     bool        getParameterIsUnique(int parameterIndex) const {return parameterList.at(parameterIndex).isUnique;}
+    bool        getParameterIsIndexed(int parameterIndex)const {return parameterList.at(parameterIndex).isIndexed;}
 
     int getPrimaryKeyParameterIndex()const{return primaryKeyIndex;}
 
@@ -57,11 +67,13 @@ public:
     void addChildNode(QString childNodeName)    {childNodeList.push_back(childNodeName);}
     void setPrimaryKey(QString paramName)       {primaryKeyName = paramName;}
 
-    void addParameter(QString name, ValueType paramType, bool isUnique){
+    // isIndexed: keep a secondary (value -> children) index on a non-unique parameter for lookup by value
+    void addParameter(QString name, ValueType paramType, bool isUnique, bool isIndexed = false){
         parameterNameList.push_back(name);
         Parameter param;
         param.paramType = paramType;
         param.isUnique = isUnique;
+        param.isIndexed = isIndexed;
         parameterList.push_back(param);
     }
 
@@ -73,8 +85,9 @@ private:
     struct Parameter{
         ValueType paramType;
         bool isUnique;
+        bool isIndexed;
         bool operator==(const Parameter& rhs)const{
-            return paramType == rhs.paramType && isUnique == rhs.isUnique;
+            return paramType == rhs.paramType && isUnique == rhs.isUnique && isIndexed == rhs.isIndexed;
         }
     };
     QString name;
@@ -111,6 +124,7 @@ public:
     int getNodeTypeIndex(const QString& nodeName) const {return nodeNameToIndex.value(nodeName, -1);}
 
     int  getNumNodeType()                const {return nodeList.size();}
+    int  getRootNodeTypeIndex()          const {return rootNodeIndex;}   //!< only available after validate(); -1 if no root node type is set
     bool isNodeTypeIndexValid(int index) const {return (index >= 0) && (index < nodeList.size());}
 
     const IRNodeType&   getNodeType (int index)               const {return nodeList.at(index);}
@@ -139,101 +153,732 @@ private:
     bool isValidated  = false;
 };
 
-class IRNodeInstance
+/**
+ * @brief The IRParameterValue class is a typed cell holding one IR node parameter
+ *
+ * IR parameters are either Int64 or String (see isValidIRValueType()); the integer is stored inline.
+ * A default constructed cell has type Void and is never accepted as a parameter.
+ */
+class IRParameterValue
 {
-    Q_DECLARE_TR_FUNCTIONS(IRNodeInstance)
+public:
+    IRParameterValue() = default;
+    IRParameterValue(qint64 value): ty(ValueType::Int64), intValue(value){}
+    IRParameterValue(const QString& value): ty(ValueType::String), stringValue(value){}
+
+    ValueType       getType()   const {return ty;}
+    qint64          toInt64()   const {Q_ASSERT(ty == ValueType::Int64);  return intValue;}
+    const QString&  toString()  const {Q_ASSERT(ty == ValueType::String); return stringValue;}
+
+    QVariant toVariant() const{
+        switch(ty){
+        case ValueType::Int64:  return QVariant(intValue);
+        case ValueType::String: return QVariant(stringValue);
+        default:                return QVariant();
+        }
+    }
+    static IRParameterValue fromVariant(const QVariant& value){
+        switch(static_cast<QMetaType::Type>(value.userType())){
+        case QMetaType::LongLong:   return IRParameterValue(value.toLongLong());
+        case QMetaType::QString:    return IRParameterValue(value.toString());
+        default:                    return IRParameterValue();
+        }
+    }
+
+private:
+    ValueType ty = ValueType::Void;
+    qint64 intValue = 0;
+    QString stringValue;
+};
 
+/**
+ * @brief The IRStringPool class stores each distinct string parameter value of an IRRootInstance once
+ *
+ * Strings are referenced by id; id 0 is always the empty string.
+ * Equal strings always get the same id, so string equality can be checked by comparing ids.
+ *
+ * In Utf16 mode each string is a QString; in Utf8 mode all strings are encoded into one byte buffer
+ * and get() decodes them on each call. Utf8 mode roughly halves the size of mostly-ASCII text and saves the
+ * per-string heap header, at the cost of a conversion whenever a QString is needed.
+ *
+ * Copies of a pool (see IRRootInstance::createSnapshot()) share storage: strings are kept in chunks
+ * (see ChunkedVector) and the lookup hash in layers (see LayeredHash), so interning a new string into a copy
+ * costs O(1) amortized chunk copies plus O(log n) amortized hash entry copies, instead of copying the pool.
+ */
+class IRStringPool
+{
 public:
-    explicit IRNodeInstance(int typeIndex, int nodeIndex)
-        : typeIndex(typeIndex), nodeIndex(nodeIndex){}
+    enum class StorageMode{
+        Utf16,
+        Utf8
+    };
 
-    //-------------------------------------------------------------------------
-    // const interface
+    IRStringPool();
+
+    int             intern(const QString& str);
+    int             find(const QString& str)    const;
+    QString         get(int id)                 const {
+        if(mode == StorageMode::Utf16)
+            return strings.at(id);
+        int start = utf8Start.at(id);
+        int length = utf8Start.at(id + 1) - start;
+        const QVector<char>& chunk = utf8Data.getChunk(start >> Utf8ChunkShift);
+        int offset = start & (Utf8Buffer::ChunkSize - 1);
+        if(Q_LIKELY(offset + length <= chunk.size()))
+            return QString::fromUtf8(chunk.constData() + offset, length);
+        return QString::fromUtf8(getUtf8(start, length));
+    }
+    int             size()                      const {return (mode == StorageMode::Utf16)? strings.size() : utf8Start.size() - 1;}
 
-    const QVariant& getParameter(int parameterIndex)    const {return parameters.at(parameterIndex);}
+    StorageMode getStorageMode() const {return mode;}
+    /**
+     * @brief setStorageMode convert the pool to the given storage mode; string ids are not changed
+     */
+    void setStorageMode(StorageMode newMode);
 
-    int getTypeIndex()                                  const {return typeIndex;}
-    int getParentIndex()                                const {return parentIndex;}
-    int getLocalTypeIndex       (int tyIndex)           const {return childNodeTypeIndexToLocalIndex.value(tyIndex, -1);}
+    /**
+     * @brief getMemoryUsage estimates the number of bytes used by the pool, including string data and the lookup hash
+     */
+    qint64 getMemoryUsage() const;
 
-    int getNumChildNode()                               const {return childNodeList.size();}
-    int getChildNodeByOrder     (int nodeIndex)         const {return childNodeList.at(nodeIndex);}
-    int getNumChildNodeUnderType(int nodeLocalTypeIndex)const {return childTypeList.at(nodeLocalTypeIndex).nodeList.size();}
+private:
+    /**
+     * @brief The LayeredHash struct is a lookup hash that stays shared among copies of the pool
+     *
+     * Inserts go to top. When top is shared with a copy, the first insert freezes it into a (shared) layer
+     * instead of detaching it; a layer is merged into the one before it when it is at least half its size,
+     * so there are O(log n) layers and each entry is copied O(log n) times in total.
+     */
+    template<typename Hash>
+    struct LayeredHash{
+        QVector<std::shared_ptr<const Hash>> layers;    //!< frozen layers, oldest first
+        Hash top;
+
+        // call before inserting into top
+        void prepareInsert();
+        qint64 getMemoryUsage() const;
+    };
 
-    int getChildNodeIndex(int nodeLocalTypeIndex, int nodeParamIndex, const QVariant& key)const{
-        return childTypeList.at(nodeLocalTypeIndex).perParamHash.at(nodeParamIndex).value(key, -1);
-    }
-    int getChildNodeIndex(int nodeLocalTypeIndex, int nodeIndexUnderType)const{
-        return childTypeList.at(nodeLocalTypeIndex).nodeList.at(nodeIndexUnderType);
-    }
+    static const int Utf8ChunkShift = 16;
+    typedef ChunkedVector<char, Utf8ChunkShift> Utf8Buffer;
 
-    //-------------------------------------------------------------------------
+    QByteArray getUtf8(int start, int length) const;
+    int findUtf8(const QByteArray& utf8, uint hash) const;
+    void appendUtf8(const QByteArray& utf8, uint hash);
+
+    StorageMode mode = StorageMode::Utf16;
 
-    void addChildNode   (int childIndex)                    {childNodeList.append(childIndex);}
-    void setParent      (int index)                         {parentIndex = index;}
-    void setParameters  (const QList<QVariant>& parameters) {this->parameters = parameters;}
+    // Utf16 mode
+    ChunkedVector<QString> strings;         //!< [id] -> string
+    LayeredHash<QHash<QString, int>> stringToId;    //!< [string] -> id
 
-    bool validate(DiagnosticEmitterBase& diagnostic, IRRootInstance& root);
+    // Utf8 mode
+    Utf8Buffer utf8Data;                    //!< all strings, UTF-8 encoded and concatenated; a string can span chunks
+    ChunkedVector<int> utf8Start;           //!< [id] -> offset in utf8Data; one extra entry at the end for the total size
+    LayeredHash<QMultiHash<uint, int>> utf8HashToId;    //!< [hash of UTF-8 bytes] -> ids with that hash
+};
+
+/**
+ * @brief The IRConstNodeInstance class is a light-weight read-only view of a node in IRRootInstance
+ *
+ * All node data is stored in IRRootInstance; this class only references the root and the node index.
+ * It is returned by the const IRRootInstance::getNode(), so that a const instance cannot be modified through it.
+ */
+class IRConstNodeInstance
+{
+public:
+    IRConstNodeInstance(const IRRootInstance& root, int nodeIndex)
+        : root(&root), nodeIndex(nodeIndex){}
+
+    QVariant getParameter(int parameterIndex)           const;
+
+    /**
+     * @brief getParameterAs reads a parameter directly from its typed storage
+     * @tparam T qint64 for Int64 parameters, QString for String parameters; must match IRNodeType::getParameterType()
+     * Strings are returned by value since they may be decoded from UTF-8 (see IRStringPool::StorageMode).
+     * Cost of a String read depends on the storage mode of the pool:
+     *   - Utf16: a copy of an implicitly shared QString (reference count increment, no allocation)
+     *   - Utf8:  a UTF-8 decode into a newly allocated QString on every call
+     * Callers reading the same string parameter repeatedly in Utf8 mode should keep the result.
+     */
+    template<typename T>
+    T getParameterAs(int parameterIndex)                const;
+
+    int getNodeIndex()                                  const {return nodeIndex;}
+    int getTypeIndex()                                  const;
+    int getParentIndex()                                const;
+    int getLocalTypeIndex       (int tyIndex)           const;
+
+    // following functions are only available after IRRootInstance::validate()
+    int getNumChildNode()                               const;
+    int getChildNodeByOrder     (int nodeIndex)         const;
+    int getNumChildNodeUnderType(int nodeLocalTypeIndex)const;
+    // position of this node among children of its parent (all children / children of the same type); 0 for root
+    int getOrderInParent()                              const;
+    int getIndexUnderType()                             const;
+
+    int getChildNodeIndex(int nodeLocalTypeIndex, int nodeParamIndex, const QVariant& key)const;
+    int getChildNodeIndex(int nodeLocalTypeIndex, int nodeParamIndex, qint64 key)const;
+    int getChildNodeIndex(int nodeLocalTypeIndex, int nodeParamIndex, const QString& key)const;
+    int getChildNodeIndex(int nodeLocalTypeIndex, int nodeIndexUnderType)const;
+
+    // lookup by value of a unique or indexed parameter; matching children are in document order
+    int getNumChildNodeWithKey  (int nodeLocalTypeIndex, int nodeParamIndex, const QVariant& key)const;
+    int getChildNodeIndexWithKey(int nodeLocalTypeIndex, int nodeParamIndex, const QVariant& key, int ordinal)const;
+
+protected:
+    const IRRootInstance* root;
+    int nodeIndex;
 
 private:
-    struct ChildTypeRecord{
-        QList<QHash<QVariant, int>> perParamHash;   //!< lazily constructed hash table; [paramIndex][unique'd param value] -> [child node]
-        QList<int> nodeList;                        //!< node index list
-    };
+    // return the first of matching children (contiguous), or nullptr if none
+    const int* findChildNodesWithKey(int nodeLocalTypeIndex, int nodeParamIndex, const QVariant& key, int& count)const;
+};
 
-    const int typeIndex;
-    const int nodeIndex;
-    int parentIndex   = -1;
-    QList<QVariant> parameters;
-    QList<int> childNodeList;
+/**
+ * @brief The IRNodeInstance class is a light-weight view of a node in IRRootInstance that can also modify it
+ *
+ * Only the non-const IRRootInstance::getNode() returns it.
+ */
+class IRNodeInstance : public IRConstNodeInstance
+{
+public:
+    IRNodeInstance(IRRootInstance& root, int nodeIndex)
+        : IRConstNodeInstance(root, nodeIndex), mutableRoot(&root){}
 
-    // constructed during validate()
-    QHash<int, int> childNodeTypeIndexToLocalIndex; // childnode.getTypeIndex() --> ty.childIndex
-    QList<ChildTypeRecord> childTypeList;// one per child node type
+    void addChildNode   (int childIndex);
+    void setParent      (int index);
+    void setParameters  (const QList<QVariant>& parameters);
+    void setParameters  (const QList<IRParameterValue>& parameters);
+    // typed setters; the type must match IRNodeType::getParameterType()
+    void setParameter   (int parameterIndex, qint64 value);
+    void setParameter   (int parameterIndex, const QString& value);
+
+private:
+    IRRootInstance* mutableRoot;
 };
 
+/**
+ * @brief The IRMemoryUsage struct is an estimated breakdown (in bytes) of memory used by an IRRootInstance
+ *
+ * Storage shared with snapshots (see IRRootInstance::createSnapshot()) is counted in each instance.
+ */
+struct IRMemoryUsage{
+    qint64 nodeStructure    = 0;    //!< per node type index, parent and row; per type node lists; edit tracking
+    qint64 childList        = 0;    //!< CSR child list, pending child edges and per child type ranges
+    qint64 intParameter     = 0;    //!< Int64 parameter columns
+    qint64 stringParameter  = 0;    //!< String parameter columns (string id only)
+    qint64 stringPool       = 0;    //!< string data and its lookup hash
+    qint64 lookupIndex      = 0;    //!< uniqueness hashes and secondary indexes built so far
+    qint64 subtreeHash      = 0;
+    qint64 other            = 0;    //!< the instance itself, per type child maps and records of bad parameters
+    QVector<qint64> perNodeType;    //!< [node type index] -> node list and parameter columns of the type (already counted above)
+
+    qint64 getTotal() const {
+        return nodeStructure + childList + intParameter + stringParameter + stringPool + lookupIndex + subtreeHash + other;
+    }
+};
+
+/**
+ * @brief The IRRootInstance class is an IR tree instance
+ *
+ * Data is stored in struct-of-arrays layout:
+ *   - type index, parent index and row index (within node type) are flat arrays indexed by node index
+ *   - children are stored in CSR form (childStart / childList, plus per-child-type ranges), built by validate()
+ *   - parameters are stored in one typed column per (node type, parameter), indexed by row index;
+ *     parameters of a newly added node are default initialized (0 or empty string)
+ * IRConstNodeInstance and IRNodeInstance provide the per-node accessors on top of it.
+ * All arrays are Qt implicitly shared containers or ChunkedVector, which createSnapshot() relies on.
+ */
 class IRRootInstance
 {
     Q_DECLARE_TR_FUNCTIONS(IRRootInstance)
+    friend class IRConstNodeInstance;
     friend class IRNodeInstance;
+    friend class IRBinaryCodec;
+    friend class IRBuilder;
+    friend class IRRootInstanceReader;
 public:
-    explicit IRRootInstance(const IRRootType& ty): ty(ty){Q_ASSERT(ty.validated());}
+    explicit IRRootInstance(const IRRootType& ty);
 
     // no copy or move because this class would be taken reference by others
     IRRootInstance(const IRRootInstance&) = delete;
     IRRootInstance(IRRootInstance&&) = delete;
+    ~IRRootInstance();
+
+    /**
+     * @brief createSnapshot create a new instance with the same content that shares storage with this one
+     *
+     * Per-node arrays (type index, parent, row), node lists and parameter columns are ChunkedVector, and the
+     * string pool keeps strings in chunks and its lookup hash in layers (see IRStringPool), so a write in either
+     * instance only copies the chunk it goes to plus the chunk directory; all other chunks stay shared.
+     * Setting a parameter and revalidate() therefore cost time and memory proportional to the edit, not to the IR.
+     * Child lists and other arrays derived by validate() are plain implicitly shared arrays; they are rebuilt as a
+     * whole after a structural edit (addNode(), setParent(), ...), so such an edit still costs O(n) on validate().
+     * This is intended for IR-to-IR transforms on the same IRRootType and for keeping old versions for diffing or undo.
+     * @return the snapshot; caller takes ownership
+     */
+    IRRootInstance* createSnapshot() const;
 
     //-------------------------------------------------------------------------
     // const interface
 
-    int                     getNumNode()            const {return nodeList.size();}
-    const IRNodeInstance&   getNode(int nodeIndex)  const {return nodeList.at(nodeIndex);}
+    int                     getNumNode()            const {return nodeTypeIndex.size();}
+    IRConstNodeInstance     getNode(int nodeIndex)  const {
+        Q_ASSERT(nodeIndex >= 0 && nodeIndex < nodeTypeIndex.size());
+        return IRConstNodeInstance(*this, nodeIndex);
+    }
 
     const IRRootType&       getType()               const {return ty;}
+    const IRStringPool&     getStringPool()         const {return stringPool;}
+    IRStringPool::StorageMode getStringStorageMode() const {return stringPool.getStorageMode();}
+
+    /**
+     * @brief getNodeListOfType get all nodes of given node type
+     * @param typeIndex node type index in IRRootType
+     * @return node indices, in ascending order (i.e. document order)
+     */
+    const ChunkedVector<int>& getNodeListOfType(int typeIndex) const {return typeTables.at(typeIndex).nodeList;}
+
+    /**
+     * @brief getMemoryUsage estimates memory used by this instance, including lookup indexes built so far
+     */
+    IRMemoryUsage           getMemoryUsage()        const;
+
+    /**
+     * @brief isParameterStorageShared whether the storage holding a parameter of a node is shared with other
+     *
+     * True when other is a snapshot of this instance (or the reverse) and neither has written to the chunk holding the
+     * value since then. This is for tests and memory diagnostics; it does not affect behavior.
+     */
+    bool isParameterStorageShared(const IRRootInstance& other, int nodeIndex, int parameterIndex) const;
 
     //-------------------------------------------------------------------------
 
-    int addNode(int typeIndex){
+    int addNode(int typeIndex);
+    IRNodeInstance getNode(int nodeIndex){
         isValidated = false;
-        int index = nodeList.size();
-        nodeList.append(IRNodeInstance(typeIndex, index));
-        return index;
-    }
-    IRNodeInstance& getNode(int nodeIndex){
-        isValidated = false;
-        if(nodeIndex < 0 || nodeList.size() <= nodeIndex){
+        if(nodeIndex < 0 || nodeTypeIndex.size() <= nodeIndex){
             throw std::out_of_range("Invalid Node Index");
         }
-        return nodeList[nodeIndex];
+        return IRNodeInstance(*this, nodeIndex);
     }
 
     bool validated() const {return isValidated;}
     bool validate(DiagnosticEmitterBase& diagnostic);
 
+    /**
+     * @brief revalidate validate the instance after edits, only re-checking nodes whose parameters changed since last successful validation
+     *
+     * It falls back to validate() if the tree structure (nodes, parents, children) changed since then,
+     * or if any problem is found, so that diagnostics are always the same as a full validation.
+     */
+    bool revalidate(DiagnosticEmitterBase& diagnostic);
+
+    /**
+     * @brief graftSubtree append a copy of another instance as the last child of a node
+     *
+     * The subtree is inserted right after the last node in the subtree of parent so that nodes stay in pre-order;
+     * indices of nodes after it are shifted in one linear pass over the arrays.
+     * Both instances must be validated and of the same IRRootType. Only uniqueness among the new siblings is checked;
+     * if it fails, the subtree is still added but the instance is no longer validated.
+     * Lookup indexes referring to shifted nodes or to the graft point are dropped; subtree hashes are kept up to date.
+     * @param parentIndex node to add the subtree under
+     * @param src the instance to copy from
+     * @param diagnostic where errors are reported
+     * @return index of the new subtree root; -1 (and nothing is changed) if src root type is not a child type of parent
+     */
+    int graftSubtree(int parentIndex, const IRRootInstance& src, DiagnosticEmitterBase& diagnostic);
+
+    /**
+     * @brief setParallelValidation enable validating subtrees on a thread pool in validate()
+     *
+     * Diagnostics from subtrees are buffered and replayed in the same order as serial validation.
+     * @param threshold minimum number of nodes to validate in parallel; 0 disables parallel validation
+     * @param maxThreadCount maximum number of threads; 0 to use QThread::idealThreadCount()
+     */
+    void setParallelValidation(int threshold, int maxThreadCount = 0){
+        parallelValidationThreshold = threshold;
+        parallelValidationThreadCount = maxThreadCount;
+    }
+
+    /**
+     * @brief setStringStorageMode choose how String parameter values are stored; see IRStringPool::StorageMode
+     *
+     * Existing strings are converted; string ids, lookup indexes and subtree hashes are not affected.
+     */
+    void setStringStorageMode(IRStringPool::StorageMode mode){stringPool.setStorageMode(mode);}
+
+    /**
+     * @brief setSubtreeHashEnabled enable computing a content hash of each subtree on validate() and revalidate()
+     *
+     * The hash of a node covers its type, its parameter values and the hashes of its children in order,
+     * so two subtrees (in the same or different instances of the same IRRootType) with equal hash have the same content
+     * barring hash collision. It is stable across runs; node indices are not part of it.
+     */
+    void setSubtreeHashEnabled(bool enabled){
+        isSubtreeHashEnabled = enabled;
+        if(!enabled){
+            subtreeHash.clear();
+        }else if(isValidated && subtreeHash.isEmpty()){
+            buildSubtreeHash();
+        }
+    }
+    // only available after validation with subtree hash enabled
+    bool    hasSubtreeHash()                const {return isValidated && !subtreeHash.isEmpty();}
+    quint64 getSubtreeHash(int nodeIndex)   const {return subtreeHash.at(nodeIndex);}
+
 private:
+    struct ValidateTaskTable;
+    // reachability, parent consistency and pre-order of the CSR child list; part of validate()
+    bool checkTreeStructure(DiagnosticEmitterBase& diagnostic) const;
+    bool validateNode(DiagnosticEmitterBase& diagnostic, int nodeIndex, const ValidateTaskTable* tasks = nullptr) const;
+    void runValidateTasks(ValidateTaskTable& tasks) const;
+    bool checkUniqueParameters(DiagnosticEmitterBase& diagnostic, int slot, int childTypeIndex) const;
+    void buildChildList();
+    void buildChildTypeIndex();
+    void buildNodeOrdinal();
+    quint64 computeNodeHash(int nodeIndex) const;
+    void buildSubtreeHash();
+    void updateSubtreeHash(const QVector<int>& changedNodes);
+
+    // append a node with default parameters, marked as not set for validate(); no dirty tracking
+    int appendNode(int typeIndex);
+    // write parameters of a node, or record their types for validate() if they do not match; no dirty tracking
+    void storeParameters(int nodeIndex, const QList<IRParameterValue>& parameters);
+    // update badParameterTypes for a single parameter write of given type; return whether the value can be stored
+    bool recordParameterType(int nodeIndex, int parameterIndex, ValueType givenTy);
+
+    struct ChildEdge{
+        int parent;
+        int child;
+    };
+    struct IndexRange{
+        int start;
+        int count;
+    };
+
+    /**
+     * @brief The ParameterColumn struct stores one parameter of all nodes with the same type
+     *
+     * Only the vector matching ty is used.
+     */
+    struct ParameterColumn{
+        ValueType ty = ValueType::Void;
+        ChunkedVector<qint64> intData;  //!< [row] -> value, for Int64 parameter
+        ChunkedVector<int> stringData;  //!< [row] -> string id in stringPool, for String parameter
+    };
+
+    /**
+     * @brief The NodeTypeTable struct stores parameters of all nodes with the same type
+     */
+    struct NodeTypeTable{
+        ChunkedVector<int> nodeList;            //!< [row] -> node index, in the order nodes are added (i.e. ascending)
+        QVector<ParameterColumn> columns;       //!< [paramIndex] -> column
+    };
+
+    /**
+     * @brief The UniqueKeyHash struct maps unique'd parameter value to child node; only the hash matching parameter type is used
+     */
+    struct UniqueKeyHash{
+        QHash<qint64, int> intKey;
+        QHash<int, int> stringKey;      //!< keyed by string id
+    };
+
+    /**
+     * @brief The SecondaryKeyIndex struct maps value of an indexed parameter to all children having it
+     *
+     * Children with the same value are consecutive in nodeList and kept in document order.
+     */
+    struct SecondaryKeyIndex{
+        QHash<qint64, IndexRange> intKey;
+        QHash<int, IndexRange> stringKey;   //!< keyed by string id
+        QVector<int> nodeList;              //!< children grouped by value; IndexRange refers to this
+    };
+
+    /**
+     * @brief The LookupIndex struct holds key lookup hashes for one slot (children of one node under one child type)
+     *
+     * It is only built on the first lookup by key on that slot; see getLookupIndex().
+     */
+    struct LookupIndex{
+        QVector<UniqueKeyHash> perParamHash;        //!< [paramIndex] -> hash; empty for non-unique parameter
+        QVector<SecondaryKeyIndex> perParamGroup;   //!< [paramIndex] -> index; empty for parameter not indexed
+    };
+
+    const LookupIndex& getLookupIndex(int slot) const;
+    LookupIndex* buildLookupIndex(int slot) const;
+    void resetLookupIndex(int numSlot);
+
     const IRRootType& ty;
     bool isValidated = false;
-    QList<IRNodeInstance> nodeList;// must be stored in pre-order; node 0 is root
+    int parallelValidationThreshold = 0;
+    int parallelValidationThreadCount = 0;
+    bool isSubtreeHashEnabled = false;
+
+    // edit tracking for revalidate()
+    bool isStructureDirty = true;   //!< whether tree structure changed (or never validated successfully) since last successful validate()
+    QVector<int> dirtyNodes;        //!< nodes whose parameters are set since last successful validate()
+
+    // all nodes must be stored in pre-order; node 0 is root
+    ChunkedVector<int> nodeTypeIndex;   //!< [node] -> node type index
+    ChunkedVector<int> nodeParent;      //!< [node] -> parent node index; -1 for root
+    ChunkedVector<int> nodeRow;         //!< [node] -> row in NodeTypeTable; -1 if the type index is invalid
+
+    QVector<NodeTypeTable> typeTables;          //!< [node type index] -> table
+    IRStringPool stringPool;                    //!< values of all String parameters
+    QHash<int, QVector<ValueType>> badParameterTypes; //!< [node] -> types of parameters provided (Void if not set), for nodes whose parameters do not match node type
+    QVector<QHash<int, int>> childTypeToLocal;  //!< [node type index] -> ([child node type index] -> [local child type index])
+
+    // children
+    QVector<ChildEdge> pendingChildEdges;   //!< addChildNode() records not yet merged into childStart / childList
+    QVector<int> childStart;                //!< [node] -> first child in childList; size is getNumNode()+1
+    QVector<int> childList;                 //!< children of all nodes; children of one node are consecutive and in order
+
+    // constructed during validate()
+    QVector<int> childTypeSlotStart;            //!< [node] -> first slot in childTypeRange; one slot per child type of node type
+    QVector<IndexRange> childTypeRange;         //!< [slot] -> range in childByType
+    QVector<int> childByType;                   //!< children of all nodes, grouped by local child type
+    QVector<int> nodeOrderInParent;             //!< [node] -> position in children of parent; 0 for root
+    QVector<int> nodeIndexUnderType;            //!< [node] -> position in children of parent with the same type; 0 for root
+    ChunkedVector<quint64> subtreeHash;         //!< [node] -> hash of subtree content; empty if not enabled
+    int numLookupIndex = 0;
+    std::unique_ptr<QAtomicPointer<LookupIndex>[]> lookupIndex;   //!< [slot] -> lazily built lookup index, or nullptr
+    mutable QMutex lookupIndexLock;                                 //!< serializes building of lookup index
+};
+
+//-----------------------------------------------------------------------------
+// IRConstNodeInstance accessors
+
+inline int IRConstNodeInstance::getTypeIndex() const
+{
+    return root->nodeTypeIndex.at(nodeIndex);
+}
+
+inline int IRConstNodeInstance::getParentIndex() const
+{
+    return root->nodeParent.at(nodeIndex);
+}
+
+inline int IRConstNodeInstance::getLocalTypeIndex(int tyIndex) const
+{
+    return root->childTypeToLocal.at(getTypeIndex()).value(tyIndex, -1);
+}
+
+template<>
+inline qint64 IRConstNodeInstance::getParameterAs<qint64>(int parameterIndex) const
+{
+    const IRRootInstance::ParameterColumn& column = root->typeTables.at(getTypeIndex()).columns.at(parameterIndex);
+    Q_ASSERT(column.ty == ValueType::Int64);
+    return column.intData.at(root->nodeRow.at(nodeIndex));
+}
+
+template<>
+inline QString IRConstNodeInstance::getParameterAs<QString>(int parameterIndex) const
+{
+    const IRRootInstance::ParameterColumn& column = root->typeTables.at(getTypeIndex()).columns.at(parameterIndex);
+    Q_ASSERT(column.ty == ValueType::String);
+    return root->stringPool.get(column.stringData.at(root->nodeRow.at(nodeIndex)));
+}
+
+inline QVariant IRConstNodeInstance::getParameter(int parameterIndex) const
+{
+    const IRRootInstance::ParameterColumn& column = root->typeTables.at(getTypeIndex()).columns.at(parameterIndex);
+    int row = root->nodeRow.at(nodeIndex);
+    switch(column.ty){
+    case ValueType::Int64:  return QVariant(column.intData.at(row));
+    case ValueType::String: return QVariant(root->stringPool.get(column.stringData.at(row)));
+    default: Q_UNREACHABLE();
+    }
+    return QVariant();
+}
+
+inline int IRConstNodeInstance::getNumChildNode() const
+{
+    Q_ASSERT(root->pendingChildEdges.isEmpty() && root->childStart.size() == root->getNumNode()+1);
+    return root->childStart.at(nodeIndex+1) - root->childStart.at(nodeIndex);
+}
+
+inline int IRConstNodeInstance::getChildNodeByOrder(int index) const
+{
+    Q_ASSERT(index >= 0 && index < getNumChildNode());
+    return root->childList.at(root->childStart.at(nodeIndex) + index);
+}
+
+inline int IRConstNodeInstance::getOrderInParent() const
+{
+    return root->nodeOrderInParent.at(nodeIndex);
+}
+
+inline int IRConstNodeInstance::getIndexUnderType() const
+{
+    return root->nodeIndexUnderType.at(nodeIndex);
+}
+
+inline int IRConstNodeInstance::getNumChildNodeUnderType(int nodeLocalTypeIndex) const
+{
+    return root->childTypeRange.at(root->childTypeSlotStart.at(nodeIndex) + nodeLocalTypeIndex).count;
+}
+
+inline int IRConstNodeInstance::getChildNodeIndex(int nodeLocalTypeIndex, int nodeIndexUnderType) const
+{
+    const IRRootInstance::IndexRange& range = root->childTypeRange.at(root->childTypeSlotStart.at(nodeIndex) + nodeLocalTypeIndex);
+    Q_ASSERT(nodeIndexUnderType >= 0 && nodeIndexUnderType < range.count);
+    return root->childByType.at(range.start + nodeIndexUnderType);
+}
+
+inline int IRConstNodeInstance::getChildNodeIndex(int nodeLocalTypeIndex, int nodeParamIndex, qint64 key) const
+{
+    const IRRootInstance::LookupIndex& index = root->getLookupIndex(root->childTypeSlotStart.at(nodeIndex) + nodeLocalTypeIndex);
+    if(nodeParamIndex < 0 || nodeParamIndex >= index.perParamHash.size())
+        return -1;
+    return index.perParamHash.at(nodeParamIndex).intKey.value(key, -1);
+}
+
+inline int IRConstNodeInstance::getChildNodeIndex(int nodeLocalTypeIndex, int nodeParamIndex, const QString& key) const
+{
+    int id = root->stringPool.find(key);
+    if(id == -1)
+        return -1;
+    const IRRootInstance::LookupIndex& index = root->getLookupIndex(root->childTypeSlotStart.at(nodeIndex) + nodeLocalTypeIndex);
+    if(nodeParamIndex < 0 || nodeParamIndex >= index.perParamHash.size())
+        return -1;
+    return index.perParamHash.at(nodeParamIndex).stringKey.value(id, -1);
+}
+
+inline int IRConstNodeInstance::getChildNodeIndex(int nodeLocalTypeIndex, int nodeParamIndex, const QVariant& key) const
+{
+    switch(static_cast<QMetaType::Type>(key.userType())){
+    case QMetaType::LongLong:   return getChildNodeIndex(nodeLocalTypeIndex, nodeParamIndex, key.toLongLong());
+    case QMetaType::QString:    return getChildNodeIndex(nodeLocalTypeIndex, nodeParamIndex, key.toString());
+    default:                    return -1;
+    }
+}
+
+inline int IRConstNodeInstance::getNumChildNodeWithKey(int nodeLocalTypeIndex, int nodeParamIndex, const QVariant& key) const
+{
+    int count = 0;
+    findChildNodesWithKey(nodeLocalTypeIndex, nodeParamIndex, key, count);
+    return count;
+}
+
+inline int IRConstNodeInstance::getChildNodeIndexWithKey(int nodeLocalTypeIndex, int nodeParamIndex, const QVariant& key, int ordinal) const
+{
+    int count = 0;
+    const int* first = findChildNodesWithKey(nodeLocalTypeIndex, nodeParamIndex, key, count);
+    Q_ASSERT(ordinal >= 0 && ordinal < count);
+    return first[ordinal];
+}
+
+//-----------------------------------------------------------------------------
+
+/**
+ * @brief The IRInstanceReaderBase class is the read-only view of an IR instance used by ExecutionContext
+ *
+ * Nodes are referred to by node index; the instance must be validated.
+ * IRRootInstanceReader implements it over an in-memory IRRootInstance and IRPagedInstance over a binary IR file.
+ */
+class IRInstanceReaderBase
+{
+public:
+    virtual ~IRInstanceReaderBase(){}
+
+    virtual const IRRootType& getType() const = 0;
+    virtual int getNumNode() const = 0;
+
+    virtual int getTypeIndex            (int nodeIndex) const = 0;
+    virtual int getParentIndex          (int nodeIndex) const = 0;
+    virtual int getLocalTypeIndex       (int nodeIndex, int tyIndex) const = 0;
+    virtual QVariant getParameter       (int nodeIndex, int parameterIndex) const = 0;
+
+    virtual int getNumChildNode         (int nodeIndex) const = 0;
+    virtual int getChildNodeByOrder     (int nodeIndex, int order) const = 0;
+    virtual int getNumChildNodeUnderType(int nodeIndex, int nodeLocalTypeIndex) const = 0;
+    virtual int getChildNodeIndex       (int nodeIndex, int nodeLocalTypeIndex, int nodeIndexUnderType) const = 0;
+    virtual int getChildNodeIndex       (int nodeIndex, int nodeLocalTypeIndex, int nodeParamIndex, const QVariant& key) const = 0;
+    virtual int getNumChildNodeWithKey  (int nodeIndex, int nodeLocalTypeIndex, int nodeParamIndex, const QVariant& key) const = 0;
+    virtual int getChildNodeIndexWithKey(int nodeIndex, int nodeLocalTypeIndex, int nodeParamIndex, const QVariant& key, int ordinal) const = 0;
+    // position of a node among children of its parent with the same type; 0 for root
+    // the default implementation searches the siblings
+    virtual int getIndexUnderType       (int nodeIndex) const;
+
+    // per-type node index; nodes are in document order
+    virtual int getNumNodeOfType        (int typeIndex) const = 0;
+    virtual int getNodeOfType           (int typeIndex, int ordinal) const = 0;
+
+    virtual bool    hasSubtreeHash      () const {return false;}
+    virtual quint64 getSubtreeHash      (int nodeIndex) const {Q_UNUSED(nodeIndex) Q_UNREACHABLE(); return 0;}
+};
+
+/**
+ * @brief The IRRootInstanceReader class adapts an in-memory IRRootInstance to IRInstanceReaderBase
+ *
+ * It reads the arrays of IRRootInstance directly. It is final so that callers holding it by its own type
+ * (e.g. ExecutionContext) get non-virtual, inlined access.
+ */
+class IRRootInstanceReader final : public IRInstanceReaderBase
+{
+public:
+    explicit IRRootInstanceReader(const IRRootInstance& root)
+        : root(root)
+    {
+        Q_ASSERT(root.validated());
+    }
+    virtual ~IRRootInstanceReader() override {}
+
+    virtual const IRRootType& getType() const override {return root.ty;}
+    virtual int getNumNode() const override {return root.nodeTypeIndex.size();}
+
+    virtual int getTypeIndex(int nodeIndex) const override {return root.nodeTypeIndex.at(nodeIndex);}
+    virtual int getParentIndex(int nodeIndex) const override {return root.nodeParent.at(nodeIndex);}
+    virtual int getLocalTypeIndex(int nodeIndex, int tyIndex) const override{
+        return root.childTypeToLocal.at(root.nodeTypeIndex.at(nodeIndex)).value(tyIndex, -1);
+    }
+    virtual QVariant getParameter(int nodeIndex, int parameterIndex) const override{
+        const IRRootInstance::ParameterColumn& column = root.typeTables.at(root.nodeTypeIndex.at(nodeIndex)).columns.at(parameterIndex);
+        int row = root.nodeRow.at(nodeIndex);
+        switch(column.ty){
+        case ValueType::Int64:  return QVariant(column.intData.at(row));
+        case ValueType::String: return QVariant(root.stringPool.get(column.stringData.at(row)));
+        default: Q_UNREACHABLE();
+        }
+        return QVariant();
+    }
+
+    virtual int getNumChildNode(int nodeIndex) const override{
+        return root.childStart.at(nodeIndex+1) - root.childStart.at(nodeIndex);
+    }
+    virtual int getChildNodeByOrder(int nodeIndex, int order) const override{
+        return root.childList.at(root.childStart.at(nodeIndex) + order);
+    }
+    virtual int getNumChildNodeUnderType(int nodeIndex, int nodeLocalTypeIndex) const override{
+        return root.childTypeRange.at(root.childTypeSlotStart.at(nodeIndex) + nodeLocalTypeIndex).count;
+    }
+    virtual int getChildNodeIndex(int nodeIndex, int nodeLocalTypeIndex, int nodeIndexUnderType) const override{
+        const IRRootInstance::IndexRange& range = root.childTypeRange.at(root.childTypeSlotStart.at(nodeIndex) + nodeLocalTypeIndex);
+        Q_ASSERT(nodeIndexUnderType >= 0 && nodeIndexUnderType < range.count);
+        return root.childByType.at(range.start + nodeIndexUnderType);
+    }
+    // key lookups go through the lazily built lookup index of IRRootInstance
+    virtual int getChildNodeIndex(int nodeIndex, int nodeLocalTypeIndex, int nodeParamIndex, const QVariant& key) const override{
+        return root.getNode(nodeIndex).getChildNodeIndex(nodeLocalTypeIndex, nodeParamIndex, key);
+    }
+    virtual int getNumChildNodeWithKey(int nodeIndex, int nodeLocalTypeIndex, int nodeParamIndex, const QVariant& key) const override{
+        return root.getNode(nodeIndex).getNumChildNodeWithKey(nodeLocalTypeIndex, nodeParamIndex, key);
+    }
+    virtual int getChildNodeIndexWithKey(int nodeIndex, int nodeLocalTypeIndex, int nodeParamIndex, const QVariant& key, int ordinal) const override{
+        return root.getNode(nodeIndex).getChildNodeIndexWithKey(nodeLocalTypeIndex, nodeParamIndex, key, ordinal);
+    }
+    virtual int getIndexUnderType(int nodeIndex) const override {return root.nodeIndexUnderType.at(nodeIndex);}
+
+    virtual int getNumNodeOfType(int typeIndex) const override {return root.typeTables.at(typeIndex).nodeList.size();}
+    virtual int getNodeOfType(int typeIndex, int ordinal) const override {return root.typeTables.at(typeIndex).nodeList.at(ordinal);}
+
+    virtual bool    hasSubtreeHash() const override {return root.hasSubtreeHash();}
+    virtual quint64 getSubtreeHash(int nodeIndex) const override {return root.subtreeHash.at(nodeIndex);}
+
+private:
+    const IRRootInstance& root;
 };
 
 #endif // IR_H
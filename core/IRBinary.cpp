@@ -0,0 +1,954 @@
+#include "core/IRBinary.h"
+
+#include "core/IR.h"
+#include "core/DiagnosticEmitter.h"
+
+#include <QCryptographicHash>
+#include <QFileDevice>
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <vector>
+
+namespace{
+const char BINARY_MAGIC[8] = {'S', 'U', 'P', 'P', 'I', 'R', 'B', '\0'};
+const quint32 BINARY_VERSION = 1;
+const quint32 BINARY_BYTE_ORDER_MARK = 0x01020304;
+const quint32 BINARY_FLAG_VALIDATED = 0x1;
+const int BINARY_FINGERPRINT_SIZE = 24;
+
+const QString STR_SECTION_FILE      = QStringLiteral("File");
+const QString STR_SECTION_STRING    = QStringLiteral("StringTable");
+const QString STR_SECTION_STRUCTURE = QStringLiteral("Structure");
+const QString STR_SECTION_TYPETABLE = QStringLiteral("TypeTable");
+
+struct FileHeader{
+    char magic[8];
+    quint32 version;
+    quint32 byteOrderMark;
+    quint32 flags;
+    quint32 numNodeType;
+    quint32 numNode;
+    quint32 numChildEdge;
+    quint32 numString;
+    quint32 reserved;
+    char typeFingerprint[BINARY_FINGERPRINT_SIZE];  //!< SHA-1 of IRRootType, zero padded
+    quint64 stringTableOffset;                      //!< all offsets are in bytes from start of file
+    quint64 structureOffset;
+    quint64 typeTableOffset;
+    quint64 fileSize;
+};
+static_assert (sizeof(FileHeader) % 8 == 0, "FileHeader should keep sections 8-byte aligned");
+
+quint64 alignUp(quint64 size)
+{
+    return (size + 7) & ~static_cast<quint64>(7);
+}
+
+QByteArray computeTypeFingerprint(const IRRootType& ty)
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    auto helper_addString = [&hash](const QString& str)->void{
+        QByteArray data = str.toUtf8();
+        data.append('\0');
+        hash.addData(data);
+    };
+    helper_addString(ty.getName());
+    for(int i = 0, numNodeType = ty.getNumNodeType(); i < numNodeType; ++i){
+        const IRNodeType& nodeTy = ty.getNodeType(i);
+        helper_addString(nodeTy.getName());
+        for(int j = 0, numParam = nodeTy.getNumParameter(); j < numParam; ++j){
+            helper_addString(nodeTy.getParameterName(j));
+            helper_addString(QString::number(static_cast<int>(nodeTy.getParameterType(j))));
+            helper_addString(nodeTy.getParameterIsUnique(j)? QStringLiteral("U") : QStringLiteral("N"));
+        }
+        for(int j = 0, numChild = nodeTy.getNumChildNode(); j < numChild; ++j){
+            helper_addString(nodeTy.getChildNodeName(j));
+        }
+    }
+    QByteArray result = hash.result();
+    result.resize(BINARY_FINGERPRINT_SIZE);
+    for(int i = QCryptographicHash::hashLength(QCryptographicHash::Sha1); i < BINARY_FINGERPRINT_SIZE; ++i){
+        result[i] = '\0';
+    }
+    return result;
+}
+
+// calls write(data, bytes) on each chunk of vec in order
+template<typename T, typename WriteFunc>
+void writeChunks(const ChunkedVector<T>& vec, WriteFunc write)
+{
+    for(int i = 0, n = vec.getNumChunk(); i < n; ++i){
+        const QVector<T>& chunk = vec.getChunk(i);
+        write(chunk.constData(), static_cast<quint64>(chunk.size()) * sizeof(T));
+    }
+}
+
+// appends count elements at data + offset to dest and advances offset, as long as they are inside [offset, sectionEnd)
+// data need not be aligned for T
+template<typename T>
+bool readChunks(ChunkedVector<T>& dest, int count, const uchar* data, quint64& offset, quint64 sectionEnd)
+{
+    quint64 bytes = static_cast<quint64>(count) * sizeof(T);
+    if(Q_UNLIKELY(offset > sectionEnd || bytes > sectionEnd - offset))
+        return false;
+    dest.clear();
+    dest.reserve(count);
+    T buffer[ChunkedVector<T>::ChunkSize];
+    for(int start = 0; start < count; start += ChunkedVector<T>::ChunkSize){
+        int n = qMin(count - start, static_cast<int>(ChunkedVector<T>::ChunkSize));
+        std::memcpy(buffer, data + offset, static_cast<size_t>(n) * sizeof(T));
+        dest.append(buffer, n);
+        offset += static_cast<quint64>(n) * sizeof(T);
+    }
+    return true;
+}
+
+// data must have at least min(size, sizeof(FileHeader)) bytes; size is the size of the whole file
+bool decodeHeader(const IRRootType& ty, DiagnosticEmitterBase& diagnostic, const uchar* data, quint64 size, FileHeader& header)
+{
+    if(Q_UNLIKELY(size < sizeof(FileHeader))){
+        diagnostic(Diag::Error_Binary_BadHeader);
+        return false;
+    }
+    std::memcpy(&header, data, sizeof(header));
+    if(Q_UNLIKELY(std::memcmp(header.magic, BINARY_MAGIC, sizeof(BINARY_MAGIC)) != 0 || header.byteOrderMark != BINARY_BYTE_ORDER_MARK)){
+        diagnostic(Diag::Error_Binary_BadHeader);
+        return false;
+    }
+    if(Q_UNLIKELY(header.version != BINARY_VERSION)){
+        diagnostic(Diag::Error_Binary_UnsupportedVersion, static_cast<int>(header.version), static_cast<int>(BINARY_VERSION));
+        return false;
+    }
+    QByteArray fingerprint = computeTypeFingerprint(ty);
+    if(Q_UNLIKELY(header.numNodeType != static_cast<quint32>(ty.getNumNodeType())
+                  || std::memcmp(header.typeFingerprint, fingerprint.constData(), BINARY_FINGERPRINT_SIZE) != 0)){
+        diagnostic(Diag::Error_Binary_MismatchedIRType, ty.getName());
+        return false;
+    }
+    if(Q_UNLIKELY(header.fileSize != size
+                  || header.stringTableOffset > header.structureOffset
+                  || header.structureOffset > header.typeTableOffset
+                  || header.typeTableOffset > header.fileSize
+                  || header.numNode == 0
+                  || header.numString == 0)){
+        diagnostic(Diag::Error_Binary_Truncated, STR_SECTION_FILE);
+        return false;
+    }
+    // counts must fit in int (with room for the extra entry of CSR / offset arrays) and in their sections;
+    // section sizes are divided instead of multiplying counts so that nothing can overflow
+    const quint64 maxCount = static_cast<quint64>(std::numeric_limits<int>::max()) - 1;
+    quint64 stringTableSize = header.structureOffset - header.stringTableOffset;
+    quint64 structureSize = header.typeTableOffset - header.structureOffset;
+    if(Q_UNLIKELY(header.numNode > maxCount || header.numString > maxCount || header.numChildEdge > maxCount
+                  || static_cast<quint64>(header.numString) + 1 > stringTableSize / sizeof(quint64)
+                  || static_cast<quint64>(header.numNode) * 3 + 1 + header.numChildEdge > structureSize / sizeof(qint32))){
+        diagnostic(Diag::Error_Binary_Truncated, STR_SECTION_FILE);
+        return false;
+    }
+    return true;
+}
+}
+
+class IRBinaryCodec
+{
+public:
+    static bool write(const IRRootInstance& ir, QIODevice* dest);
+    static IRRootInstance* read(const IRRootType& ty, DiagnosticEmitterBase& diagnostic, const uchar* data, quint64 size);
+};
+
+bool IRBinaryCodec::write(const IRRootInstance& irConst, QIODevice* dest)
+{
+    // merging pending addChildNode() records does not change the content of the instance
+    IRRootInstance& ir = const_cast<IRRootInstance&>(irConst);
+    ir.buildChildList();
+
+    const IRRootType& ty = ir.getType();
+    const IRStringPool& pool = ir.stringPool;
+    int numNode = ir.nodeTypeIndex.size();
+    int numNodeType = ty.getNumNodeType();
+
+    FileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, BINARY_MAGIC, sizeof(BINARY_MAGIC));
+    header.version = BINARY_VERSION;
+    header.byteOrderMark = BINARY_BYTE_ORDER_MARK;
+    header.flags = ir.validated()? BINARY_FLAG_VALIDATED : 0;
+    header.numNodeType = static_cast<quint32>(numNodeType);
+    header.numNode = static_cast<quint32>(numNode);
+    header.numChildEdge = static_cast<quint32>(ir.childList.size());
+    header.numString = static_cast<quint32>(pool.size());
+    QByteArray fingerprint = computeTypeFingerprint(ty);
+    std::memcpy(header.typeFingerprint, fingerprint.constData(), BINARY_FINGERPRINT_SIZE);
+
+    // compute section layout
+    QVector<quint64> stringStart;
+    stringStart.reserve(pool.size() + 1);
+    stringStart.push_back(0);
+    for(int i = 0, n = pool.size(); i < n; ++i){
+        stringStart.push_back(stringStart.back() + static_cast<quint64>(pool.get(i).length()));
+    }
+    quint64 offset = sizeof(FileHeader);
+    header.stringTableOffset = offset;
+    offset += alignUp(static_cast<quint64>(stringStart.size()) * sizeof(quint64) + stringStart.back() * sizeof(QChar));
+    header.structureOffset = offset;
+    offset += alignUp((static_cast<quint64>(numNode) * 3 + 1 + header.numChildEdge) * sizeof(qint32));
+    header.typeTableOffset = offset;
+    for(const auto& table : ir.typeTables){
+        quint64 numRow = static_cast<quint64>(table.nodeList.size());
+        offset += sizeof(quint64) + alignUp(numRow * sizeof(qint32));
+        for(const auto& column : table.columns){
+            offset += alignUp(numRow * ((column.ty == ValueType::Int64)? sizeof(qint64) : sizeof(qint32)));
+        }
+    }
+    header.fileSize = offset;
+
+    bool isGood = true;
+    quint64 written = 0;
+    auto helper_write = [&](const void* src, quint64 bytes)->void{
+        if(isGood && bytes > 0){
+            isGood = (dest->write(reinterpret_cast<const char*>(src), static_cast<qint64>(bytes)) == static_cast<qint64>(bytes));
+            written += bytes;
+        }
+    };
+    auto helper_pad = [&]()->void{
+        static const char zeros[8] = {0};
+        helper_write(zeros, alignUp(written) - written);
+    };
+
+    helper_write(&header, sizeof(header));
+
+    helper_write(stringStart.constData(), static_cast<quint64>(stringStart.size()) * sizeof(quint64));
+    for(int i = 0, n = pool.size(); i < n; ++i){
+        const QString& str = pool.get(i);
+        helper_write(str.constData(), static_cast<quint64>(str.length()) * sizeof(QChar));
+    }
+    helper_pad();
+    Q_ASSERT(!isGood || written == header.structureOffset);
+
+    writeChunks(ir.nodeTypeIndex, helper_write);
+    writeChunks(ir.nodeParent, helper_write);
+    helper_write(ir.childStart.constData(), static_cast<quint64>(numNode + 1) * sizeof(qint32));
+    helper_write(ir.childList.constData(), static_cast<quint64>(ir.childList.size()) * sizeof(qint32));
+    helper_pad();
+    Q_ASSERT(!isGood || written == header.typeTableOffset);
+
+    for(const auto& table : ir.typeTables){
+        quint64 numRow = static_cast<quint64>(table.nodeList.size());
+        helper_write(&numRow, sizeof(numRow));
+        writeChunks(table.nodeList, helper_write);
+        helper_pad();
+        for(const auto& column : table.columns){
+            if(column.ty == ValueType::Int64){
+                writeChunks(column.intData, helper_write);
+            }else{
+                writeChunks(column.stringData, helper_write);
+                helper_pad();
+            }
+        }
+    }
+    Q_ASSERT(!isGood || written == header.fileSize);
+    return isGood;
+}
+
+IRRootInstance* IRBinaryCodec::read(const IRRootType& ty, DiagnosticEmitterBase& diagnostic, const uchar* data, quint64 size)
+{
+    FileHeader header;
+    if(Q_UNLIKELY(!decodeHeader(ty, diagnostic, data, size, header)))
+        return nullptr;
+
+    int numNode = static_cast<int>(header.numNode);
+    int numChildEdge = static_cast<int>(header.numChildEdge);
+    std::unique_ptr<IRRootInstance> ptr(new IRRootInstance(ty));
+    IRRootInstance& ir = *ptr;
+
+    // copy bytes [offset, offset+bytes) to dest, as long as it is inside [offset, sectionEnd)
+    quint64 offset = 0;
+    auto helper_read = [&](void* dest, quint64 bytes, quint64 sectionEnd)->bool{
+        if(Q_UNLIKELY(offset > sectionEnd || bytes > sectionEnd - offset))
+            return false;
+        if(bytes > 0){
+            std::memcpy(dest, data + offset, bytes);
+        }
+        offset += bytes;
+        return true;
+    };
+
+    // string table
+    {
+        offset = header.stringTableOffset;
+        QVector<quint64> stringStart(static_cast<int>(header.numString) + 1);
+        if(Q_UNLIKELY(!helper_read(stringStart.data(), static_cast<quint64>(stringStart.size()) * sizeof(quint64), header.structureOffset))){
+            diagnostic(Diag::Error_Binary_Truncated, STR_SECTION_STRING);
+            return nullptr;
+        }
+        quint64 stringDataOffset = offset;
+        if(Q_UNLIKELY(stringStart.back() > (header.structureOffset - stringDataOffset) / sizeof(QChar))){
+            diagnostic(Diag::Error_Binary_Truncated, STR_SECTION_STRING);
+            return nullptr;
+        }
+        const QChar* stringData = reinterpret_cast<const QChar*>(data + stringDataOffset);
+        for(int i = 0, n = static_cast<int>(header.numString); i < n; ++i){
+            quint64 start = stringStart.at(i);
+            quint64 end = stringStart.at(i+1);
+            if(Q_UNLIKELY(end < start || end > stringStart.back()
+                          || end - start > static_cast<quint64>(std::numeric_limits<int>::max()))){
+                diagnostic(Diag::Error_Binary_BadData, STR_SECTION_STRING);
+                return nullptr;
+            }
+            // strings are written in id order and are distinct; id 0 is the empty string
+            int id = ir.stringPool.intern(QString(stringData + start, static_cast<int>(end - start)));
+            if(Q_UNLIKELY(id != i)){
+                diagnostic(Diag::Error_Binary_BadData, STR_SECTION_STRING);
+                return nullptr;
+            }
+        }
+    }
+
+    // structure
+    {
+        offset = header.structureOffset;
+        ir.childStart.resize(numNode + 1);
+        ir.childList.resize(numChildEdge);
+        bool isGood = readChunks(ir.nodeTypeIndex, numNode, data, offset, header.typeTableOffset)
+                   && readChunks(ir.nodeParent, numNode, data, offset, header.typeTableOffset)
+                   && helper_read(ir.childStart.data(),     static_cast<quint64>(numNode + 1) * sizeof(qint32), header.typeTableOffset)
+                   && helper_read(ir.childList.data(),      static_cast<quint64>(numChildEdge) * sizeof(qint32), header.typeTableOffset);
+        if(Q_UNLIKELY(!isGood)){
+            diagnostic(Diag::Error_Binary_Truncated, STR_SECTION_STRUCTURE);
+            return nullptr;
+        }
+        // indices are checked even for validated files so that a corrupted file cannot make us read out of bounds
+        bool isDataGood = (ir.childStart.front() == 0 && ir.childStart.back() == numChildEdge);
+        for(int i = 0; isDataGood && i < numNode; ++i){
+            isDataGood = ty.isNodeTypeIndexValid(ir.nodeTypeIndex.at(i))
+                      && ir.nodeParent.at(i) >= -1 && ir.nodeParent.at(i) < numNode
+                      && ir.childStart.at(i) <= ir.childStart.at(i+1);
+        }
+        for(int i = 0; isDataGood && i < numChildEdge; ++i){
+            isDataGood = (ir.childList.at(i) >= 0 && ir.childList.at(i) < numNode);
+        }
+        if(Q_UNLIKELY(!isDataGood)){
+            diagnostic(Diag::Error_Binary_BadData, STR_SECTION_STRUCTURE);
+            return nullptr;
+        }
+    }
+
+    // type tables
+    {
+        offset = header.typeTableOffset;
+        ir.nodeRow.fill(-1, numNode);
+        bool isGood = true;
+        bool isDataGood = true;
+        for(int tyIndex = 0, numNodeType = ir.typeTables.size(); isGood && isDataGood && tyIndex < numNodeType; ++tyIndex){
+            IRRootInstance::NodeTypeTable& table = ir.typeTables[tyIndex];
+            quint64 numRow = 0;
+            isGood = helper_read(&numRow, sizeof(numRow), header.fileSize) && numRow <= header.numNode;
+            if(!isGood)
+                break;
+            int rowCount = static_cast<int>(numRow);
+            isGood = readChunks(table.nodeList, rowCount, data, offset, header.fileSize);
+            offset = alignUp(offset);
+            for(int row = 0; isGood && isDataGood && row < rowCount; ++row){
+                int nodeIndex = table.nodeList.at(row);
+                // rows must be in ascending node order; see IRRootInstance::getNodeListOfType()
+                isDataGood = (nodeIndex >= 0 && nodeIndex < numNode
+                              && (row == 0 || nodeIndex > table.nodeList.at(row-1))
+                              && ir.nodeTypeIndex.at(nodeIndex) == tyIndex
+                              && ir.nodeRow.at(nodeIndex) == -1);
+                if(isDataGood){
+                    ir.nodeRow[nodeIndex] = row;
+                }
+            }
+            for(auto& column : table.columns){
+                if(!(isGood && isDataGood))
+                    break;
+                if(column.ty == ValueType::Int64){
+                    isGood = readChunks(column.intData, rowCount, data, offset, header.fileSize);
+                }else{
+                    isGood = readChunks(column.stringData, rowCount, data, offset, header.fileSize);
+                    offset = alignUp(offset);
+                    for(int row = 0; isGood && isDataGood && row < rowCount; ++row){
+                        int id = column.stringData.at(row);
+                        isDataGood = (id >= 0 && id < ir.stringPool.size());
+                    }
+                }
+            }
+        }
+        for(int i = 0; isGood && isDataGood && i < numNode; ++i){
+            isDataGood = (ir.nodeRow.at(i) >= 0);
+        }
+        if(Q_UNLIKELY(!isGood)){
+            diagnostic(Diag::Error_Binary_Truncated, STR_SECTION_TYPETABLE);
+            return nullptr;
+        }
+        if(Q_UNLIKELY(!isDataGood)){
+            diagnostic(Diag::Error_Binary_BadData, STR_SECTION_TYPETABLE);
+            return nullptr;
+        }
+    }
+
+    if(header.flags & BINARY_FLAG_VALIDATED){
+        // validated when written; parameters and uniqueness are trusted,
+        // but the tree structure is always checked since traversal code relies on it
+        // (a cycle would make traversal recurse forever)
+        if(Q_UNLIKELY(!ir.checkTreeStructure(diagnostic))){
+            diagnostic(Diag::Error_Binary_BadData, STR_SECTION_STRUCTURE);
+            return nullptr;
+        }
+        for(int i = 0; i < numNode; ++i){
+            const QHash<int,int>& localTypeMap = ir.childTypeToLocal.at(ir.nodeTypeIndex.at(i));
+            for(int j = ir.childStart.at(i), end = ir.childStart.at(i+1); j < end; ++j){
+                if(Q_UNLIKELY(!localTypeMap.contains(ir.nodeTypeIndex.at(ir.childList.at(j))))){
+                    diagnostic(Diag::Error_Binary_BadData, STR_SECTION_STRUCTURE);
+                    return nullptr;
+                }
+            }
+        }
+        ir.buildChildTypeIndex();
+        ir.isValidated = true;
+        ir.isStructureDirty = false;
+    }else if(Q_UNLIKELY(!ir.validate(diagnostic))){
+        return nullptr;
+    }
+    return ptr.release();
+}
+
+bool IRBinary::writeIRInstance(const IRRootInstance& ir, QIODevice* dest)
+{
+    return IRBinaryCodec::write(ir, dest);
+}
+
+IRRootInstance* IRBinary::readIRInstance(const IRRootType& ty, DiagnosticEmitterBase& diagnostic, QIODevice* src)
+{
+    Q_ASSERT(ty.validated());
+    DiagnosticPathNode pathNode(diagnostic, QCoreApplication::tr("IR Root"));
+
+    // the instance does not reference the file after loading, so the mapping is released right after
+    QFileDevice* file = qobject_cast<QFileDevice*>(src);
+    if(file){
+        qint64 size = file->size();
+        uchar* mapped = (size > 0)? file->map(0, size) : nullptr;
+        if(mapped){
+            IRRootInstance* result = IRBinaryCodec::read(ty, diagnostic, mapped, static_cast<quint64>(size));
+            file->unmap(mapped);
+            return result;
+        }
+    }
+    QByteArray data = src->readAll();
+    return IRBinaryCodec::read(ty, diagnostic, reinterpret_cast<const uchar*>(data.constData()), static_cast<quint64>(data.size()));
+}
+
+//-----------------------------------------------------------------------------
+
+IRPagedInstance::IRPagedInstance(const IRRootType& ty, const QString& fileName, int maxCachedPages)
+    : ty(ty),
+      file(fileName),
+      pageCache(std::max(maxCachedPages, 1))
+{
+}
+
+IRPagedInstance::~IRPagedInstance()
+{
+    if(mappedData){
+        file.unmap(mappedData);
+    }
+}
+
+template<typename Visitor>
+bool IRPagedInstance::scanInt32(quint64 offset, int count, Visitor visitor) const
+{
+    if(mappedData){
+        // bounds of each scanned array are checked against section ends before scanning
+        if(Q_UNLIKELY(offset > mappedSize || static_cast<quint64>(count) * sizeof(qint32) > mappedSize - offset)){
+            isReadFailed = true;
+            return false;
+        }
+        const uchar* src = mappedData + offset;
+        for(int i = 0; i < count; ++i){
+            qint32 value;
+            std::memcpy(&value, src + static_cast<quint64>(i) * sizeof(qint32), sizeof(qint32));
+            if(!visitor(i, value))
+                return false;
+        }
+        return true;
+    }
+    const int blockSize = PAGE_SIZE / static_cast<int>(sizeof(qint32));
+    QVector<qint32> block(std::min(count, blockSize));
+    for(int start = 0; start < count; start += blockSize){
+        int n = std::min(count - start, blockSize);
+        readBytes(offset + static_cast<quint64>(start) * sizeof(qint32), block.data(), static_cast<quint64>(n) * sizeof(qint32));
+        for(int i = 0; i < n; ++i){
+            if(!visitor(start + i, block.at(i)))
+                return false;
+        }
+    }
+    return !isReadFailed;
+}
+
+IRPagedInstance* IRPagedInstance::open(const IRRootType& ty, DiagnosticEmitterBase& diagnostic, const QString& fileName, int maxCachedPages)
+{
+    Q_ASSERT(ty.validated());
+    DiagnosticPathNode pathNode(diagnostic, QCoreApplication::tr("IR Root"));
+
+    std::unique_ptr<IRPagedInstance> ptr(new IRPagedInstance(ty, fileName, maxCachedPages));
+    if(Q_UNLIKELY(!ptr->file.open(QIODevice::ReadOnly))){
+        diagnostic(Diag::Error_Binary_CannotOpenFile, fileName, ptr->file.errorString());
+        return nullptr;
+    }
+    // falls back to the page cache if the file cannot be mapped
+    qint64 size = ptr->file.size();
+    ptr->mappedData = (size > 0)? ptr->file.map(0, size) : nullptr;
+    ptr->mappedSize = ptr->mappedData? static_cast<quint64>(size) : 0;
+    if(Q_UNLIKELY(!ptr->initialize(diagnostic)))
+        return nullptr;
+    return ptr.release();
+}
+
+bool IRPagedInstance::initialize(DiagnosticEmitterBase& diagnostic)
+{
+    FileHeader header;
+    QByteArray headerData = file.read(sizeof(FileHeader));
+    if(Q_UNLIKELY(headerData.size() != static_cast<int>(sizeof(FileHeader)))){
+        diagnostic(Diag::Error_Binary_BadHeader);
+        return false;
+    }
+    if(Q_UNLIKELY(!decodeHeader(ty, diagnostic, reinterpret_cast<const uchar*>(headerData.constData()), static_cast<quint64>(file.size()), header)))
+        return false;
+    // without validation there is no guarantee on the tree structure, and we cannot validate without loading
+    if(Q_UNLIKELY(!(header.flags & BINARY_FLAG_VALIDATED))){
+        diagnostic(Diag::Error_Binary_NotValidated);
+        return false;
+    }
+
+    numNode = static_cast<int>(header.numNode);
+    numString = static_cast<int>(header.numString);
+    int numChildEdge = static_cast<int>(header.numChildEdge);
+
+    // string table; string offsets are checked on read (see readString())
+    stringStartOffset = header.stringTableOffset;
+    stringDataOffset = stringStartOffset + (static_cast<quint64>(numString) + 1) * sizeof(quint64);
+    stringDataEnd = header.structureOffset;
+    if(Q_UNLIKELY(stringDataOffset > stringDataEnd)){
+        diagnostic(Diag::Error_Binary_Truncated, STR_SECTION_STRING);
+        return false;
+    }
+
+    // structure
+    nodeTypeIndexOffset = header.structureOffset;
+    nodeParentOffset = nodeTypeIndexOffset + static_cast<quint64>(numNode) * sizeof(qint32);
+    childStartOffset = nodeParentOffset + static_cast<quint64>(numNode) * sizeof(qint32);
+    childListOffset = childStartOffset + (static_cast<quint64>(numNode) + 1) * sizeof(qint32);
+    // counts are already bounded by section sizes in decodeHeader()
+    if(Q_UNLIKELY(static_cast<quint64>(numChildEdge) > (header.typeTableOffset - childListOffset) / sizeof(qint32))){
+        diagnostic(Diag::Error_Binary_Truncated, STR_SECTION_STRUCTURE);
+        return false;
+    }
+    // indices are checked in a streaming pass so that a corrupted file cannot make us go out of bounds later on
+    {
+        const IRRootType& rootTy = ty;
+        int numNodeLocal = numNode;
+        qint32 prevStart = 0;
+        bool isDataGood = scanInt32(nodeTypeIndexOffset, numNode, [&rootTy](int, qint32 value)->bool{
+                              return rootTy.isNodeTypeIndexValid(value);
+                          })
+                       && scanInt32(nodeParentOffset, numNode, [numNodeLocal](int, qint32 value)->bool{
+                              return value >= -1 && value < numNodeLocal;
+                          })
+                       && scanInt32(childStartOffset, numNode + 1, [&prevStart, numChildEdge](int i, qint32 value)->bool{
+                              bool isGood = ((i == 0)? (value == 0) : (value >= prevStart)) && value <= numChildEdge;
+                              prevStart = value;
+                              return isGood;
+                          })
+                       && prevStart == numChildEdge
+                       && scanInt32(childListOffset, numChildEdge, [numNodeLocal](int, qint32 value)->bool{
+                              return value >= 0 && value < numNodeLocal;
+                          });
+        if(Q_UNLIKELY(!isDataGood)){
+            diagnostic(Diag::Error_Binary_BadData, STR_SECTION_STRUCTURE);
+            return false;
+        }
+    }
+
+    // type tables; only offsets are kept in memory
+    int numNodeType = ty.getNumNodeType();
+    typeTables.resize(numNodeType);
+    childTypeToLocal.resize(numNodeType);
+    childLocalToType.resize(numNodeType);
+    quint64 offset = header.typeTableOffset;
+    quint64 totalRow = 0;
+    for(int tyIndex = 0; tyIndex < numNodeType; ++tyIndex){
+        const IRNodeType& nodeTy = ty.getNodeType(tyIndex);
+        NodeTypeTable& table = typeTables[tyIndex];
+        quint64 numRow = 0;
+        bool isGood = (offset <= header.fileSize && sizeof(numRow) <= header.fileSize - offset);
+        if(isGood){
+            readBytes(offset, &numRow, sizeof(numRow));
+            isGood = (numRow <= header.numNode);
+        }
+        if(Q_UNLIKELY(!isGood)){
+            diagnostic(Diag::Error_Binary_Truncated, STR_SECTION_TYPETABLE);
+            return false;
+        }
+        offset += sizeof(numRow);
+        table.numRow = static_cast<int>(numRow);
+        table.nodeListOffset = offset;
+        offset += alignUp(numRow * sizeof(qint32));
+        table.columnOffset.resize(nodeTy.getNumParameter());
+        for(int j = 0, numParam = nodeTy.getNumParameter(); j < numParam; ++j){
+            table.columnOffset[j] = offset;
+            offset += alignUp(numRow * ((nodeTy.getParameterType(j) == ValueType::Int64)? sizeof(qint64) : sizeof(qint32)));
+        }
+        if(Q_UNLIKELY(offset > header.fileSize)){
+            diagnostic(Diag::Error_Binary_Truncated, STR_SECTION_TYPETABLE);
+            return false;
+        }
+        totalRow += numRow;
+
+        // rows must be in ascending node order and of this type; together with the total row count,
+        // this ensures every node has exactly one row
+        int prevNode = -1;
+        int numNodeLocal = numNode;
+        const IRPagedInstance* self = this;
+        bool isDataGood = scanInt32(table.nodeListOffset, table.numRow, [&prevNode, numNodeLocal, self, tyIndex](int, qint32 value)->bool{
+            bool isGood = (value > prevNode && value < numNodeLocal && self->getTypeIndex(value) == tyIndex);
+            prevNode = value;
+            return isGood;
+        });
+        for(int j = 0, numParam = nodeTy.getNumParameter(); isDataGood && j < numParam; ++j){
+            if(nodeTy.getParameterType(j) == ValueType::String){
+                int numStringLocal = numString;
+                isDataGood = scanInt32(table.columnOffset.at(j), table.numRow, [numStringLocal](int, qint32 value)->bool{
+                    return value >= 0 && value < numStringLocal;
+                });
+            }
+        }
+        if(Q_UNLIKELY(!isDataGood)){
+            diagnostic(Diag::Error_Binary_BadData, STR_SECTION_TYPETABLE);
+            return false;
+        }
+
+        QHash<int,int>& localIndexMap = childTypeToLocal[tyIndex];
+        QVector<int>& localToType = childLocalToType[tyIndex];
+        for(int j = 0, numChild = nodeTy.getNumChildNode(); j < numChild; ++j){
+            int childTypeIndex = ty.getNodeTypeIndex(nodeTy.getChildNodeName(j));
+            localIndexMap.insert(childTypeIndex, j);
+            localToType.push_back(childTypeIndex);
+        }
+    }
+    if(Q_UNLIKELY(totalRow != header.numNode)){
+        diagnostic(Diag::Error_Binary_BadData, STR_SECTION_TYPETABLE);
+        return false;
+    }
+
+    // tree structure; the same properties IRRootInstance::checkTreeStructure() ensures, checked in streaming passes:
+    // each child listed under p has nodeParent == p, is of an allowed type, and siblings are ascending.
+    // With numNode-1 edges this makes every non-root node appear exactly once,
+    // and the ancestor stack pass over nodeParent then ensures the nodes are in pre-order
+    {
+        int parent = -1;
+        int parentEnd = 0;
+        int prevChild = -1;
+        const IRPagedInstance* self = this;
+        bool isDataGood = (numNode > 0 && numChildEdge == numNode - 1 && readInt32(nodeParentOffset) == -1)
+                       && scanInt32(childListOffset, numChildEdge, [&parent, &parentEnd, &prevChild, self](int i, qint32 value)->bool{
+                              if(i == parentEnd){
+                                  // advance to the parent owning edge i, skipping leaf nodes
+                                  do{
+                                      parent += 1;
+                                      parentEnd = self->readInt32(self->childStartOffset + static_cast<quint64>(parent + 1) * sizeof(qint32));
+                                  }while(parentEnd == i);
+                                  prevChild = parent;
+                              }
+                              bool isGood = value > prevChild
+                                         && self->readInt32(self->nodeParentOffset + static_cast<quint64>(value) * sizeof(qint32)) == parent
+                                         && self->childTypeToLocal.at(self->getTypeIndex(parent)).contains(self->getTypeIndex(value));
+                              prevChild = value;
+                              return isGood;
+                          });
+        if(isDataGood){
+            std::vector<int> ancestors;
+            isDataGood = scanInt32(nodeParentOffset, numNode, [&ancestors](int i, qint32 value)->bool{
+                if(i > 0){
+                    while(!ancestors.empty() && ancestors.back() != value){
+                        ancestors.pop_back();
+                    }
+                    if(ancestors.empty())
+                        return false;
+                }
+                ancestors.push_back(i);
+                return true;
+            });
+        }
+        if(Q_UNLIKELY(!isDataGood || isReadFailed)){
+            diagnostic(Diag::Error_Binary_BadData, STR_SECTION_STRUCTURE);
+            return false;
+        }
+    }
+    return true;
+}
+
+void IRPagedInstance::readBytes(quint64 offset, void* dest, quint64 bytes) const
+{
+    char* out = static_cast<char*>(dest);
+    if(mappedData){
+        if(Q_LIKELY(offset <= mappedSize && bytes <= mappedSize - offset)){
+            std::memcpy(out, mappedData + offset, bytes);
+        }else{
+            std::memset(out, 0, bytes);
+            isReadFailed = true;
+        }
+        return;
+    }
+    while(bytes > 0){
+        quint64 pageIndex = offset / PAGE_SIZE;
+        quint64 pageOffset = offset % PAGE_SIZE;
+        quint64 chunk = std::min(bytes, static_cast<quint64>(PAGE_SIZE) - pageOffset);
+        const QByteArray* page = pageCache.object(pageIndex);
+        if(!page){
+            // the last page can be shorter; a page that cannot be read is cached empty
+            QByteArray* data = new QByteArray;
+            if(Q_LIKELY(file.seek(static_cast<qint64>(pageIndex * PAGE_SIZE)))){
+                *data = file.read(PAGE_SIZE);
+            }
+            page = data;
+            pageCache.insert(pageIndex, data);
+        }
+        if(Q_LIKELY(pageOffset + chunk <= static_cast<quint64>(page->size()))){
+            std::memcpy(out, page->constData() + pageOffset, chunk);
+        }else{
+            std::memset(out, 0, chunk);
+            isReadFailed = true;
+        }
+        out += chunk;
+        offset += chunk;
+        bytes -= chunk;
+    }
+}
+
+qint32 IRPagedInstance::readInt32(quint64 offset) const
+{
+    qint32 value = 0;
+    readBytes(offset, &value, sizeof(value));
+    return value;
+}
+
+qint64 IRPagedInstance::readInt64(quint64 offset) const
+{
+    qint64 value = 0;
+    readBytes(offset, &value, sizeof(value));
+    return value;
+}
+
+QString IRPagedInstance::readString(int id) const
+{
+    Q_ASSERT(id >= 0 && id < numString);
+    quint64 range[2] = {0, 0};
+    readBytes(stringStartOffset + static_cast<quint64>(id) * sizeof(quint64), range, sizeof(range));
+    if(Q_UNLIKELY(range[1] < range[0]
+                  || range[1] - range[0] > static_cast<quint64>(std::numeric_limits<int>::max())
+                  || range[1] > (stringDataEnd - stringDataOffset) / sizeof(QChar))){
+        isReadFailed = true;
+        return QString();
+    }
+    QString result;
+    result.resize(static_cast<int>(range[1] - range[0]));
+    readBytes(stringDataOffset + range[0] * sizeof(QChar), result.data(), static_cast<quint64>(result.length()) * sizeof(QChar));
+    return result;
+}
+
+int IRPagedInstance::getNodeRow(int nodeIndex, int typeIndex) const
+{
+    // node list of each type is in ascending order (checked on open)
+    const NodeTypeTable& table = typeTables.at(typeIndex);
+    int low = 0;
+    int high = table.numRow;
+    while(low < high){
+        int mid = low + (high - low) / 2;
+        if(readInt32(table.nodeListOffset + static_cast<quint64>(mid) * sizeof(qint32)) < nodeIndex){
+            low = mid + 1;
+        }else{
+            high = mid;
+        }
+    }
+    Q_ASSERT(low < table.numRow);
+    return low;
+}
+
+void IRPagedInstance::getChildRange(int nodeIndex, int& start, int& end) const
+{
+    Q_ASSERT(nodeIndex >= 0 && nodeIndex < numNode);
+    qint32 range[2] = {0, 0};
+    readBytes(childStartOffset + static_cast<quint64>(nodeIndex) * sizeof(qint32), range, sizeof(range));
+    start = range[0];
+    end = range[1];
+}
+
+int IRPagedInstance::getTypeIndex(int nodeIndex) const
+{
+    Q_ASSERT(nodeIndex >= 0 && nodeIndex < numNode);
+    return readInt32(nodeTypeIndexOffset + static_cast<quint64>(nodeIndex) * sizeof(qint32));
+}
+
+int IRPagedInstance::getParentIndex(int nodeIndex) const
+{
+    Q_ASSERT(nodeIndex >= 0 && nodeIndex < numNode);
+    return readInt32(nodeParentOffset + static_cast<quint64>(nodeIndex) * sizeof(qint32));
+}
+
+int IRPagedInstance::getLocalTypeIndex(int nodeIndex, int tyIndex) const
+{
+    return childTypeToLocal.at(getTypeIndex(nodeIndex)).value(tyIndex, -1);
+}
+
+QVariant IRPagedInstance::getParameter(int nodeIndex, int parameterIndex) const
+{
+    int typeIndex = getTypeIndex(nodeIndex);
+    int row = getNodeRow(nodeIndex, typeIndex);
+    quint64 columnOffset = typeTables.at(typeIndex).columnOffset.at(parameterIndex);
+    switch(ty.getNodeType(typeIndex).getParameterType(parameterIndex)){
+    case ValueType::Int64:  return QVariant(readInt64(columnOffset + static_cast<quint64>(row) * sizeof(qint64)));
+    case ValueType::String: return QVariant(readString(readInt32(columnOffset + static_cast<quint64>(row) * sizeof(qint32))));
+    default: Q_UNREACHABLE();
+    }
+    return QVariant();
+}
+
+int IRPagedInstance::getNumChildNode(int nodeIndex) const
+{
+    int start = 0;
+    int end = 0;
+    getChildRange(nodeIndex, start, end);
+    return end - start;
+}
+
+int IRPagedInstance::getChildNodeByOrder(int nodeIndex, int order) const
+{
+    int start = 0;
+    int end = 0;
+    getChildRange(nodeIndex, start, end);
+    Q_ASSERT(order >= 0 && order < end - start);
+    return readInt32(childListOffset + static_cast<quint64>(start + order) * sizeof(qint32));
+}
+
+void IRPagedInstance::loadChildByType(int nodeIndex) const
+{
+    if(cachedChildParent == nodeIndex)
+        return;
+    const QHash<int,int>& localTypeMap = childTypeToLocal.at(getTypeIndex(nodeIndex));
+    int numLocalType = childLocalToType.at(getTypeIndex(nodeIndex)).size();
+    int start = 0;
+    int end = 0;
+    getChildRange(nodeIndex, start, end);
+    QVector<int> children(end - start);
+    QVector<int> localTypes(end - start);
+    // counting sort by local type; children keep document order within each type
+    cachedChildTypeStart.fill(0, numLocalType + 1);
+    for(int i = start; i < end; ++i){
+        int child = readInt32(childListOffset + static_cast<quint64>(i) * sizeof(qint32));
+        // child types are checked on open
+        int localType = localTypeMap.value(getTypeIndex(child), 0);
+        children[i - start] = child;
+        localTypes[i - start] = localType;
+        cachedChildTypeStart[localType + 1] += 1;
+    }
+    for(int i = 0; i < numLocalType; ++i){
+        cachedChildTypeStart[i + 1] += cachedChildTypeStart.at(i);
+    }
+    cachedChildByType.resize(end - start);
+    QVector<int> cursor = cachedChildTypeStart;
+    for(int i = 0, n = children.size(); i < n; ++i){
+        cachedChildByType[cursor[localTypes.at(i)]++] = children.at(i);
+    }
+    cachedChildParent = nodeIndex;
+}
+
+int IRPagedInstance::getNumChildNodeUnderType(int nodeIndex, int nodeLocalTypeIndex) const
+{
+    loadChildByType(nodeIndex);
+    return cachedChildTypeStart.at(nodeLocalTypeIndex + 1) - cachedChildTypeStart.at(nodeLocalTypeIndex);
+}
+
+int IRPagedInstance::getChildNodeIndex(int nodeIndex, int nodeLocalTypeIndex, int nodeIndexUnderType) const
+{
+    loadChildByType(nodeIndex);
+    int start = cachedChildTypeStart.at(nodeLocalTypeIndex);
+    if(Q_UNLIKELY(nodeIndexUnderType < 0 || nodeIndexUnderType >= cachedChildTypeStart.at(nodeLocalTypeIndex + 1) - start))
+        return -1;
+    return cachedChildByType.at(start + nodeIndexUnderType);
+}
+
+int IRPagedInstance::getChildNodeIndex(int nodeIndex, int nodeLocalTypeIndex, int nodeParamIndex, const QVariant& key) const
+{
+    // same as IRRootInstance: only unique parameters can be used here
+    int childTypeIndex = childLocalToType.at(getTypeIndex(nodeIndex)).at(nodeLocalTypeIndex);
+    const IRNodeType& childTy = ty.getNodeType(childTypeIndex);
+    if(nodeParamIndex < 0 || nodeParamIndex >= childTy.getNumParameter() || !childTy.getParameterIsUnique(nodeParamIndex))
+        return -1;
+    return findChildNodeWithKey(nodeIndex, nodeLocalTypeIndex, nodeParamIndex, key, 0);
+}
+
+int IRPagedInstance::getNumChildNodeWithKey(int nodeIndex, int nodeLocalTypeIndex, int nodeParamIndex, const QVariant& key) const
+{
+    return findChildNodeWithKey(nodeIndex, nodeLocalTypeIndex, nodeParamIndex, key, -1);
+}
+
+int IRPagedInstance::getChildNodeIndexWithKey(int nodeIndex, int nodeLocalTypeIndex, int nodeParamIndex, const QVariant& key, int ordinal) const
+{
+    Q_ASSERT(ordinal >= 0);
+    int result = findChildNodeWithKey(nodeIndex, nodeLocalTypeIndex, nodeParamIndex, key, ordinal);
+    Q_ASSERT(result >= 0);
+    return result;
+}
+
+int IRPagedInstance::findChildNodeWithKey(int nodeIndex, int nodeLocalTypeIndex, int nodeParamIndex, const QVariant& key, int ordinal) const
+{
+    int notFound = (ordinal < 0)? 0 : -1;
+    int childTypeIndex = childLocalToType.at(getTypeIndex(nodeIndex)).at(nodeLocalTypeIndex);
+    const IRNodeType& childTy = ty.getNodeType(childTypeIndex);
+    if(nodeParamIndex < 0 || nodeParamIndex >= childTy.getNumParameter()
+            || !(childTy.getParameterIsUnique(nodeParamIndex) || childTy.getParameterIsIndexed(nodeParamIndex)))
+        return notFound;
+
+    ValueType paramTy = childTy.getParameterType(nodeParamIndex);
+    switch(static_cast<QMetaType::Type>(key.userType())){
+    case QMetaType::LongLong:
+        if(paramTy != ValueType::Int64)
+            return notFound;
+        break;
+    case QMetaType::QString:
+        if(paramTy != ValueType::String)
+            return notFound;
+        break;
+    default: return notFound;
+    }
+    qint64 intKey = (paramTy == ValueType::Int64)? key.toLongLong() : 0;
+    QString stringKey = (paramTy == ValueType::String)? key.toString() : QString();
+
+    const NodeTypeTable& childTable = typeTables.at(childTypeIndex);
+    quint64 columnOffset = childTable.columnOffset.at(nodeParamIndex);
+    loadChildByType(nodeIndex);
+    int count = 0;
+    for(int i = cachedChildTypeStart.at(nodeLocalTypeIndex), end = cachedChildTypeStart.at(nodeLocalTypeIndex + 1); i < end; ++i){
+        int child = cachedChildByType.at(i);
+        int row = getNodeRow(child, childTypeIndex);
+        bool isMatch = (paramTy == ValueType::Int64)?
+                    (readInt64(columnOffset + static_cast<quint64>(row) * sizeof(qint64)) == intKey)
+                  : (readString(readInt32(columnOffset + static_cast<quint64>(row) * sizeof(qint32))) == stringKey);
+        if(isMatch){
+            if(count == ordinal)
+                return child;
+            count += 1;
+        }
+    }
+    return (ordinal < 0)? count : -1;
+}
+
+int IRPagedInstance::getNodeOfType(int typeIndex, int ordinal) const
+{
+    const NodeTypeTable& table = typeTables.at(typeIndex);
+    Q_ASSERT(ordinal >= 0 && ordinal < table.numRow);
+    return readInt32(table.nodeListOffset + static_cast<quint64>(ordinal) * sizeof(qint32));
+}
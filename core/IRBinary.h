@@ -0,0 +1,146 @@
+#ifndef IRBINARY_H
+#define IRBINARY_H
+
+#include "core/IR.h"
+
+#include <QIODevice>
+#include <QFile>
+#include <QCache>
+#include <QHash>
+#include <QVector>
+
+class DiagnosticEmitterBase;
+
+/**
+ * Binary IR instance format
+ *
+ * The file is a fixed-size header followed by sections; all sections are 8-byte aligned and in host byte order.
+ *   - string table: (numString+1) quint64 start offsets (in UTF-16 code units) followed by UTF-16 string data
+ *   - structure:    pre-order node array (qint32 type index, qint32 parent), CSR child list (qint32 start[numNode+1], qint32 child[])
+ *   - type tables:  for each node type: quint64 row count, qint32 node index per row, then one column per parameter
+ *                   (qint64 per row for Int64, qint32 string id per row for String)
+ * The header carries a fingerprint of the IRRootType and a flag recording whether the instance was validated when written.
+ * Sections are copied out of the (memory mapped, if possible) file in bulk without any parsing;
+ * if the validated flag is set, the parameter and uniqueness checks of validation are skipped on load,
+ * but the tree structure (reachability, parent consistency, pre-order) is still checked.
+ */
+namespace IRBinary{
+bool writeIRInstance(const IRRootInstance& ir, QIODevice* dest);
+
+// if src is a file, it is memory mapped instead of read
+// the result owns a copy of everything (strings are interned again), which is only needed to edit the IR;
+// for read-only access (e.g. ExecutionContext), IRPagedInstance reads the file in place instead
+IRRootInstance* readIRInstance(const IRRootType& ty, DiagnosticEmitterBase& diagnostic, QIODevice* src);
+}
+
+/**
+ * @brief The IRPagedInstance class reads an IR instance in binary format in place, without loading it into memory
+ *
+ * Only the header and per-type table offsets are kept in memory. The file is memory mapped if possible, and all
+ * reads go directly to the mapping (the OS pages the file in and out); only strings are copied, into the returned
+ * QVariant. If the file cannot be mapped, reads go through an LRU cache of fixed-size file pages instead,
+ * so memory use is bounded by the cache size regardless of the size of the IR.
+ * Row of a node in its type table is found by binary search on the table's node list. The file has no
+ * child-by-type index; instead, the children of the most recently accessed parent are grouped by type
+ * on first access (O(children) time and memory). Walking all children of one parent is then linear,
+ * but alternating between parents regroups each time. Key lookups scan the children of the requested type.
+ *
+ * Only files written from a validated instance are accepted. Indices and the tree structure in the file are checked
+ * once on open (in streaming passes) so that a corrupted file cannot make the reader go out of bounds or loop;
+ * the file must not be modified while it is open. If a read fails afterwards, zeros are read and hasReadError() is set.
+ *
+ * Not thread-safe: even const accessors update the page cache and the per-parent child grouping.
+ */
+class IRPagedInstance : public IRInstanceReaderBase
+{
+public:
+    static const int PAGE_SIZE = 64 * 1024;
+
+    /**
+     * @brief open open a binary IR file for paged access
+     * @param ty the IR type; must be validated and outlive the instance
+     * @param diagnostic where errors are reported
+     * @param fileName path of the file written by IRBinary::writeIRInstance()
+     * @param maxCachedPages maximum number of pages (of PAGE_SIZE bytes) kept in memory
+     * @return the instance, or nullptr if the file cannot be used; caller takes ownership
+     */
+    static IRPagedInstance* open(const IRRootType& ty, DiagnosticEmitterBase& diagnostic, const QString& fileName, int maxCachedPages = 256);
+    virtual ~IRPagedInstance() override;
+
+    IRPagedInstance(const IRPagedInstance&) = delete;
+
+    bool hasReadError() const {return isReadFailed;}
+    bool isMemoryMapped() const {return mappedData != nullptr;}
+    // only used if the file is not memory mapped
+    void setMaxCachedPages(int maxCachedPages) {pageCache.setMaxCost(maxCachedPages);}
+
+    virtual const IRRootType& getType() const override {return ty;}
+    virtual int getNumNode() const override {return numNode;}
+
+    virtual int getTypeIndex(int nodeIndex) const override;
+    virtual int getParentIndex(int nodeIndex) const override;
+    virtual int getLocalTypeIndex(int nodeIndex, int tyIndex) const override;
+    virtual QVariant getParameter(int nodeIndex, int parameterIndex) const override;
+
+    virtual int getNumChildNode(int nodeIndex) const override;
+    virtual int getChildNodeByOrder(int nodeIndex, int order) const override;
+    virtual int getNumChildNodeUnderType(int nodeIndex, int nodeLocalTypeIndex) const override;
+    virtual int getChildNodeIndex(int nodeIndex, int nodeLocalTypeIndex, int nodeIndexUnderType) const override;
+    virtual int getChildNodeIndex(int nodeIndex, int nodeLocalTypeIndex, int nodeParamIndex, const QVariant& key) const override;
+    virtual int getNumChildNodeWithKey(int nodeIndex, int nodeLocalTypeIndex, int nodeParamIndex, const QVariant& key) const override;
+    virtual int getChildNodeIndexWithKey(int nodeIndex, int nodeLocalTypeIndex, int nodeParamIndex, const QVariant& key, int ordinal) const override;
+
+    virtual int getNumNodeOfType(int typeIndex) const override {return typeTables.at(typeIndex).numRow;}
+    virtual int getNodeOfType(int typeIndex, int ordinal) const override;
+
+private:
+    struct NodeTypeTable{
+        int numRow = 0;
+        quint64 nodeListOffset = 0;         //!< qint32 node index per row
+        QVector<quint64> columnOffset;      //!< [parameter] -> start of column (qint64 or qint32 string id per row)
+    };
+
+    IRPagedInstance(const IRRootType& ty, const QString& fileName, int maxCachedPages);
+    bool initialize(DiagnosticEmitterBase& diagnostic);
+
+    // copy bytes [offset, offset+bytes) of the file to dest, from the mapping or through the page cache
+    void readBytes(quint64 offset, void* dest, quint64 bytes) const;
+    qint32 readInt32(quint64 offset) const;
+    qint64 readInt64(quint64 offset) const;
+    QString readString(int id) const;
+    // call visitor(index, value) for each of count qint32 starting at offset, in blocks; stop and return false when visitor does
+    template<typename Visitor>
+    bool scanInt32(quint64 offset, int count, Visitor visitor) const;
+
+    int getNodeRow(int nodeIndex, int typeIndex) const;
+    void getChildRange(int nodeIndex, int& start, int& end) const;
+    // group children of nodeIndex by local type into cachedChildByType, unless already done for it
+    void loadChildByType(int nodeIndex) const;
+    // child of given local type with matching unique or indexed parameter; ordinal -1 to count matches instead
+    int findChildNodeWithKey(int nodeIndex, int nodeLocalTypeIndex, int nodeParamIndex, const QVariant& key, int ordinal) const;
+
+    const IRRootType& ty;
+    mutable QFile file;
+    uchar* mappedData = nullptr;                    //!< whole file, if memory mapped
+    quint64 mappedSize = 0;
+    mutable QCache<quint64, QByteArray> pageCache;  //!< page index -> page content; unused if memory mapped
+    mutable bool isReadFailed = false;
+    mutable int cachedChildParent = -1;         //!< node whose children are in cachedChildByType
+    mutable QVector<int> cachedChildByType;     //!< children of cachedChildParent, grouped by local type in document order
+    mutable QVector<int> cachedChildTypeStart;  //!< [local type index] -> start in cachedChildByType; one extra entry at the end
+
+    int numNode = 0;
+    int numString = 0;
+    quint64 nodeTypeIndexOffset = 0;
+    quint64 nodeParentOffset = 0;
+    quint64 childStartOffset = 0;
+    quint64 childListOffset = 0;
+    quint64 stringStartOffset = 0;
+    quint64 stringDataOffset = 0;
+    quint64 stringDataEnd = 0;
+    QVector<NodeTypeTable> typeTables;
+    QVector<QHash<int,int>> childTypeToLocal;   //!< [node type] -> (child type index -> local type index)
+    QVector<QVector<int>> childLocalToType;     //!< [node type] -> [local type index] -> child type index
+};
+
+#endif // IRBINARY_H
@@ -0,0 +1,76 @@
+#include "core/IRBuilder.h"
+
+IRBuilder::IRBuilder(const IRRootType& ty, int numNodeHint)
+    : inst(new IRRootInstance(ty))
+{
+    Q_ASSERT(ty.validated());
+    if(numNodeHint > 0){
+        inst->nodeTypeIndex.reserve(numNodeHint);
+        inst->nodeParent.reserve(numNodeHint);
+        inst->nodeRow.reserve(numNodeHint);
+    }
+}
+
+IRBuilder::~IRBuilder()
+{
+}
+
+int IRBuilder::addNode(int typeIndex, int parentIndex)
+{
+    if(Q_UNLIKELY(parentIndex < -1 || parentIndex >= inst->nodeTypeIndex.size()))
+        return -1;
+    int nodeIndex = inst->appendNode(typeIndex);
+    inst->nodeParent[nodeIndex] = parentIndex;
+    return nodeIndex;
+}
+
+void IRBuilder::setParameters(int nodeIndex, const QList<IRParameterValue>& parameters)
+{
+    inst->storeParameters(nodeIndex, parameters);
+}
+
+void IRBuilder::setParameter(int nodeIndex, int parameterIndex, qint64 value)
+{
+    if(Q_UNLIKELY(!inst->recordParameterType(nodeIndex, parameterIndex, ValueType::Int64)))
+        return;
+    IRRootInstance::ParameterColumn& column = inst->typeTables[inst->nodeTypeIndex.at(nodeIndex)].columns[parameterIndex];
+    column.intData[inst->nodeRow.at(nodeIndex)] = value;
+}
+
+void IRBuilder::setParameter(int nodeIndex, int parameterIndex, const QString& value)
+{
+    if(Q_UNLIKELY(!inst->recordParameterType(nodeIndex, parameterIndex, ValueType::String)))
+        return;
+    IRRootInstance::ParameterColumn& column = inst->typeTables[inst->nodeTypeIndex.at(nodeIndex)].columns[parameterIndex];
+    column.stringData[inst->nodeRow.at(nodeIndex)] = inst->stringPool.intern(value);
+}
+
+IRRootInstance* IRBuilder::finish()
+{
+    // counting sort on parent index; since nodes are in pre-order,
+    // visiting them in index order puts the children of each node in document order
+    const ChunkedVector<int>& nodeParent = inst->nodeParent;
+    int numNode = nodeParent.size();
+    QVector<int> childStart(numNode+1, 0);
+    for(int i = 0; i < numNode; ++i){
+        int parent = nodeParent.at(i);
+        if(parent >= 0){
+            childStart[parent+1] += 1;
+        }
+    }
+    for(int i = 0; i < numNode; ++i){
+        childStart[i+1] += childStart.at(i);
+    }
+    QVector<int> childList(childStart.back());
+    QVector<int> cursor(childStart);
+    for(int i = 0; i < numNode; ++i){
+        int parent = nodeParent.at(i);
+        if(parent >= 0){
+            childList[cursor[parent]++] = i;
+        }
+    }
+    inst->childStart.swap(childStart);
+    inst->childList.swap(childList);
+    inst->pendingChildEdges.clear();
+    return inst.release();
+}
@@ -0,0 +1,58 @@
+#ifndef IRBUILDER_H
+#define IRBUILDER_H
+
+#include "core/IR.h"
+
+#include <memory>
+
+/**
+ * @brief The IRBuilder class builds a new IRRootInstance in bulk
+ *
+ * Nodes must be added in pre-order (the root first, every node after its parent and its preceding siblings);
+ * children of each node are then derived from the parent indices in one pass on finish(),
+ * so there is no addChildNode() / setParent() per node and no validation state to reset.
+ * Errors (bad parent index, parameter type mismatch) are not reported here; they are left to IRRootInstance::validate(),
+ * except that addNode() refuses a parent index that does not refer to an existing node.
+ */
+class IRBuilder
+{
+public:
+    /**
+     * @brief IRBuilder start building an instance
+     * @param ty the IR type; must be validated
+     * @param numNodeHint expected number of nodes, used to pre-size storage; 0 if unknown
+     */
+    explicit IRBuilder(const IRRootType& ty, int numNodeHint = 0);
+    ~IRBuilder();
+
+    IRBuilder(const IRBuilder&) = delete;
+
+    /**
+     * @brief addNode append a node in pre-order
+     * @param typeIndex node type index; an invalid one is kept and rejected by validate()
+     * @param parentIndex index of an existing node, or -1 for root
+     * @return index of the new node, or -1 if parentIndex is invalid
+     */
+    int addNode(int typeIndex, int parentIndex);
+
+    int getNumNode() const {return inst->nodeTypeIndex.size();}
+
+    // parameters of a new node are default initialized (0 or empty string)
+    void setParameters(int nodeIndex, const QList<IRParameterValue>& parameters);
+    // typed setters; the type must match IRNodeType::getParameterType()
+    void setParameter(int nodeIndex, int parameterIndex, qint64 value);
+    void setParameter(int nodeIndex, int parameterIndex, const QString& value);
+
+    /**
+     * @brief finish build child lists and hand over the instance
+     *
+     * The builder must not be used afterwards.
+     * @return the instance, ready for IRRootInstance::validate(); caller takes ownership
+     */
+    IRRootInstance* finish();
+
+private:
+    std::unique_ptr<IRRootInstance> inst;
+};
+
+#endif // IRBUILDER_H
@@ -0,0 +1,359 @@
+#include "core/IRCodegen.h"
+
+#include "core/Bundle.h"
+#include "core/CLIDriver.h"
+#include "core/DiagnosticEmitter.h"
+#include "core/IR.h"
+
+#include <QDir>
+#include <QFile>
+#include <QHash>
+#include <QSet>
+#include <QStringList>
+
+#include <memory>
+
+namespace{
+// names used by the generated code, in the IR namespace or in accessor classes
+const char* const RESERVED_NAMES[] = {
+    "ChildRange", "NumNodeType", "matchesSchema", "RootNode", "getRootNode",
+    "TypeIndex", "NumParameter", "NumChildType", "isInstance", "getNodeIndex", "getNode", "m_root", "m_node",
+    "QString", "qint64", "IRRootInstance", "IRConstNodeInstance", "IRNodeInstance", "IRRootType", "IRNodeType", "ValueType"
+};
+// prefixes of members generated per parameter / child
+const char* const RESERVED_PREFIXES[] = {
+    "get_", "ParamIndex_", "ChildLocalIndex_", "getChildren_"
+};
+const char* const CPP_KEYWORDS[] = {
+    "alignas", "alignof", "and", "and_eq", "asm", "auto", "bitand", "bitor", "bool", "break", "case", "catch",
+    "char", "char16_t", "char32_t", "class", "compl", "const", "constexpr", "const_cast", "continue", "decltype",
+    "default", "delete", "do", "double", "dynamic_cast", "else", "enum", "explicit", "export", "extern", "false",
+    "float", "for", "friend", "goto", "if", "inline", "int", "long", "mutable", "namespace", "new", "noexcept",
+    "not", "not_eq", "nullptr", "operator", "or", "or_eq", "private", "protected", "public", "register",
+    "reinterpret_cast", "return", "short", "signed", "sizeof", "static", "static_assert", "static_cast", "struct",
+    "switch", "template", "this", "thread_local", "throw", "true", "try", "typedef", "typeid", "typename", "union",
+    "unsigned", "using", "virtual", "void", "volatile", "wchar_t", "while", "xor", "xor_eq"
+};
+
+// a C++ string literal with the UTF-8 encoding of str; anything other than printable ASCII is escaped in octal
+QString getStringLiteral(const QString& str)
+{
+    QString result(QStringLiteral("QString::fromUtf8(\""));
+    QByteArray data = str.toUtf8();
+    for(char c : data){
+        uchar byte = static_cast<uchar>(c);
+        if(byte >= 0x20 && byte < 0x7f && c != '"' && c != '\\' && c != '?'){
+            result.append(QChar(c));
+        }else{
+            result.append(QStringLiteral("\\%1").arg(static_cast<int>(byte), 3, 8, QChar('0')));
+        }
+    }
+    result.append(QStringLiteral("\")"));
+    return result;
+}
+
+QString getParameterCppType(ValueType ty)
+{
+    switch(ty){
+    case ValueType::Int64:  return QStringLiteral("qint64");
+    case ValueType::String: return QStringLiteral("QString");
+    default: Q_UNREACHABLE();
+    }
+    return QString();
+}
+
+/**
+ * @brief The IdentifierTable class maps names in one scope to distinct identifiers
+ */
+class IdentifierTable
+{
+public:
+    explicit IdentifierTable(DiagnosticEmitterBase& diagnostic): diagnostic(diagnostic){}
+
+    // return false if name maps to the same identifier as a previous (different) name
+    bool add(const QString& name, QString& identifier){
+        identifier = IRCodegen::getIdentifier(name);
+        auto iter = identifierToName.constFind(identifier);
+        if(Q_UNLIKELY(iter != identifierToName.constEnd() && iter.value() != name)){
+            diagnostic(Diag::Error_Codegen_IdentifierCollision, identifier, iter.value(), name);
+            return false;
+        }
+        identifierToName.insert(identifier, name);
+        return true;
+    }
+
+private:
+    DiagnosticEmitterBase& diagnostic;
+    QHash<QString, QString> identifierToName;
+};
+
+const char CHILD_RANGE_DEFINITION[] =
+        "/**\n"
+        " * @brief The ChildRange class is a range of accessors of children of one node under one child type\n"
+        " */\n"
+        "template<typename T>\n"
+        "class ChildRange\n"
+        "{\n"
+        "public:\n"
+        "    class const_iterator\n"
+        "    {\n"
+        "    public:\n"
+        "        const_iterator(const ChildRange& range, int index): range(&range), index(index){}\n"
+        "        T operator*() const {return range->at(index);}\n"
+        "        const_iterator& operator++(){++index; return *this;}\n"
+        "        bool operator==(const const_iterator& rhs) const {return index == rhs.index;}\n"
+        "        bool operator!=(const const_iterator& rhs) const {return index != rhs.index;}\n"
+        "    private:\n"
+        "        const ChildRange* range;\n"
+        "        int index;\n"
+        "    };\n"
+        "\n"
+        "    ChildRange(const IRRootInstance& root, const IRConstNodeInstance& parent, int localTypeIndex)\n"
+        "        : m_root(&root), m_parent(parent), m_localTypeIndex(localTypeIndex), m_count(parent.getNumChildNodeUnderType(localTypeIndex))\n"
+        "    {}\n"
+        "\n"
+        "    int size() const {return m_count;}\n"
+        "    T at(int index) const {return T(*m_root, m_parent.getChildNodeIndex(m_localTypeIndex, index));}\n"
+        "    const_iterator begin() const {return const_iterator(*this, 0);}\n"
+        "    const_iterator end() const {return const_iterator(*this, m_count);}\n"
+        "\n"
+        "private:\n"
+        "    const IRRootInstance* m_root;\n"
+        "    IRConstNodeInstance m_parent;\n"
+        "    int m_localTypeIndex;\n"
+        "    int m_count;\n"
+        "};\n";
+}
+
+QString IRCodegen::getIdentifier(const QString& name)
+{
+    QString result;
+    result.reserve(name.length() + 1);
+    for(const QChar& c : name){
+        ushort u = c.unicode();
+        bool isIdentifierChar = (u < 0x80) && ((u >= 'a' && u <= 'z') || (u >= 'A' && u <= 'Z') || (u >= '0' && u <= '9') || u == '_');
+        QChar out = isIdentifierChar? c : QChar('_');
+        // merge runs of underscores; identifiers with double underscores are reserved
+        if(out == QChar('_') && result.endsWith(QChar('_')))
+            continue;
+        result.append(out);
+    }
+    // only ASCII characters are left, so isLetter() is [a-zA-Z]
+    bool isNeedPrefix = result.isEmpty() || !result.at(0).isLetter();
+    for(const char* prefix : RESERVED_PREFIXES){
+        isNeedPrefix = isNeedPrefix || result.startsWith(QLatin1String(prefix));
+    }
+    if(isNeedPrefix){
+        result.prepend(QChar('N'));
+    }
+    for(const char* keyword : CPP_KEYWORDS){
+        if(result == QLatin1String(keyword)){
+            result.append(QChar('_'));
+            return result;
+        }
+    }
+    for(const char* reserved : RESERVED_NAMES){
+        if(result == QLatin1String(reserved)){
+            result.append(QChar('_'));
+            return result;
+        }
+    }
+    return result;
+}
+
+bool IRCodegen::generateHeader(const IRRootType& ty, DiagnosticEmitterBase& diagnostic, QString& result)
+{
+    Q_ASSERT(ty.validated());
+    DiagnosticPathNode pathNode(diagnostic, ty.getName());
+
+    // resolve all identifiers first
+    int numNodeType = ty.getNumNodeType();
+    QStringList classNames;
+    QVector<QStringList> paramNames(numNodeType);
+    {
+        IdentifierTable nodeTable(diagnostic);
+        for(int i = 0; i < numNodeType; ++i){
+            const IRNodeType& nodeTy = ty.getNodeType(i);
+            QString identifier;
+            if(Q_UNLIKELY(!nodeTable.add(nodeTy.getName(), identifier)))
+                return false;
+            classNames.push_back(identifier);
+            IdentifierTable paramTable(diagnostic);
+            for(int j = 0, numParam = nodeTy.getNumParameter(); j < numParam; ++j){
+                if(Q_UNLIKELY(!paramTable.add(nodeTy.getParameterName(j), identifier)))
+                    return false;
+                paramNames[i].push_back(identifier);
+            }
+        }
+    }
+    QString namespaceName = getIdentifier(ty.getName());
+    QString guardName = QStringLiteral("SUPP_IR_") + namespaceName.toUpper() + QStringLiteral("_H");
+
+    QString out;
+    auto helper_line = [&out](const QString& line)->void{
+        out.append(line);
+        out.append(QChar('\n'));
+    };
+
+    helper_line(QStringLiteral("// Generated by supp from IR type %1; do not edit.").arg(getStringLiteral(ty.getName())));
+    helper_line(QStringLiteral("#ifndef ") + guardName);
+    helper_line(QStringLiteral("#define ") + guardName);
+    helper_line(QString());
+    helper_line(QStringLiteral("#include \"core/IR.h\""));
+    helper_line(QString());
+    helper_line(QStringLiteral("namespace ") + namespaceName + QStringLiteral("{"));
+    helper_line(QString());
+    out.append(QLatin1String(CHILD_RANGE_DEFINITION));
+    helper_line(QString());
+    helper_line(QStringLiteral("constexpr int NumNodeType = %1;").arg(numNodeType));
+    helper_line(QString());
+    for(const QString& className : classNames){
+        helper_line(QStringLiteral("class ") + className + QStringLiteral(";"));
+    }
+
+    // accessor classes; child range getters are defined after all classes
+    for(int i = 0; i < numNodeType; ++i){
+        const IRNodeType& nodeTy = ty.getNodeType(i);
+        const QString& className = classNames.at(i);
+        helper_line(QString());
+        helper_line(QStringLiteral("//-----------------------------------------------------------------------------"));
+        helper_line(QString());
+        helper_line(QStringLiteral("/**"));
+        helper_line(QStringLiteral(" * @brief accessor of node type %1").arg(getStringLiteral(nodeTy.getName())));
+        helper_line(QStringLiteral(" */"));
+        helper_line(QStringLiteral("class ") + className);
+        helper_line(QStringLiteral("{"));
+        helper_line(QStringLiteral("public:"));
+        helper_line(QStringLiteral("    static constexpr int TypeIndex = %1;").arg(i));
+        helper_line(QStringLiteral("    static constexpr int NumParameter = %1;").arg(nodeTy.getNumParameter()));
+        for(int j = 0, numParam = nodeTy.getNumParameter(); j < numParam; ++j){
+            helper_line(QStringLiteral("    static constexpr int ParamIndex_%1 = %2;").arg(paramNames.at(i).at(j)).arg(j));
+        }
+        helper_line(QStringLiteral("    static constexpr int NumChildType = %1;").arg(nodeTy.getNumChildNode()));
+        for(int j = 0, numChild = nodeTy.getNumChildNode(); j < numChild; ++j){
+            const QString& childClassName = classNames.at(ty.getNodeTypeIndex(nodeTy.getChildNodeName(j)));
+            helper_line(QStringLiteral("    static constexpr int ChildLocalIndex_%1 = %2;").arg(childClassName).arg(j));
+        }
+        helper_line(QString());
+        helper_line(QStringLiteral("    // the node must be of this type; root must be validated before children are accessed"));
+        helper_line(QStringLiteral("    %1(const IRRootInstance& root, int nodeIndex)").arg(className));
+        helper_line(QStringLiteral("        : m_root(&root), m_node(root.getNode(nodeIndex))"));
+        helper_line(QStringLiteral("    {"));
+        helper_line(QStringLiteral("        Q_ASSERT(m_node.getTypeIndex() == TypeIndex);"));
+        helper_line(QStringLiteral("    }"));
+        helper_line(QStringLiteral("    static bool isInstance(const IRRootInstance& root, int nodeIndex) {return root.getNode(nodeIndex).getTypeIndex() == TypeIndex;}"));
+        helper_line(QString());
+        helper_line(QStringLiteral("    int getNodeIndex() const {return m_node.getNodeIndex();}"));
+        helper_line(QStringLiteral("    const IRConstNodeInstance& getNode() const {return m_node;}"));
+        if(nodeTy.getNumParameter() > 0){
+            helper_line(QString());
+        }
+        for(int j = 0, numParam = nodeTy.getNumParameter(); j < numParam; ++j){
+            const QString& paramName = paramNames.at(i).at(j);
+            QString cppType = getParameterCppType(nodeTy.getParameterType(j));
+            helper_line(QStringLiteral("    %1 get_%2() const {return m_node.getParameterAs<%1>(ParamIndex_%2);}").arg(cppType, paramName));
+        }
+        if(nodeTy.getNumChildNode() > 0){
+            helper_line(QString());
+        }
+        for(int j = 0, numChild = nodeTy.getNumChildNode(); j < numChild; ++j){
+            const QString& childClassName = classNames.at(ty.getNodeTypeIndex(nodeTy.getChildNodeName(j)));
+            helper_line(QStringLiteral("    ChildRange<%1> getChildren_%1() const;").arg(childClassName));
+        }
+        helper_line(QString());
+        helper_line(QStringLiteral("private:"));
+        helper_line(QStringLiteral("    const IRRootInstance* m_root;"));
+        helper_line(QStringLiteral("    IRConstNodeInstance m_node;"));
+        helper_line(QStringLiteral("};"));
+    }
+
+    helper_line(QString());
+    helper_line(QStringLiteral("//-----------------------------------------------------------------------------"));
+    for(int i = 0; i < numNodeType; ++i){
+        const IRNodeType& nodeTy = ty.getNodeType(i);
+        for(int j = 0, numChild = nodeTy.getNumChildNode(); j < numChild; ++j){
+            const QString& childClassName = classNames.at(ty.getNodeTypeIndex(nodeTy.getChildNodeName(j)));
+            helper_line(QString());
+            helper_line(QStringLiteral("inline ChildRange<%1> %2::getChildren_%1() const").arg(childClassName, classNames.at(i)));
+            helper_line(QStringLiteral("{"));
+            helper_line(QStringLiteral("    return ChildRange<%1>(*m_root, m_node, ChildLocalIndex_%1);").arg(childClassName));
+            helper_line(QStringLiteral("}"));
+        }
+    }
+
+    int rootTypeIndex = ty.getRootNodeTypeIndex();
+    if(rootTypeIndex >= 0){
+        helper_line(QString());
+        helper_line(QStringLiteral("typedef %1 RootNode;").arg(classNames.at(rootTypeIndex)));
+        helper_line(QStringLiteral("inline RootNode getRootNode(const IRRootInstance& root) {return RootNode(root, 0);}"));
+    }
+
+    // runtime check of the schema in use
+    helper_line(QString());
+    helper_line(QStringLiteral("/**"));
+    helper_line(QStringLiteral(" * @brief matchesSchema check that ty has the node types, parameters and children this header is generated from"));
+    helper_line(QStringLiteral(" */"));
+    helper_line(QStringLiteral("inline bool matchesSchema(const IRRootType& ty)"));
+    helper_line(QStringLiteral("{"));
+    helper_line(QStringLiteral("    if(ty.getNumNodeType() != NumNodeType || ty.getRootNodeTypeIndex() != %1)").arg(rootTypeIndex));
+    helper_line(QStringLiteral("        return false;"));
+    for(int i = 0; i < numNodeType; ++i){
+        const IRNodeType& nodeTy = ty.getNodeType(i);
+        helper_line(QStringLiteral("    {"));
+        helper_line(QStringLiteral("        const IRNodeType& nodeTy = ty.getNodeType(%1);").arg(i));
+        helper_line(QStringLiteral("        if(nodeTy.getName() != %1 || nodeTy.getNumParameter() != %2 || nodeTy.getNumChildNode() != %3)")
+                    .arg(getStringLiteral(nodeTy.getName())).arg(nodeTy.getNumParameter()).arg(nodeTy.getNumChildNode()));
+        helper_line(QStringLiteral("            return false;"));
+        for(int j = 0, numParam = nodeTy.getNumParameter(); j < numParam; ++j){
+            QString valueTyName = (nodeTy.getParameterType(j) == ValueType::Int64)? QStringLiteral("Int64") : QStringLiteral("String");
+            helper_line(QStringLiteral("        if(nodeTy.getParameterName(%1) != %2 || nodeTy.getParameterType(%1) != ValueType::%3)")
+                        .arg(j).arg(getStringLiteral(nodeTy.getParameterName(j)), valueTyName));
+            helper_line(QStringLiteral("            return false;"));
+        }
+        for(int j = 0, numChild = nodeTy.getNumChildNode(); j < numChild; ++j){
+            helper_line(QStringLiteral("        if(nodeTy.getChildNodeName(%1) != %2)").arg(j).arg(getStringLiteral(nodeTy.getChildNodeName(j))));
+            helper_line(QStringLiteral("            return false;"));
+        }
+        helper_line(QStringLiteral("    }"));
+    }
+    helper_line(QStringLiteral("    return true;"));
+    helper_line(QStringLiteral("}"));
+    helper_line(QString());
+    helper_line(QStringLiteral("} // namespace ") + namespaceName);
+    helper_line(QString());
+    helper_line(QStringLiteral("#endif // ") + guardName);
+
+    result = out;
+    return true;
+}
+
+int generateIRHeaderEntry(const QString& bundlePath, const QString& outputDir)
+{
+    ConsoleDiagnosticEmitter diagnostic;
+    QFile bundleFile(bundlePath);
+    if(Q_UNLIKELY(!bundleFile.open(QIODevice::ReadOnly))){
+        diagnostic(Diag::Error_Codegen_CannotOpenFile, bundlePath, bundleFile.errorString());
+        return -1;
+    }
+    std::unique_ptr<Bundle> bundle(Bundle::fromJson(bundleFile.readAll(), diagnostic));
+    bundleFile.close();
+    if(Q_UNLIKELY(!bundle))
+        return -1;
+
+    QDir dir(outputDir);
+    for(int i = 0, n = bundle->getNumIR(); i < n; ++i){
+        const IRRootType& ty = bundle->getIR(i);
+        QString content;
+        if(Q_UNLIKELY(!IRCodegen::generateHeader(ty, diagnostic, content)))
+            return -1;
+        QString fileName = dir.filePath(IRCodegen::getIdentifier(ty.getName()) + QStringLiteral(".h"));
+        QFile f(fileName);
+        if(Q_UNLIKELY(!f.open(QIODevice::WriteOnly | QIODevice::Truncate))){
+            diagnostic(Diag::Error_Codegen_CannotOpenFile, fileName, f.errorString());
+            return -1;
+        }
+        f.write(content.toUtf8());
+        f.close();
+    }
+    return 0;
+}
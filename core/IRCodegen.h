@@ -0,0 +1,43 @@
+#ifndef IRCODEGEN_H
+#define IRCODEGEN_H
+
+#include <QString>
+
+class DiagnosticEmitterBase;
+class IRRootType;
+
+/**
+ * C++ accessor generation for IR types
+ *
+ * The generated header (one per IRRootType) has a namespace named after the IR type, with one class per node type:
+ *   - constexpr TypeIndex, ParamIndex_<param> and ChildLocalIndex_<child> indices
+ *   - typed getters get_<param>() reading parameter storage directly (IRConstNodeInstance::getParameterAs());
+ *     String getters return by value and decode on each call when the string pool is in Utf8 mode
+ *   - getChildren_<child>() returning a range of child accessors, for use in range-based for
+ * and a matchesSchema() function to check the IRRootType in use against the one the header is generated from.
+ * Code using a parameter or child that is renamed or removed from the schema fails to compile after regeneration.
+ * Names that are not C++ identifiers are mapped by getIdentifier().
+ */
+namespace IRCodegen{
+
+/**
+ * @brief generateHeader generate the accessor header for an IR type
+ * @param ty the IR type; must be validated
+ * @param diagnostic where errors are reported
+ * @param result the header content
+ * @return true on success; false if different names are mapped to the same identifier
+ */
+bool generateHeader(const IRRootType& ty, DiagnosticEmitterBase& diagnostic, QString& result);
+
+/**
+ * @brief getIdentifier map a name to a C++ identifier
+ *
+ * Characters other than ASCII letters, digits and underscore are replaced by underscore, runs of underscores are merged,
+ * a name not starting with a letter (or starting with a generated member prefix like "get_") is prefixed with 'N',
+ * and an underscore is appended to C++ keywords and to names used by the generated code itself.
+ */
+QString getIdentifier(const QString& name);
+
+}
+
+#endif // IRCODEGEN_H
@@ -7,6 +7,14 @@
 #include <QObject>
 #include <QQueue>
 #include <QDebug>
+#include <QRunnable>
+#include <QThread>
+#include <QThreadPool>
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <vector>
 
 namespace{
 const char ILLEGAL_CHARS_1[] = {
@@ -27,6 +35,87 @@ const EscapedIllegalCharRecord ILLEGAL_CHARS_2[] = {
     {'\b', 'b'},
     {'\0', '0'}
 };
+
+class ValidateRunnable : public QRunnable
+{
+public:
+    explicit ValidateRunnable(std::function<void()> func): func(func){}
+    void run() override {func();}
+private:
+    std::function<void()> func;
+};
+
+struct UniqueKeyEntry{
+    qint64 key;
+    int nodeIndex;
+};
+
+// check whether one unique parameter of children in childByType[first, last) is really unique
+// keys are either Int64 values or string ids; getKeyString converts them back for diagnostic
+// lookup hashes are not built here; see IRRootInstance::getLookupIndex()
+template<typename KeyType, typename KeyToString>
+bool checkUniqueKey(DiagnosticEmitterBase& diagnostic, const IRNodeType& childTy, int paramIndex,
+                    const ChunkedVector<KeyType>& column, KeyToString getKeyString,
+                    const ChunkedVector<int>& nodeRow, const QVector<int>& childByType, int first, int last)
+{
+    if(last - first < 2)
+        return true;
+
+    QVector<UniqueKeyEntry> entries;
+    entries.reserve(last - first);
+    for(int k = first; k < last; ++k){
+        int childNodeIndex = childByType.at(k);
+        entries.push_back(UniqueKeyEntry{static_cast<qint64>(column.at(nodeRow.at(childNodeIndex))), childNodeIndex});
+    }
+    std::sort(entries.begin(), entries.end(), [](const UniqueKeyEntry& lhs, const UniqueKeyEntry& rhs)->bool{
+        return (lhs.key < rhs.key) || (lhs.key == rhs.key && lhs.nodeIndex < rhs.nodeIndex);
+    });
+
+    // report duplicates in document order (i.e. by node index of the duplicate), not in key order
+    struct Duplicate{
+        int firstEntry;
+        int entry;
+    };
+    QVector<Duplicate> duplicates;
+    for(int i = 1, runStart = 0, n = entries.size(); i < n; ++i){
+        if(Q_LIKELY(entries.at(i).key != entries.at(runStart).key)){
+            runStart = i;
+            continue;
+        }
+        duplicates.push_back(Duplicate{runStart, i});
+    }
+    if(Q_LIKELY(duplicates.isEmpty()))
+        return true;
+
+    std::sort(duplicates.begin(), duplicates.end(), [&entries](const Duplicate& lhs, const Duplicate& rhs)->bool{
+        return entries.at(lhs.entry).nodeIndex < entries.at(rhs.entry).nodeIndex;
+    });
+    for(const Duplicate& dup : duplicates){
+        diagnostic(Diag::Error_IR_BadTree_BrokenConstraint_ParamNotUnique,
+                   childTy.getName(), childTy.getParameterName(paramIndex),
+                   entries.at(dup.firstEntry).nodeIndex, entries.at(dup.entry).nodeIndex,
+                   getKeyString(static_cast<KeyType>(entries.at(dup.entry).key)));
+    }
+    return false;
+}
+
+// result is rows[0, split) + srcRows (each mapped by mapSrc) + rows[split, end) (each mapped by mapTail)
+template<typename T, typename MapSrc, typename MapTail>
+void spliceRows(ChunkedVector<T>& rows, int split, const ChunkedVector<T>& srcRows, MapSrc mapSrc, MapTail mapTail)
+{
+    ChunkedVector<T> result;
+    result.reserve(rows.size() + srcRows.size());
+    for(int i = 0; i < split; ++i){
+        result.push_back(rows.at(i));
+    }
+    for(const T& value : srcRows){
+        result.push_back(mapSrc(value));
+    }
+    for(int i = split, n = rows.size(); i < n; ++i){
+        result.push_back(mapTail(rows.at(i)));
+    }
+    rows.swap(result);
+}
 }
 
 bool IRNodeType::validateName(DiagnosticEmitterBase& diagnostic, const QString &name)
@@ -189,120 +278,253 @@ bool IRRootType::validate(DiagnosticEmitterBase& diagnostic)
     return isValidated;
 }
 
-bool IRNodeInstance::validate(DiagnosticEmitterBase& diagnostic, IRRootInstance& root)
+bool IRRootInstance::checkUniqueParameters(DiagnosticEmitterBase& diagnostic, int slot, int childTypeIndex) const
 {
-    // note that broken tree and invalid node type should already been catched in IRRootInstance::validate()
-    // therefore here it is safe to assume that type index is valid and tree structure is well formed
-
     bool isValidated = true;
-    const IRRootType& rootTy = root.getType();
-    const IRNodeType& ty = rootTy.getNodeType(typeIndex);
-    diagnostic.setDetailedName(ty.getName());
-
-    // check if parameter is good
-    if(Q_UNLIKELY(ty.getNumParameter() != parameters.size())){
-        diagnostic(Diag::Error_IR_BadParameterList_Count, ty.getNumParameter(), parameters.size());
-        isValidated = false;
-    }else{
-        // number of parameters match
-        // check if their type is matching
-        for(int i = 0, len = parameters.size(); i < len; ++i){
-            const QVariant& val = parameters.at(i);
-            ValueType valTy = ty.getParameterType(i);
-            ValueType givenTy = getValueType(static_cast<QMetaType::Type>(val.userType()));
-            if(Q_UNLIKELY(valTy != givenTy)){
-                diagnostic(Diag::Error_IR_BadParameterList_Type, i, valTy, givenTy);
-                isValidated = false;
+    const IndexRange& range = childTypeRange.at(slot);
+    const IRNodeType& childTy = ty.getNodeType(childTypeIndex);
+    const NodeTypeTable& childTable = typeTables.at(childTypeIndex);
+    for(int j = 0, numParam = childTy.getNumParameter(); j < numParam; ++j){
+        if(childTy.getParameterIsUnique(j)){
+            const ParameterColumn& column = childTable.columns.at(j);
+            bool isUnique = true;
+            switch(column.ty){
+            case ValueType::Int64:{
+                isUnique = checkUniqueKey(diagnostic, childTy, j, column.intData,
+                                          [](qint64 key)->QString{return QString::number(key);},
+                                          nodeRow, childByType, range.start, range.start + range.count);
+            }break;
+            case ValueType::String:{
+                isUnique = checkUniqueKey(diagnostic, childTy, j, column.stringData,
+                                          [this](int id)->QString{return stringPool.get(id);},
+                                          nodeRow, childByType, range.start, range.start + range.count);
+            }break;
+            default: Q_UNREACHABLE();
             }
+            isValidated = isValidated && isUnique;
         }
     }
+    return isValidated;
+}
 
-    // check if children are good
-    int numChildNodeType = ty.getNumChildNode();
-    RunTimeSizeArray<bool> isChildTypeGood(static_cast<std::size_t>(numChildNodeType), true);
+/**
+ * @brief The ValidateTaskTable struct holds subtrees that are validated on worker threads
+ */
+struct IRRootInstance::ValidateTaskTable{
+    struct Task{
+        int nodeIndex = -1;
+        int subtreeSize = 0;
+        bool isValidated = false;
+        RecordingDiagnosticEmitter diagnostic;
+    };
+    QVector<int> taskOfNode;    //!< [node] -> task index; -1 if the node is validated by the calling thread
+    QVector<Task> taskList;     //!< tasks, larger subtree first
+};
 
-    childNodeTypeIndexToLocalIndex.clear();
-    for(int i = 0; i < numChildNodeType; ++i){
-        int globalNodeTyIndex = rootTy.getNodeTypeIndex(ty.getChildNodeName(i));
-        childNodeTypeIndexToLocalIndex.insert(globalNodeTyIndex, i);
+void IRRootInstance::runValidateTasks(ValidateTaskTable& tasks) const
+{
+    QThreadPool pool;
+    if(parallelValidationThreadCount > 0){
+        pool.setMaxThreadCount(parallelValidationThreadCount);
     }
-    childTypeList.clear();
-    childTypeList.reserve(numChildNodeType);
-    for(int i = 0; i < numChildNodeType; ++i){
-        childTypeList.push_back(ChildTypeRecord());
+    // validateNode() is const and only uses const member access (no implicit detach of shared containers),
+    // so subtrees can be validated concurrently
+    // each thread keeps taking the next task until none is left
+    ValidateTaskTable::Task* taskData = tasks.taskList.data();
+    int numTask = tasks.taskList.size();
+    QAtomicInt nextTask(0);
+    auto processTasks = [this, taskData, numTask, &nextTask]()->void{
+        for(int i = nextTask.fetchAndAddRelaxed(1); i < numTask; i = nextTask.fetchAndAddRelaxed(1)){
+            ValidateTaskTable::Task& task = taskData[i];
+            // stands for the "Child" path node that the parent would push
+            DiagnosticPathNode dnode(task.diagnostic, QString());
+            task.isValidated = validateNode(task.diagnostic, task.nodeIndex);
+            dnode.pop();
+        }
+    };
+    for(int i = 1, n = std::min(pool.maxThreadCount(), numTask); i < n; ++i){
+        pool.start(new ValidateRunnable(processTasks));
     }
-    Q_ASSERT(childTypeList.size() == numChildNodeType);
+    processTasks();
+    pool.waitForDone();
+}
 
-    // when checking whether children are good,
-    // fatal errors are tracked by isValidated
-    // non-fatal errors are tracked by isChildTypeGood
-    for(int i = 0, cnt = childNodeList.size(); i < cnt; ++i){
-        int childNodeIndex = childNodeList.at(i);
-        DiagnosticPathNode dnode(diagnostic, tr("Child %1").arg(i));
-        IRNodeInstance& child = root.getNode(childNodeIndex);
-        bool isChildGood = child.validate(diagnostic, root);
-        int localTyIndex = getLocalTypeIndex(child.getTypeIndex());
-        if(Q_UNLIKELY(localTyIndex == -1)){
-            diagnostic(Diag::Error_IR_BadTree_UnexpectedChild, rootTy.getNodeType(child.getTypeIndex()).getName());
-            isValidated = false;
-        }else{
-            Q_ASSERT(localTyIndex >= 0 && localTyIndex < childTypeList.size());
-            childTypeList[localTyIndex].nodeList.push_back(childNodeIndex);
-            if(Q_UNLIKELY(!isChildGood)){
-                isChildTypeGood.at(localTyIndex) = false;
+bool IRRootInstance::validateNode(DiagnosticEmitterBase& diagnostic, int nodeIndex, const ValidateTaskTable* tasks) const
+{
+    // note that broken tree and invalid node type should already been catched in IRRootInstance::validate()
+    // therefore here it is safe to assume that type index is valid and tree structure is well formed
+
+    // the subtree is walked with an explicit stack instead of recursion, so that the tree depth is not limited by
+    // the thread stack size (worker threads in runValidateTasks() can have small stacks)
+    // diagnostics are emitted in the same order as a depth-first recursive walk
+    struct Frame{
+        int nodeIndex;
+        int childOrder;                                 //!< next child to visit
+        // when checking whether children are good,
+        // fatal errors are tracked by isValidated
+        // non-fatal errors are tracked by isChildTypeGood
+        bool isValidated;
+        QVector<bool> isChildTypeGood;
+        std::unique_ptr<DiagnosticPathNode> childPath;  //!< path node of the child being visited
+    };
+    std::vector<Frame> frames;
+
+    auto enterNode = [&](int currentIndex)->void{
+        bool isValidated = true;
+        const IRNodeType& nodeTy = ty.getNodeType(nodeTypeIndex.at(currentIndex));
+        diagnostic.setDetailedName(nodeTy.getName());
+
+        // check if parameter is good
+        // parameters are stored in typed columns; only the ones rejected by setParameters() can be bad
+        auto badTypeIter = badParameterTypes.constFind(currentIndex);
+        if(Q_UNLIKELY(badTypeIter != badParameterTypes.constEnd())){
+            const QVector<ValueType>& givenTypes = badTypeIter.value();
+            if(Q_UNLIKELY(nodeTy.getNumParameter() != givenTypes.size())){
+                diagnostic(Diag::Error_IR_BadParameterList_Count, nodeTy.getNumParameter(), givenTypes.size());
+            }else{
+                for(int i = 0, len = givenTypes.size(); i < len; ++i){
+                    ValueType valTy = nodeTy.getParameterType(i);
+                    ValueType givenTy = givenTypes.at(i);
+                    if(Q_UNLIKELY(valTy != givenTy)){
+                        diagnostic(Diag::Error_IR_BadParameterList_Type, i, valTy, givenTy);
+                    }
+                }
             }
+            isValidated = false;
         }
-        dnode.pop();
-    }
-    // check for key unique constraints and construct perParamHash in childTypeList
-    // do not check this property if anything is already failed
-    if(isValidated){
-        for(int i = 0; i < numChildNodeType; ++i){
-            if(Q_LIKELY(isChildTypeGood.at(i))){
-                ChildTypeRecord& record = childTypeList[i];
-                record.perParamHash.clear();
-                const IRNodeType& nodeTy = rootTy.getNodeType(rootTy.getNodeTypeIndex(ty.getChildNodeName(i)));
-                for(int i = 0, numParam = nodeTy.getNumParameter(); i < numParam; ++i){
-                    record.perParamHash.push_back(QHash<QVariant,int>());
-                    if(nodeTy.getParameterIsUnique(i)){
-                        QHash<QVariant,int>& hash = record.perParamHash.back();
-                        for(int nodeIndex : record.nodeList){
-                            const IRNodeInstance& inst = root.getNode(nodeIndex);
-                            const QVariant& val = inst.parameters.at(i);
-                            auto iter = hash.find(val);
-                            if(Q_LIKELY(iter == hash.end())){
-                                hash.insert(val, nodeIndex);
-                            }else{
-                                diagnostic(Diag::Error_IR_BadTree_BrokenConstraint_ParamNotUnique,
-                                           nodeTy.getName(), nodeTy.getParameterName(i), iter.value(), nodeIndex, val.toString());
-                                isValidated = false;
-                            }
+        frames.push_back(Frame{currentIndex, 0, isValidated, QVector<bool>(nodeTy.getNumChildNode(), true), nullptr});
+    };
+
+    enterNode(nodeIndex);
+    while(true){
+        int childNodeIndex = -1;
+        bool isChildGood = true;
+        {
+            Frame& frame = frames.back();
+            int currentIndex = frame.nodeIndex;
+            int first = childStart.at(currentIndex);
+            if(frame.childOrder < childStart.at(currentIndex+1) - first){
+                // check if children are good
+                childNodeIndex = childList.at(first + frame.childOrder);
+                frame.childPath.reset(new DiagnosticPathNode(diagnostic, tr("Child %1").arg(frame.childOrder)));
+                int taskIndex = (tasks? tasks->taskOfNode.at(childNodeIndex) : -1);
+                if(taskIndex < 0){
+                    enterNode(childNodeIndex);
+                    continue;
+                }
+                // this subtree is already validated on worker thread; just merge the result
+                const ValidateTaskTable::Task& task = tasks->taskList.at(taskIndex);
+                task.diagnostic.replay(diagnostic, ty.getNodeType(nodeTypeIndex.at(childNodeIndex)).getName());
+                isChildGood = task.isValidated;
+            }else{
+                // all children are visited
+                // check for key unique constraints
+                // do not check this property if anything is already failed
+                if(frame.isValidated){
+                    const IRNodeType& nodeTy = ty.getNodeType(nodeTypeIndex.at(currentIndex));
+                    int slotStart = childTypeSlotStart.at(currentIndex);
+                    for(int i = 0, numChildNodeType = nodeTy.getNumChildNode(); i < numChildNodeType; ++i){
+                        if(Q_LIKELY(frame.isChildTypeGood.at(i))){
+                            int childTypeIndex = ty.getNodeTypeIndex(nodeTy.getChildNodeName(i));
+                            // no short circuit
+                            frame.isValidated = checkUniqueParameters(diagnostic, slotStart + i, childTypeIndex) && frame.isValidated;
+                        }else{ // isChildTypeGood.at(i) == false
+                            frame.isValidated = false;
                         }
                     }
                 }
-                Q_ASSERT(record.perParamHash.size() == nodeTy.getNumParameter());
-            }else{ // isChildTypeGood.at(i) == false
-                isValidated = false;
+                isChildGood = frame.isValidated;
+                childNodeIndex = currentIndex;
+                frames.pop_back();
+                if(frames.empty())
+                    return isChildGood;
             }
         }
+
+        // merge the result of a child into its parent
+        Frame& parent = frames.back();
+        int childTypeIndex = nodeTypeIndex.at(childNodeIndex);
+        int localTyIndex = childTypeToLocal.at(nodeTypeIndex.at(parent.nodeIndex)).value(childTypeIndex, -1);
+        if(Q_UNLIKELY(localTyIndex == -1)){
+            diagnostic(Diag::Error_IR_BadTree_UnexpectedChild, ty.getNodeType(childTypeIndex).getName());
+            parent.isValidated = false;
+        }else if(Q_UNLIKELY(!isChildGood)){
+            parent.isChildTypeGood[localTyIndex] = false;
+        }
+        parent.childPath.reset();
+        parent.childOrder += 1;
     }
+}
 
-    return isValidated;
+void IRRootInstance::buildChildTypeIndex()
+{
+    int numNode = nodeTypeIndex.size();
+    // one slot per (node, child type of node type)
+    childTypeSlotStart.resize(numNode);
+    int numSlot = 0;
+    for(int i = 0; i < numNode; ++i){
+        childTypeSlotStart[i] = numSlot;
+        numSlot += ty.getNodeType(nodeTypeIndex.at(i)).getNumChildNode();
+    }
+    childTypeRange.fill(IndexRange{0, 0}, numSlot);
+    // children with unexpected type are not placed in any slot; validateNode() will report them
+    RunTimeSizeArray<int> childSlot(static_cast<std::size_t>(childList.size()), -1);
+    for(int i = 0; i < numNode; ++i){
+        const QHash<int,int>& localTypeMap = childTypeToLocal.at(nodeTypeIndex.at(i));
+        for(int j = childStart.at(i), end = childStart.at(i+1); j < end; ++j){
+            int localTyIndex = localTypeMap.value(nodeTypeIndex.at(childList.at(j)), -1);
+            if(localTyIndex >= 0){
+                int slot = childTypeSlotStart.at(i) + localTyIndex;
+                childSlot.at(j) = slot;
+                childTypeRange[slot].count += 1;
+            }
+        }
+    }
+    int numGroupedChild = 0;
+    for(auto& range : childTypeRange){
+        range.start = numGroupedChild;
+        numGroupedChild += range.count;
+        range.count = 0;
+    }
+    childByType.resize(numGroupedChild);
+    for(int j = 0, num = childList.size(); j < num; ++j){
+        int slot = childSlot.at(j);
+        if(slot >= 0){
+            IndexRange& range = childTypeRange[slot];
+            childByType[range.start + range.count] = childList.at(j);
+            range.count += 1;
+        }
+    }
+    buildNodeOrdinal();
+    // lookup index is built lazily on first getChildNodeIndex() by key
+    resetLookupIndex(numSlot);
 }
 
-bool IRRootInstance::validate(DiagnosticEmitterBase& diagnostic)
+void IRRootInstance::buildNodeOrdinal()
 {
-    DiagnosticPathNode dnode(diagnostic, tr("Root"));
-    if(nodeList.empty()){
-        diagnostic(Diag::Error_IR_BadTree_EmptyTree);
-        isValidated = false;
-        return isValidated;
+    int numNode = nodeTypeIndex.size();
+    nodeOrderInParent.fill(0, numNode);
+    for(int i = 0; i < numNode; ++i){
+        for(int j = childStart.at(i), end = childStart.at(i+1); j < end; ++j){
+            nodeOrderInParent[childList.at(j)] = j - childStart.at(i);
+        }
     }
+    // children with unexpected type are not in any slot and keep 0; validation fails on them anyway
+    nodeIndexUnderType.fill(0, numNode);
+    for(const auto& range : childTypeRange){
+        for(int k = 0; k < range.count; ++k){
+            nodeIndexUnderType[childByType.at(range.start + k)] = k;
+        }
+    }
+}
 
-    isValidated = true;
+bool IRRootInstance::checkTreeStructure(DiagnosticEmitterBase& diagnostic) const
+{
+    int numNode = nodeTypeIndex.size();
+    bool isTreeGood = true;
 
-    // first of all, do a reachability analysis
-    RunTimeSizeArray<int> isNodeReachable(static_cast<std::size_t>(nodeList.size()), -2);
+    // reachability analysis
+    RunTimeSizeArray<int> isNodeReachable(static_cast<std::size_t>(numNode), -2);
     struct Entry{
         int parent;
         int child;
@@ -314,7 +536,7 @@ bool IRRootInstance::validate(DiagnosticEmitterBase& diagnostic)
         Entry curEntry = pendingNodes.dequeue();
         int parentIndex = curEntry.parent;
         int currentIndex = curEntry.child;
-        Q_ASSERT(currentIndex < nodeList.size());
+        Q_ASSERT(currentIndex < numNode);
         bool isCurrentNodeGood = true;
 
         if(Q_UNLIKELY(isNodeReachable.at(currentIndex) != -2)){
@@ -330,35 +552,351 @@ bool IRRootInstance::validate(DiagnosticEmitterBase& diagnostic)
             isCurrentNodeGood = false;
         }
 
-        const IRNodeInstance& child = nodeList.at(currentIndex);
-        if(Q_UNLIKELY(child.getParentIndex() != parentIndex)){
-            diagnostic(Diag::Error_IR_BadTree_ConflictingParentReference, currentIndex, child.getParentIndex(), parentIndex);
+        int currentParent = nodeParent.at(currentIndex);
+        if(Q_UNLIKELY(currentParent != parentIndex)){
+            diagnostic(Diag::Error_IR_BadTree_ConflictingParentReference, currentIndex, currentParent, parentIndex);
             isCurrentNodeGood = false;
         }
-        if(Q_UNLIKELY(!ty.isNodeTypeIndexValid(child.getTypeIndex()))){
-            diagnostic(Diag::Error_IR_BadTree_BadNodeTypeIndex, currentIndex, child.getTypeIndex());
+        int currentType = nodeTypeIndex.at(currentIndex);
+        if(Q_UNLIKELY(!ty.isNodeTypeIndexValid(currentType))){
+            diagnostic(Diag::Error_IR_BadTree_BadNodeTypeIndex, currentIndex, currentType);
             isCurrentNodeGood = false;
         }
 
-        isValidated = isValidated && isCurrentNodeGood;
+        isTreeGood = isTreeGood && isCurrentNodeGood;
         if(Q_LIKELY(isCurrentNodeGood)){
-            for(int i = 0, num = child.getNumChildNode(); i < num; ++i){
-                int childIndex = child.getChildNodeByOrder(i);
-                pendingNodes.enqueue(Entry{currentIndex, childIndex});
+            for(int i = childStart.at(currentIndex), end = childStart.at(currentIndex+1); i < end; ++i){
+                pendingNodes.enqueue(Entry{currentIndex, childList.at(i)});
             }
         }
     }
-    for(int i = 0, num = nodeList.size(); i < num; ++i){
+    for(int i = 0; i < numNode; ++i){
         if(Q_UNLIKELY(isNodeReachable.at(i) == -2)){
             diagnostic(Diag::Error_IR_BadTree_UnreachableNode, i);
-            isValidated = false;
+            isTreeGood = false;
+        }
+    }
+
+    if(Q_LIKELY(isTreeGood)){
+        // nodes must be in pre-order so that every subtree is a contiguous index range
+        // (ExecutionContext, subtree hash and graftSubtree() rely on it);
+        // the tree is well formed here, so a depth-first walk in child order must visit 0, 1, 2, ...
+        std::vector<int> pendingPreOrder;
+        pendingPreOrder.push_back(0);
+        for(int expected = 0; !pendingPreOrder.empty(); ++expected){
+            int currentIndex = pendingPreOrder.back();
+            pendingPreOrder.pop_back();
+            if(Q_UNLIKELY(currentIndex != expected)){
+                diagnostic(Diag::Error_IR_BadTree_NotPreOrder, currentIndex, expected);
+                isTreeGood = false;
+                break;
+            }
+            for(int i = childStart.at(currentIndex+1) - 1, first = childStart.at(currentIndex); i >= first; --i){
+                pendingPreOrder.push_back(childList.at(i));
+            }
         }
     }
+    return isTreeGood;
+}
+
+bool IRRootInstance::validate(DiagnosticEmitterBase& diagnostic)
+{
+    DiagnosticPathNode dnode(diagnostic, tr("Root"));
+    // a full validation covers all edits so far
+    isStructureDirty = true;
+    dirtyNodes.clear();
+    int numNode = nodeTypeIndex.size();
+    if(numNode == 0){
+        diagnostic(Diag::Error_IR_BadTree_EmptyTree);
+        isValidated = false;
+        return isValidated;
+    }
+
+    // merge all addChildNode() calls into CSR child list
+    buildChildList();
+
+    // first of all, make sure the tree is well formed
+    isValidated = checkTreeStructure(diagnostic);
 
     if(Q_LIKELY(isValidated)){
-        isValidated = nodeList.front().validate(diagnostic, *this);
+        // tree is well formed; group children by their local type
+        buildChildTypeIndex();
+
+        if(parallelValidationThreshold > 0 && numNode >= parallelValidationThreshold){
+            // partition the tree into subtrees of similar size
+            // nodes above them (including root) are still validated on this thread
+            QVector<int> subtreeSize(numNode, 1);
+            for(int i = numNode-1; i > 0; --i){
+                subtreeSize[nodeParent.at(i)] += subtreeSize.at(i);
+            }
+            int threadCount = (parallelValidationThreadCount > 0)? parallelValidationThreadCount : QThread::idealThreadCount();
+            int grainSize = std::max(1, numNode / (std::max(1, threadCount) * 8));
+
+            ValidateTaskTable tasks;
+            tasks.taskOfNode.fill(-1, numNode);
+            QVector<int> pendingSubtrees;
+            pendingSubtrees.push_back(0);
+            while(!pendingSubtrees.isEmpty()){
+                int current = pendingSubtrees.back();
+                pendingSubtrees.pop_back();
+                if(current != 0 && subtreeSize.at(current) <= grainSize){
+                    ValidateTaskTable::Task task;
+                    task.nodeIndex = current;
+                    task.subtreeSize = subtreeSize.at(current);
+                    tasks.taskList.push_back(task);
+                }else{
+                    for(int i = childStart.at(current), end = childStart.at(current+1); i < end; ++i){
+                        pendingSubtrees.push_back(childList.at(i));
+                    }
+                }
+            }
+            std::sort(tasks.taskList.begin(), tasks.taskList.end(),
+                      [](const ValidateTaskTable::Task& lhs, const ValidateTaskTable::Task& rhs)->bool{
+                return lhs.subtreeSize > rhs.subtreeSize;
+            });
+            for(int i = 0, n = tasks.taskList.size(); i < n; ++i){
+                tasks.taskOfNode[tasks.taskList.at(i).nodeIndex] = i;
+            }
+            runValidateTasks(tasks);
+            isValidated = validateNode(diagnostic, 0, &tasks);
+        }else{
+            isValidated = validateNode(diagnostic, 0);
+        }
+    }
+
+    if(isValidated && isSubtreeHashEnabled){
+        buildSubtreeHash();
+    }else{
+        subtreeHash.clear();
     }
 
+    isStructureDirty = !isValidated;
     dnode.pop();
     return isValidated;
 }
+
+bool IRRootInstance::revalidate(DiagnosticEmitterBase& diagnostic)
+{
+    if(isValidated)
+        return true;
+    if(isStructureDirty || !pendingChildEdges.isEmpty())
+        return validate(diagnostic);
+
+    // only parameters are changed since last successful validation
+    // re-check the changed nodes and uniqueness among their siblings of the same type
+    std::sort(dirtyNodes.begin(), dirtyNodes.end());
+    dirtyNodes.erase(std::unique(dirtyNodes.begin(), dirtyNodes.end()), dirtyNodes.end());
+
+    bool isGood = true;
+    QVector<int> dirtySlots;
+    for(int nodeIndex : dirtyNodes){
+        if(Q_UNLIKELY(badParameterTypes.contains(nodeIndex))){
+            isGood = false;
+            break;
+        }
+        int parentIndex = nodeParent.at(nodeIndex);
+        if(parentIndex >= 0){
+            int localTyIndex = childTypeToLocal.at(nodeTypeIndex.at(parentIndex)).value(nodeTypeIndex.at(nodeIndex), -1);
+            Q_ASSERT(localTyIndex >= 0);
+            dirtySlots.push_back(childTypeSlotStart.at(parentIndex) + localTyIndex);
+        }
+    }
+    std::sort(dirtySlots.begin(), dirtySlots.end());
+    dirtySlots.erase(std::unique(dirtySlots.begin(), dirtySlots.end()), dirtySlots.end());
+
+    if(Q_LIKELY(isGood)){
+        // diagnostics are discarded here; on failure we rerun a full validation to get them
+        DiagnosticEmitterBase silent;
+        for(int slot : dirtySlots){
+            const IndexRange& range = childTypeRange.at(slot);
+            Q_ASSERT(range.count > 0);
+            if(!checkUniqueParameters(silent, slot, nodeTypeIndex.at(childByType.at(range.start)))){
+                isGood = false;
+                break;
+            }
+        }
+    }
+    if(Q_UNLIKELY(!isGood))
+        return validate(diagnostic);
+
+    // lookup indexes of changed slots are now stale
+    for(int slot : dirtySlots){
+        delete lookupIndex[slot].loadAcquire();
+        lookupIndex[slot].storeRelease(nullptr);
+    }
+    if(isSubtreeHashEnabled){
+        if(subtreeHash.size() == nodeTypeIndex.size()){
+            updateSubtreeHash(dirtyNodes);
+        }else{
+            buildSubtreeHash();
+        }
+    }
+    dirtyNodes.clear();
+    isValidated = true;
+    return isValidated;
+}
+
+int IRRootInstance::graftSubtree(int parentIndex, const IRRootInstance& src, DiagnosticEmitterBase& diagnostic)
+{
+    Q_ASSERT(isValidated && src.isValidated && &src.ty == &ty && &src != this);
+    Q_ASSERT(parentIndex >= 0 && parentIndex < nodeTypeIndex.size());
+    Q_ASSERT(dirtyNodes.isEmpty() && badParameterTypes.isEmpty());
+
+    int srcRootType = src.nodeTypeIndex.at(0);
+    int localTyIndex = childTypeToLocal.at(nodeTypeIndex.at(parentIndex)).value(srcRootType, -1);
+    if(Q_UNLIKELY(localTyIndex == -1)){
+        diagnostic(Diag::Error_IR_BadTree_UnexpectedChild, ty.getNodeType(srcRootType).getName());
+        return -1;
+    }
+
+    int numOldNode = nodeTypeIndex.size();
+    int numSrcNode = src.nodeTypeIndex.size();
+    int numNode = numOldNode + numSrcNode;
+
+    // to keep pre-order, the subtree is inserted right after the last node in the subtree of parent
+    // nodes from there on are shifted by numSrcNode
+    int pos = parentIndex;
+    while(childStart.at(pos+1) > childStart.at(pos)){
+        pos = childList.at(childStart.at(pos+1)-1);
+    }
+    pos += 1;
+    auto mapOld = [=](int nodeIndex)->int{return (nodeIndex < pos)? nodeIndex : nodeIndex + numSrcNode;};
+    auto mapSrc = [=](int nodeIndex)->int{return nodeIndex + pos;};
+    auto keepValue = [](int value)->int{return value;};
+
+    QVector<int> stringMap(src.stringPool.size());
+    for(int i = 0, n = stringMap.size(); i < n; ++i){
+        stringMap[i] = stringPool.intern(src.stringPool.get(i));
+    }
+
+    // parameter tables: rows of src nodes go between rows of nodes before and after pos, so nodeList stays ascending
+    for(int t = 0, numType = typeTables.size(); t < numType; ++t){
+        NodeTypeTable& table = typeTables[t];
+        const NodeTypeTable& srcTable = src.typeTables.at(t);
+        int split = static_cast<int>(std::lower_bound(table.nodeList.constBegin(), table.nodeList.constEnd(), pos) - table.nodeList.constBegin());
+        if(srcTable.nodeList.isEmpty()){
+            for(int i = split, n = table.nodeList.size(); i < n; ++i){
+                table.nodeList[i] += numSrcNode;
+            }
+            continue;
+        }
+        spliceRows(table.nodeList, split, srcTable.nodeList, mapSrc, mapOld);
+        for(int j = 0, numParam = table.columns.size(); j < numParam; ++j){
+            ParameterColumn& column = table.columns[j];
+            const ParameterColumn& srcColumn = srcTable.columns.at(j);
+            switch(column.ty){
+            case ValueType::Int64:
+                spliceRows(column.intData, split, srcColumn.intData, [](qint64 value)->qint64{return value;}, [](qint64 value)->qint64{return value;});
+                break;
+            case ValueType::String:
+                spliceRows(column.stringData, split, srcColumn.stringData, [&stringMap](int id)->int{return stringMap.at(id);}, keepValue);
+                break;
+            default: Q_UNREACHABLE();
+            }
+        }
+    }
+
+    // per node arrays and child lists, in one pass over the new node order
+    ChunkedVector<int> newNodeTypeIndex;
+    ChunkedVector<int> newNodeParent;
+    QVector<int> newChildStart;
+    QVector<int> newChildList;
+    QVector<int> newChildTypeSlotStart;
+    QVector<IndexRange> newChildTypeRange;
+    QVector<int> newChildByType;
+    newNodeTypeIndex.reserve(numNode);
+    newNodeParent.reserve(numNode);
+    newChildStart.reserve(numNode+1);
+    newChildList.reserve(childList.size() + src.childList.size() + 1);
+    newChildTypeSlotStart.reserve(numNode);
+    newChildTypeRange.reserve(childTypeRange.size() + src.childTypeRange.size());
+    newChildByType.reserve(childByType.size() + src.childByType.size() + 1);
+    int numSlot = childTypeRange.size() + src.childTypeRange.size();
+    std::unique_ptr<QAtomicPointer<LookupIndex>[]> newLookupIndex(numSlot > 0? new QAtomicPointer<LookupIndex>[numSlot] : nullptr);
+    for(int i = 0; i < numNode; ++i){
+        bool isFromSrc = (i >= pos && i < pos + numSrcNode);
+        const IRRootInstance& from = isFromSrc? src : *this;
+        int fromIndex = isFromSrc? i - pos : ((i < pos)? i : i - numSrcNode);
+        bool isGraftPoint = (!isFromSrc && fromIndex == parentIndex);
+        auto mapNode = [=](int nodeIndex)->int{return isFromSrc? mapSrc(nodeIndex) : mapOld(nodeIndex);};
+
+        int typeIndex = from.nodeTypeIndex.at(fromIndex);
+        newNodeTypeIndex.push_back(typeIndex);
+        int parent = from.nodeParent.at(fromIndex);
+        newNodeParent.push_back((isFromSrc && parent == -1)? parentIndex : ((parent == -1)? -1 : mapNode(parent)));
+
+        newChildStart.push_back(newChildList.size());
+        for(int j = from.childStart.at(fromIndex), end = from.childStart.at(fromIndex+1); j < end; ++j){
+            newChildList.push_back(mapNode(from.childList.at(j)));
+        }
+        if(isGraftPoint){
+            newChildList.push_back(pos);
+        }
+
+        int slotStart = from.childTypeSlotStart.at(fromIndex);
+        newChildTypeSlotStart.push_back(newChildTypeRange.size());
+        for(int j = 0, numChildType = ty.getNodeType(typeIndex).getNumChildNode(); j < numChildType; ++j){
+            int slot = slotStart + j;
+            const IndexRange& range = from.childTypeRange.at(slot);
+            IndexRange newRange{newChildByType.size(), range.count};
+            for(int k = range.start, end = range.start + range.count; k < end; ++k){
+                newChildByType.push_back(mapNode(from.childByType.at(k)));
+            }
+            if(isGraftPoint && j == localTyIndex){
+                newChildByType.push_back(pos);
+                newRange.count += 1;
+            }else if(!isFromSrc && (range.count == 0 || from.childByType.at(range.start + range.count - 1) < pos)){
+                // the lookup index of this slot is still valid if no node index in it is shifted
+                newLookupIndex[newChildTypeRange.size()].storeRelease(lookupIndex[slot].loadAcquire());
+                lookupIndex[slot].storeRelease(nullptr);
+            }
+            newChildTypeRange.push_back(newRange);
+        }
+    }
+    newChildStart.push_back(newChildList.size());
+
+    nodeTypeIndex.swap(newNodeTypeIndex);
+    nodeParent.swap(newNodeParent);
+    childStart.swap(newChildStart);
+    childList.swap(newChildList);
+    childTypeSlotStart.swap(newChildTypeSlotStart);
+    childTypeRange.swap(newChildTypeRange);
+    childByType.swap(newChildByType);
+    buildNodeOrdinal();
+    resetLookupIndex(0);
+    lookupIndex = std::move(newLookupIndex);
+    numLookupIndex = numSlot;
+
+    nodeRow.fill(-1, numNode);
+    for(const auto& table : typeTables){
+        for(int row = 0, n = table.nodeList.size(); row < n; ++row){
+            nodeRow[table.nodeList.at(row)] = row;
+        }
+    }
+
+    // src is validated as a whole; only uniqueness among the new siblings needs checking
+    int graftSlot = childTypeSlotStart.at(parentIndex) + localTyIndex;
+    if(Q_UNLIKELY(!checkUniqueParameters(diagnostic, graftSlot, srcRootType))){
+        isValidated = false;
+        isStructureDirty = true;
+        subtreeHash.clear();
+        return pos;
+    }
+
+    if(isSubtreeHashEnabled){
+        if(subtreeHash.size() == numOldNode){
+            bool isSrcHashed = src.hasSubtreeHash();
+            spliceRows(subtreeHash, pos, isSrcHashed? src.subtreeHash : ChunkedVector<quint64>(numSrcNode, 0),
+                       [](quint64 hash)->quint64{return hash;}, [](quint64 hash)->quint64{return hash;});
+            if(!isSrcHashed){
+                for(int i = pos + numSrcNode - 1; i >= pos; --i){
+                    subtreeHash[i] = computeNodeHash(i);
+                }
+            }
+            updateSubtreeHash(QVector<int>{parentIndex});
+        }else{
+            buildSubtreeHash();
+        }
+    }
+    return pos;
+}
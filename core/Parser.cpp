@@ -1,15 +1,21 @@
 #include "core/Parser.h"
 
 #include "core/IR.h"
+#include "core/IRBuilder.h"
 #include "core/DiagnosticEmitter.h"
+#include "util/ADT.h"
+#include "util/MemoryUsage.h"
 
 #include <QQueue>
+#include <QRunnable>
 #include <QRegularExpressionMatch>
 #include <QSet>
 #include <QStack>
 #include <QStringRef>
+#include <QThreadPool>
 
 #include <algorithm>
+#include <functional>
 #include <iterator>
 #include <memory>
 
@@ -26,6 +32,10 @@ Parser* Parser::getParser(const ParserPolicy& policy, const IRRootType& ir, Diag
 
     std::unique_ptr<Parser> ptr(new Parser);
 
+    // reporting options; callers can still change them on the parser afterwards
+    ptr->setAmbiguityReportMode(policy.isAmbiguityAggregated? AmbiguityReportMode::Aggregated : AmbiguityReportMode::Immediate,
+                                std::max(0, policy.ambiguitySampleCount));
+
     // construct ParseContext
 
     // check match pairs:
@@ -250,13 +260,13 @@ Parser* Parser::getParser(const ParserPolicy& policy, const IRRootType& ir, Diag
                 const QString& paramName = dest.paramName.at(i);
                 auto iter_overwrite = overwriteValueNameToIndex.find(paramName);
                 if(iter_overwrite != overwriteValueNameToIndex.end()){
-                    destPattern.valueTransform.push_back(overwriteValueTransformList.at(iter_overwrite.value()));
+                    destPattern.valueTransform.push_back(compileValueTransform(paramName, overwriteValueTransformList.at(iter_overwrite.value())));
                     overwriteValueNameToIndex.erase(iter_overwrite);
                 }else{
                     auto iter_def = valueNameToIndex.find(paramName);
                     if(Q_LIKELY(iter_def != valueNameToIndex.end())){
                         // append an empty transform
-                        destPattern.valueTransform.push_back(QList<PatternValueSubExpression>());
+                        destPattern.valueTransform.push_back(compileValueTransform(paramName, QList<PatternValueSubExpression>()));
                         referencedValues.insert(paramName);
                     }else{
                         diagnostic(Diag::Warn_Parser_MissingInitializer, paramName);
@@ -265,7 +275,7 @@ Parser* Parser::getParser(const ParserPolicy& policy, const IRRootType& ir, Diag
                         PatternValueSubExpression dummy;
                         dummy.ty = PatternValueSubExpression::OpType::Literal;
                         dummyExpr.push_back(dummy);
-                        destPattern.valueTransform.push_back(dummyExpr);
+                        destPattern.valueTransform.push_back(compileValueTransform(paramName, dummyExpr));
                     }
                 }
             }
@@ -299,6 +309,14 @@ Parser* Parser::getParser(const ParserPolicy& policy, const IRRootType& ir, Diag
                 isValidated = false;
                 continue;
             }
+            p.priorityScore = computePatternScore(p.elements, matchPairScoreList);
+        }
+
+        // order of trying patterns
+        dest.patternOrder = getPatternOrder(dest.patterns);
+        dest.earlyExitPatternOrder = getPatternOrder(dest.earlyExitPatterns);
+        for(const auto& pattern : dest.patterns){
+            dest.maxPatternScore = std::max(dest.maxPatternScore, pattern.priorityScore);
         }
 
         // combineToIRNodeTypeName
@@ -338,7 +356,7 @@ Parser* Parser::getParser(const ParserPolicy& policy, const IRRootType& ir, Diag
                 // there are some overwrite entries
                 dest.combineValueTransform.reserve(numParams);
                 for(int i = 0; i < numParams; ++i){
-                    dest.combineValueTransform.push_back(QList<QList<PatternValueSubExpression>>());
+                    dest.combineValueTransform.push_back(QList<ValueTransformPlan>());
                 }
                 Q_ASSERT(dest.combineValueTransform.size() == numParams);
                 for(auto iter = src.combinedNodeParams.begin(), iterEnd = src.combinedNodeParams.end();
@@ -363,7 +381,7 @@ Parser* Parser::getParser(const ParserPolicy& policy, const IRRootType& ir, Diag
                                               diagnostic))){
                                 isValidated = false;
                             }
-                            destList.push_back(curExpr);
+                            destList.push_back(compileValueTransform(iter.key(), curExpr));
                             // we don't check reference made here yet
                         }
                     }
@@ -1462,7 +1480,7 @@ bool Parser::ParseContext::parseValueTransformString(const QString& transform,
     return true;
 }
 
-QList<Parser::ParserNodeData> Parser::patternMatch(QVector<QStringRef> &text, DiagnosticEmitterBase& diagnostic) const
+bool Parser::patternMatch(ParseSession& session, QVector<QStringRef> &text, DiagnosticEmitterBase& diagnostic) const
 {
     /*
      * start with root node
@@ -1481,7 +1499,7 @@ QList<Parser::ParserNodeData> Parser::patternMatch(QVector<QStringRef> &text, Di
      * 2.   push / pops early exit pattern
      */
 
-    QList<ParserNodeData> parserNodes;
+    QVector<ParserNodeData>& parserNodes = session.parserNodes;
     int currentParentIndex = -1;
 
     QVector<QStringRef> textUnits;
@@ -1507,6 +1525,24 @@ QList<Parser::ParserNodeData> Parser::patternMatch(QVector<QStringRef> &text, Di
     // this set keeps track of which ParserNode types we don't want to waste time on
     QSet<int> implicitStartIgnoreTypeSet;
 
+    // scratch buffers for implicit start, reused across positions
+    QVector<int> pathQueue;
+    QVector<int> implicitPath;
+
+    // thread pool for parallel pattern matching; only created if it is enabled
+    std::unique_ptr<QThreadPool> threadPool;
+    QVector<PatternMatchWorkItem> workItems;
+    if(parallelPatternThreshold > 0){
+        threadPool.reset(new QThreadPool);
+        if(parallelPatternThreadCount > 0){
+            threadPool->setMaxThreadCount(parallelPatternThreadCount);
+        }
+    }
+
+    // ambiguity records for AmbiguityReportMode::Aggregated
+    QList<AmbiguityRecordGroup> ambiguityGroups;
+    QHash<QList<int>, int> ambiguityGroupIndex; // candidate list -> index in ambiguityGroups
+
     // helper function
     // in should be back of textUnit
     auto advance = [&](QStringRef& in, int dist)->bool{
@@ -1528,23 +1564,25 @@ QList<Parser::ParserNodeData> Parser::patternMatch(QVector<QStringRef> &text, Di
         firstNode.parentIndex = -1;
         firstNode.indexWithinParent = 0;
         firstNode.childNodeCount = 0;
+        firstNode.childStart = 0;
         if(root.patterns.empty()){
             // if there is no pattern in root parser node, it is implicitly started
             Q_ASSERT(root.paramName.empty());
+            firstNode.paramStart = session.paramSpans.size();
         }else{
             QHash<QString,QString> values;
             int patternIndex = -1;
             int advanceDist = 0;
             QStringRef& in = textUnits.back();
-            std::tie(patternIndex, advanceDist) = findLongestMatchingPattern(root.patterns, in, values);
+            std::tie(patternIndex, advanceDist) = findLongestMatchingPattern(root.patterns, root.patternOrder, in, values);
 
             if(Q_UNLIKELY(patternIndex == -1)){
                 // cannot start on root
-                return QList<ParserNodeData>();
+                return false;
             }
 
             advance(in, advanceDist);
-            firstNode.params = performValueTransform(root.paramName, values, root.patterns.at(patternIndex).valueTransform);
+            firstNode.paramStart = session.addParameters(performValueTransform(values, root.patterns.at(patternIndex).valueTransform));
         }
         parserNodes.push_back(firstNode);
         currentParentIndex = 0;
@@ -1564,7 +1602,7 @@ QList<Parser::ParserNodeData> Parser::patternMatch(QVector<QStringRef> &text, Di
             int advanceDist = 0;
             QHash<QString,QString> rawValues;
             // try early exit patterns first
-            std::tie(patternIndex, advanceDist) = findLongestMatchingPattern(parent.earlyExitPatterns, in, rawValues);
+            std::tie(patternIndex, advanceDist) = findLongestMatchingPattern(parent.earlyExitPatterns, parent.earlyExitPatternOrder, in, rawValues);
             if(patternIndex >= 0){
                 advance(in, advanceDist);
                 // we found an early exit pattern
@@ -1578,18 +1616,16 @@ QList<Parser::ParserNodeData> Parser::patternMatch(QVector<QStringRef> &text, Di
                 int nodeTypeIndex;
                 int patternIndex;
                 QHash<QString,QString> rawValues;
-                QList<int> implicitParentNodeTypeIndexOnPath; // list of ParserNode with implicit start that lead to this match
+                int implicitPathTail; // last step (index in session.pathPool) of implicitly started ParserNodes that lead to this match; -1 if none
             };
 
             QList<PatternMatchRecord> candidates;
             int farthestAdvanceDist = 0;
             int bestPatternScore = -1;
 
-            auto helper_tryMatchChild = [&](int childParserNodeTypeIndex, const QList<int>& path)->void{
+            // rawValues should contain values from the match of childPatternIndex
+            auto helper_addCandidate = [&](int childParserNodeTypeIndex, int pathTail, int childPatternIndex, int childAdvanceDist)->void{
                 const Node& childNodeTy = nodes.at(childParserNodeTypeIndex);
-                int childPatternIndex = -1;
-                int childAdvanceDist = 0;
-                std::tie(childPatternIndex, childAdvanceDist) = findLongestMatchingPattern(childNodeTy.patterns, in, rawValues);
                 if(childPatternIndex >= 0){
                     // we have a pattern that matches
                     int currentPatternScore = childNodeTy.patterns.at(childPatternIndex).priorityScore;
@@ -1607,15 +1643,27 @@ QList<Parser::ParserNodeData> Parser::patternMatch(QVector<QStringRef> &text, Di
                         record.nodeTypeIndex = childParserNodeTypeIndex;
                         record.patternIndex = childPatternIndex;
                         record.rawValues.swap(rawValues);
-                        record.implicitParentNodeTypeIndexOnPath = path;
+                        record.implicitPathTail = pathTail;
                         candidates.push_back(record);
                     }
                 }
                 rawValues.clear();
             };
+            auto helper_tryMatchChild = [&](int childParserNodeTypeIndex, int pathTail)->void{
+                const Node& childNodeTy = nodes.at(childParserNodeTypeIndex);
+                if(farthestAdvanceDist == in.length() && childNodeTy.maxPatternScore < bestPatternScore){
+                    // current best candidate consumes the entire text unit, and no pattern from this child can be as good as it
+                    return;
+                }
+                int childPatternIndex = -1;
+                int childAdvanceDist = 0;
+                std::tie(childPatternIndex, childAdvanceDist) = findLongestMatchingPattern(childNodeTy.patterns, childNodeTy.patternOrder, in, rawValues);
+                helper_addCandidate(childParserNodeTypeIndex, pathTail, childPatternIndex, childAdvanceDist);
+            };
 
             rawValues.clear();
             int implicitStartChildCount = 0;
+            int directChildPatternCount = 0;
             for(int child : parent.allowedChildNodeIndexList){
                 const Node& childNodeTy = nodes.at(child);
                 if(childNodeTy.patterns.isEmpty()){
@@ -1624,14 +1672,65 @@ QList<Parser::ParserNodeData> Parser::patternMatch(QVector<QStringRef> &text, Di
                     implicitStartChildCount += 1;
                     continue;
                 }
+                directChildPatternCount += childNodeTy.patterns.size();
+            }
+
+            if(threadPool && directChildPatternCount >= parallelPatternThreshold){
+                // split patterns from all direct children into work items and run them on the thread pool
+                // results are reduced in the original order afterwards, so the outcome is identical to serial matching
+                int chunkSize = std::max(1, directChildPatternCount / (threadPool->maxThreadCount() * 4));
+                workItems.resize(0);
+                for(int child : parent.allowedChildNodeIndexList){
+                    int numPattern = nodes.at(child).patterns.size();
+                    for(int first = 0; first < numPattern; first += chunkSize){
+                        PatternMatchWorkItem item;
+                        item.nodeTypeIndex = child;
+                        item.first = first;
+                        item.last = std::min(numPattern, first + chunkSize);
+                        item.patternIndex = -1;
+                        item.advanceDist = 0;
+                        workItems.push_back(item);
+                    }
+                }
+                QStringRef text = in;
+                runPatternMatchWorkItems(*threadPool, workItems, text);
 
-                helper_tryMatchChild(child, QList<int>());
+                for(int itemIndex = 0, numItem = workItems.size(); itemIndex < numItem;){
+                    // reduce all items from the same child with the same rule as findLongestMatchingPattern()
+                    int child = workItems.at(itemIndex).nodeTypeIndex;
+                    const Node& childNodeTy = nodes.at(child);
+                    int childPatternIndex = -1;
+                    int childAdvanceDist = 0;
+                    int childPatternScore = -1;
+                    for(; itemIndex < numItem && workItems.at(itemIndex).nodeTypeIndex == child; ++itemIndex){
+                        PatternMatchWorkItem& item = workItems[itemIndex];
+                        if(item.patternIndex < 0)
+                            continue;
+                        int score = childNodeTy.patterns.at(item.patternIndex).priorityScore;
+                        if(item.advanceDist > childAdvanceDist || (item.advanceDist == childAdvanceDist && score > childPatternScore)){
+                            childPatternIndex = item.patternIndex;
+                            childAdvanceDist = item.advanceDist;
+                            childPatternScore = score;
+                            rawValues.swap(item.rawValues);
+                        }
+                    }
+                    helper_addCandidate(child, -1, childPatternIndex, childAdvanceDist);
+                }
+            }else{
+                for(int child : parent.allowedChildNodeIndexList){
+                    if(nodes.at(child).patterns.isEmpty())
+                        continue;
+
+                    helper_tryMatchChild(child, -1);
+                }
             }
 
             if(candidates.isEmpty() && implicitStartChildCount > 1){
                 // check childs that may start implicitly
-                QQueue<QList<int>> pathQueue;
-                pathQueue.reserve(implicitStartChildCount);
+                // each path is a chain of PathEntry in session.pathPool; the queue holds the index of last step in each path
+                // paths from previous positions are not referenced anymore, so the pool can be reused
+                session.pathPool.resize(0);
+                pathQueue.resize(0);
                 for(int child : parent.allowedChildNodeIndexList){
                     // skip those we already exited from
                     if(implicitStartIgnoreTypeSet.contains(child))
@@ -1639,12 +1738,13 @@ QList<Parser::ParserNodeData> Parser::patternMatch(QVector<QStringRef> &text, Di
 
                     const Node& childNodeTy = nodes.at(child);
                     if(childNodeTy.patterns.isEmpty() && !childNodeTy.allowedChildNodeIndexList.isEmpty()){
-                        pathQueue.enqueue(QList<int>({child}));
+                        pathQueue.push_back(session.pathPool.size());
+                        session.pathPool.push_back(ParseSession::PathEntry{-1, child});
                     }
                 }
-                while(!pathQueue.isEmpty()){
-                    // WARNING: pathQueue.head() is not safe to "cache" since enqueue can invalidate old one
-                    int tailParserNodeTypeIndex = pathQueue.head().back();
+                for(int queueHead = 0; queueHead < pathQueue.size(); ++queueHead){
+                    int pathTail = pathQueue.at(queueHead);
+                    int tailParserNodeTypeIndex = session.pathPool.at(pathTail).nodeTypeIndex;
                     const Node& ty = nodes.at(tailParserNodeTypeIndex);
                     // go through all its child
                     // if a child has patterns (not implicit start), try these patterns
@@ -1656,14 +1756,12 @@ QList<Parser::ParserNodeData> Parser::patternMatch(QVector<QStringRef> &text, Di
                         const Node& childNodeTy = nodes.at(child);
                         if(childNodeTy.patterns.isEmpty()){
                             Q_ASSERT(childNodeTy.paramName.empty());
-                            QList<int> newPath(pathQueue.head());
-                            newPath.push_back(child);
-                            pathQueue.enqueue(newPath);
+                            pathQueue.push_back(session.pathPool.size());
+                            session.pathPool.push_back(ParseSession::PathEntry{pathTail, child});
                         }else{
-                            helper_tryMatchChild(child, pathQueue.head());
+                            helper_tryMatchChild(child, pathTail);
                         }
                     }
-                    pathQueue.dequeue();
                 }
             }
 
@@ -1679,36 +1777,64 @@ QList<Parser::ParserNodeData> Parser::patternMatch(QVector<QStringRef> &text, Di
                 if(Q_UNLIKELY(candidates.size() > 1)){
                     // ambiguous scenario; we will just select the first pattern
                     // report a warning though
-                    QList<QVariant> errorArgs;
-                    QStringRef ambiguousText = in.left(farthestAdvanceDist);
-                    context.removeTrailingIgnoredString(ambiguousText);
-                    errorArgs.push_back(ambiguousText.toString());
-                    for(const auto& data: candidates){
-                        QVariantList vlist; // [NodeName][NodeParamStringList][PatternIndex]
-                        const Node& childNodeTy = nodes.at(data.nodeTypeIndex);
-                        vlist.push_back(childNodeTy.nodeName);
-                        QStringList params = performValueTransform(
-                                    childNodeTy.paramName,
-                                    data.rawValues,
-                                    childNodeTy.patterns.at(data.patternIndex).valueTransform);
-                        vlist.push_back(params);
-                        vlist.push_back(data.patternIndex);
-                        errorArgs.push_back(vlist);
+                    if(ambiguityReportMode == AmbiguityReportMode::Aggregated){
+                        // only record which candidates are involved; values are computed when reporting samples
+                        QList<int> key;
+                        key.reserve(candidates.size() * 2);
+                        for(const auto& data: candidates){
+                            key.push_back(data.nodeTypeIndex);
+                            key.push_back(data.patternIndex);
+                        }
+                        auto iter = ambiguityGroupIndex.find(key);
+                        if(iter == ambiguityGroupIndex.end()){
+                            iter = ambiguityGroupIndex.insert(key, ambiguityGroups.size());
+                            AmbiguityRecordGroup group;
+                            group.candidates = key;
+                            ambiguityGroups.push_back(group);
+                        }
+                        AmbiguityRecordGroup& group = ambiguityGroups[iter.value()];
+                        group.occurrenceCount += 1;
+                        if(group.sampleInput.size() < ambiguitySampleCount){
+                            group.sampleInput.push_back(in);
+                            group.sampleLength.push_back(farthestAdvanceDist);
+                        }
+                    }else{
+                        QList<QVariant> errorArgs;
+                        QStringRef ambiguousText = in.left(farthestAdvanceDist);
+                        context.removeTrailingIgnoredString(ambiguousText);
+                        errorArgs.push_back(ambiguousText.toString());
+                        for(const auto& data: candidates){
+                            QVariantList vlist; // [NodeName][NodeParamStringList][PatternIndex]
+                            const Node& childNodeTy = nodes.at(data.nodeTypeIndex);
+                            vlist.push_back(childNodeTy.nodeName);
+                            QStringList params = performValueTransform(
+                                        data.rawValues,
+                                        childNodeTy.patterns.at(data.patternIndex).valueTransform);
+                            vlist.push_back(params);
+                            vlist.push_back(data.patternIndex);
+                            errorArgs.push_back(vlist);
+                        }
+                        diagnostic.handle(Diag::Warn_Parser_Matching_Ambiguous, errorArgs);
                     }
-                    diagnostic.handle(Diag::Warn_Parser_Matching_Ambiguous, errorArgs);
                 }
 
                 // at least one match; pick the first
                 const PatternMatchRecord& record = candidates.front();
 
                 // if there are implicitly started nodes, create them first
-                for(int nodeOnPath : record.implicitParentNodeTypeIndexOnPath){
+                // the path is stored from tail to head, so we walk it backward
+                implicitPath.resize(0);
+                for(int step = record.implicitPathTail; step >= 0; step = session.pathPool.at(step).prev){
+                    implicitPath.push_back(session.pathPool.at(step).nodeTypeIndex);
+                }
+                for(int i = implicitPath.size()-1; i >= 0; --i){
                     ParserNodeData intermediateNodeData;
                     intermediateNodeData.parentIndex = parentIndex;
-                    intermediateNodeData.nodeTypeIndex = nodeOnPath;
+                    intermediateNodeData.nodeTypeIndex = implicitPath.at(i);
                     intermediateNodeData.indexWithinParent = parserNodes[parentIndex].childNodeCount++;
                     intermediateNodeData.childNodeCount = 0;
-                    intermediateNodeData.params.clear();// implicitly started node won't have parameters
+                    intermediateNodeData.paramStart = session.paramSpans.size();// implicitly started node won't have parameters
+                    intermediateNodeData.childStart = 0;
                     parentIndex = parserNodes.size();
                     parserNodes.push_back(intermediateNodeData);
                 }
@@ -1720,10 +1846,10 @@ QList<Parser::ParserNodeData> Parser::patternMatch(QVector<QStringRef> &text, Di
                 endData.nodeTypeIndex = record.nodeTypeIndex;
                 endData.indexWithinParent = parserNodes[parentIndex].childNodeCount++;
                 endData.childNodeCount = 0;
-                endData.params = performValueTransform(
-                            childNodeTy.paramName,
+                endData.childStart = 0;
+                endData.paramStart = session.addParameters(performValueTransform(
                             record.rawValues,
-                            childNodeTy.patterns.at(record.patternIndex).valueTransform);
+                            childNodeTy.patterns.at(record.patternIndex).valueTransform));
                 if(childNodeTy.allowedChildNodeIndexList.isEmpty()){
                     // leaf node; no change on parent
                     currentParentIndex = parentIndex;
@@ -1742,8 +1868,9 @@ QList<Parser::ParserNodeData> Parser::patternMatch(QVector<QStringRef> &text, Di
         // if we reach here, it means that we reached the root and no patterns can be applied so far
         Q_ASSERT(parentIndex == -1);
         Q_ASSERT(!textUnits.isEmpty());
+        reportAggregatedAmbiguity(ambiguityGroups, diagnostic);
         diagnostic(Diag::Error_Parser_Matching_NoMatch);
-        return QList<ParserNodeData>();
+        return false;
     }
 
     // if we reach here, it either means that all texts are consumed, or an early exit pattern of root is found
@@ -1755,17 +1882,58 @@ QList<Parser::ParserNodeData> Parser::patternMatch(QVector<QStringRef> &text, Di
         }else{
             if(!in.isEmpty()){
                 // garbage at the end
+                reportAggregatedAmbiguity(ambiguityGroups, diagnostic);
                 diagnostic(Diag::Error_Parser_Matching_GarbageAtEnd);
-                return QList<ParserNodeData>();
+                return false;
             }
         }
     }
 
     // now all the text are successfully consumed
-    return parserNodes;
+    reportAggregatedAmbiguity(ambiguityGroups, diagnostic);
+    session.finalizeChildList();
+    return true;
 }
 
-std::pair<bool,QString> Parser::IRBuildContext::solveExternReference(const Parser& p, const PatternValueSubExpression::ExternReferenceData &expr, int nodeIndex)
+void Parser::reportAggregatedAmbiguity(const QList<AmbiguityRecordGroup>& groups, DiagnosticEmitterBase& diagnostic) const
+{
+    for(const auto& group : groups){
+        QList<QVariant> summaryArgs;
+        summaryArgs.push_back(group.occurrenceCount);
+        summaryArgs.push_back(group.sampleInput.size());
+        for(int i = 0, n = group.candidates.size(); i < n; i += 2){
+            QVariantList vlist; // [NodeName][PatternIndex]
+            vlist.push_back(nodes.at(group.candidates.at(i)).nodeName);
+            vlist.push_back(group.candidates.at(i+1));
+            summaryArgs.push_back(vlist);
+        }
+        diagnostic.handle(Diag::Warn_Parser_Matching_AmbiguousSummary, summaryArgs);
+
+        // only samples get their values computed; match() is deterministic so re-matching gives the same raw values
+        for(int sampleIndex = 0, numSample = group.sampleInput.size(); sampleIndex < numSample; ++sampleIndex){
+            QStringRef sampleInput = group.sampleInput.at(sampleIndex);
+            QList<QVariant> errorArgs;
+            QStringRef ambiguousText = sampleInput.left(group.sampleLength.at(sampleIndex));
+            context.removeTrailingIgnoredString(ambiguousText);
+            errorArgs.push_back(ambiguousText.toString());
+            for(int i = 0, n = group.candidates.size(); i < n; i += 2){
+                const Node& childNodeTy = nodes.at(group.candidates.at(i));
+                int patternIndex = group.candidates.at(i+1);
+                const Pattern& pattern = childNodeTy.patterns.at(patternIndex);
+                QHash<QString,QString> rawValues;
+                match(sampleInput, rawValues, context, pattern.elements);
+                QVariantList vlist; // [NodeName][NodeParamStringList][PatternIndex]
+                vlist.push_back(childNodeTy.nodeName);
+                vlist.push_back(performValueTransform(rawValues, pattern.valueTransform));
+                vlist.push_back(patternIndex);
+                errorArgs.push_back(vlist);
+            }
+            diagnostic.handle(Diag::Warn_Parser_Matching_Ambiguous, errorArgs);
+        }
+    }
+}
+
+std::pair<bool,QString> Parser::ParseSession::solveExternReference(const Parser& p, const PatternValueSubExpression::ExternReferenceData &expr, int nodeIndex)
 {
     std::pair<bool,QString> fail(false, QString());
     int currentNodeIndex = nodeIndex;
@@ -1787,7 +1955,7 @@ std::pair<bool,QString> Parser::IRBuildContext::solveExternReference(const Parse
         const Node& curNodeTy = p.nodes.at(curNode.nodeTypeIndex);
         if(step.ty == PatternValueSubExpression::ExternReferenceData::NodeTraverseStep::StepType::AnyChildByOrder){
             // get the list of candidate nodes
-            const QList<int>& children = getNodeChildList(currentNodeIndex, -1);
+            ChildList children = getNodeChildList(currentNodeIndex, -1);
             int childIndex = step.ioSearchData.lookupNum;
             if(!step.ioSearchData.isNumIndexInsteadofOffset){
                 // offset based search
@@ -1817,7 +1985,7 @@ std::pair<bool,QString> Parser::IRBuildContext::solveExternReference(const Parse
         }
 
         // get the list of candidate nodes
-        const QList<int>& children = getNodeChildList(currentNodeIndex, childTypeIndex);
+        ChildList children = getNodeChildList(currentNodeIndex, childTypeIndex);
 
         if(step.ty == PatternValueSubExpression::ExternReferenceData::NodeTraverseStep::StepType::ChildByTypeFromLookup){
             const Node& childTy = p.nodes.at(childTypeIndex);
@@ -1833,15 +2001,13 @@ std::pair<bool,QString> Parser::IRBuildContext::solveExternReference(const Parse
             int startIndex = children.size() - 1;
             if(curNode.parentIndex == parserNodes.at(nodeIndex).parentIndex){
                 // find the first child node in given type that is either before or is current node
-                auto iter = std::upper_bound(children.begin(), children.end(), nodeIndex);
-                startIndex = static_cast<int>(std::distance(children.begin(), iter))-1;
+                startIndex = children.upperBound(nodeIndex)-1;
             }
 
             bool isFound = false;
             for(int i = startIndex; i >= 0; --i){
                 int child = children.at(i);
-                const ParserNodeData& curChild = parserNodes.at(child);
-                if(curChild.params.at(paramIndex) == step.kvSearchData.value){
+                if(getParameter(child, paramIndex) == step.kvSearchData.value){
                     currentNodeIndex = child;
                     isFound = true;
                     break;
@@ -1853,8 +2019,7 @@ std::pair<bool,QString> Parser::IRBuildContext::solveExternReference(const Parse
             // search from the startIndex downward
             for(int i = startIndex+1; i < children.size(); ++i){
                 int child = children.at(i);
-                const ParserNodeData& curChild = parserNodes.at(child);
-                if(curChild.params.at(paramIndex) == step.kvSearchData.value){
+                if(getParameter(child, paramIndex) == step.kvSearchData.value){
                     currentNodeIndex = child;
                     isFound = true;
                     break;
@@ -1868,8 +2033,7 @@ std::pair<bool,QString> Parser::IRBuildContext::solveExternReference(const Parse
             int childIndex = step.ioSearchData.lookupNum;
             if(!step.ioSearchData.isNumIndexInsteadofOffset){
                 // offset based search
-                auto iter = std::upper_bound(children.begin(), children.end(), nodeIndex);
-                int baseIndex = static_cast<int>(std::distance(children.begin(), iter))-1;
+                int baseIndex = children.upperBound(nodeIndex)-1;
                 childIndex += baseIndex;
             }
             if(childIndex < 0 || childIndex >= children.size()){
@@ -1888,275 +2052,132 @@ std::pair<bool,QString> Parser::IRBuildContext::solveExternReference(const Parse
         // no such member under the node
         return fail;
     }
-    Q_ASSERT(paramIndex < data.params.size());
-    return std::make_pair(true, data.params.at(paramIndex));
-#if 0
-    int splitterIndex = expr.indexOf(QChar(':'));
-    if(splitterIndex == -1){
-        return fail;
-    }
-    if((splitterIndex == expr.length()-1) || expr.at(splitterIndex+1) != ':'){
-        // just a single ':', malformed expression
-        return fail;
-    }
-
-    QStringRef paramName = expr.midRef(splitterIndex+2);
-    QStringRef nodeExpr = expr.leftRef(splitterIndex);
-
-    QVector<QStringRef> steps = nodeExpr.split('/');
-    int currentNodeIndex = nodeIndex;
-    for(QStringRef step : steps){
-        // skip empty parts
-        if(step.isEmpty() || step == ".")
-            continue;
-
-        const ParserNodeData& curNode = parserNodes.at(currentNodeIndex);
-        if(step == ".."){
-            // do not go before root (doing .. on root evaluates to root itself)
-            if(currentNodeIndex > 0){
-                currentNodeIndex = curNode.parentIndex;
-            }
-        }else{
-            int childTypeIndex = -1;
-            int childIndex = -1;
-
-            QStringRef childName;
-            QStringRef enclosedExpr;
-            int exprStart = step.indexOf(QChar('['));
-            if(exprStart == -1){
-                childName = step;
-            }else{
-                // either [<IndexExpr>] or <ChildName>[<LookupExpr>] expected
-                if(step.back() != ']'){
-                    // malformed expression
-                    return fail;
-                }
-                childName = step.left(exprStart);
-                enclosedExpr = step.mid(exprStart+1).chopped(1);// skip []
-            }
-
-            const Node& curNodeTy = p.nodes.at(curNode.nodeTypeIndex);
-
-            if(!childName.isEmpty()){
-                // get the childTypeIndex by searching through names
-                for(int child : curNodeTy.allowedChildNodeIndexList){
-                    const Node& curChild = p.nodes.at(child);
-                    if(curChild.nodeName == childName){
-                        childTypeIndex = child;
-                        break;
-                    }
-                }
-                if(childTypeIndex == -1){
-                    // no such child found; error
-                    return fail;
-                }
-            }
-
-            // perform index based search
-            bool isIndexBasedSearch = false;
-            bool isPeerNodeAccess = false;
-            if(enclosedExpr.isEmpty()){
-                isIndexBasedSearch = true;
-                childIndex = 0;
-            }else{
-                // it is not a key based search if everything in enclosedExpr is a valid integer
-                bool isGood = false;
-                childIndex = enclosedExpr.toInt(&isGood);
-                if(isGood){
-                    isIndexBasedSearch = true;
-                    if(enclosedExpr.front() == '+' || enclosedExpr.front() == '-'){
-                        // offset based index expression; childIndex is not the final value
-                        if(childTypeIndex != -1){
-                            // there is a child node type specified
-                            // only allowed when we access peers
-                            if(currentNodeIndex == parserNodes.at(nodeIndex).parentIndex){
-                                isPeerNodeAccess = true;
-                            }else{
-                                return fail;
-                            }
-                        }else{
-                            // no child node type specified
-                            // get the "cooked" index now
-                            childIndex += parserNodes.at(nodeIndex).indexWithinParent;
-                        }
-                    }
-                }
-            }
-
-            // get the list of candidate nodes
-            const QList<int>& children = getNodeChildList(currentNodeIndex, childTypeIndex);
-
-            if(isPeerNodeAccess){
-                // find the first child node in given type that is either before or is current node
-                auto iter = std::upper_bound(children.begin(), children.end(), nodeIndex);
-                int baseIndex = static_cast<int>(std::distance(children.begin(), iter)) - 1;
-                // fix-up the final index
-                childIndex += baseIndex;
-            }
+    return std::make_pair(true, getParameter(currentNodeIndex, paramIndex).toString());
+}
 
-            if(isIndexBasedSearch){
-                if(childIndex < 0 || childIndex >= children.size()){
-                    // out of bound; bad index
-                    return fail;
-                }
-                currentNodeIndex = children.at(childIndex);
-                continue;
-            }
+void Parser::ParseSession::reserve(int numTextUnit, int totalTextLength)
+{
+    // parameters are extracted from text; in most case they do not take more space than the text itself
+    parserNodes.reserve(numTextUnit);
+    paramSpans.reserve(numTextUnit);
+    paramPool.reserve(totalTextLength);
+}
 
-            // key based search
-            // extract the key and value field first
-            int equalSignIndex = enclosedExpr.indexOf(QChar('='));
-            if(equalSignIndex == -1){
-                // no equal sign found; malformed LookupExor
-                return fail;
-            }
-            if(equalSignIndex+2 >= enclosedExpr.size() || enclosedExpr.at(equalSignIndex+1) != '='){
-                // it is not a "==" or there is nothing after "=="; malformed LookupExor
-                return fail;
-            }
-            QStringRef lookupKey = enclosedExpr.left(equalSignIndex);
-            QStringRef lookupValue = enclosedExpr.mid(equalSignIndex+2);
-            // for now we require lookupValue to be a '"' enclosed string literal
-            if(!(lookupValue.startsWith('"') && lookupValue.endsWith('"'))){
-                // malformed
-                return fail;
-            }
-            // remove the quote
-            lookupValue = lookupValue.mid(1);
-            lookupValue.chop(1);
-            // get the parameter index from the lookupKey
-            const Node& childNodeTy = p.nodes.at(childIndex);
-            int paramIndex = -1;
-            for(int i = 0, n = childNodeTy.paramName.size(); i < n; ++i){
-                if(childNodeTy.paramName.at(i) == lookupKey){
-                    paramIndex = i;
-                    break;
-                }
-            }
-            if(paramIndex == -1){
-                // no parameter with specified name found; fail
-                return fail;
-            }
-            int currentCandidate = -1;
-            for(int child : children){
-                const ParserNodeData& childData = parserNodes.at(child);
-                if(childData.params.at(paramIndex) == lookupValue){
-                    if(currentCandidate == -1){
-                        currentCandidate = child;
-                    }else{
-                        // duplicated search result; fail
-                        return fail;
-                    }
-                }
-            }
-            currentNodeIndex = currentCandidate;
-            continue;
-        }
+int Parser::ParseSession::addParameters(const QStringList& params)
+{
+    int paramStart = paramSpans.size();
+    for(const QString& str : params){
+        paramSpans.push_back(StringSpan{paramPool.size(), str.size()});
+        paramPool.append(str);
     }
+    return paramStart;
+}
 
-    // node traversal complete; read the value and done
-    const ParserNodeData& nodeData = parserNodes.at(currentNodeIndex);
-    const Node& nodeTy = p.nodes.at(nodeData.nodeTypeIndex);
-    for(int i = 0, n = nodeTy.paramName.size(); i < n; ++i){
-        if(nodeTy.paramName.at(i) == paramName){
-            return std::make_pair(true, nodeData.params.at(i));
-        }
+void Parser::ParseSession::finalizeChildList()
+{
+    // parser nodes are in pre-order, so visiting them in order appends children of each parent in order
+    int numNode = parserNodes.size();
+    int childStart = 0;
+    for(auto& d : parserNodes){
+        d.childStart = childStart;
+        childStart += d.childNodeCount;
     }
+    Q_ASSERT(numNode == 0 || childStart == numNode-1);
+    childIndexPool.resize(childStart);
+    for(int curNodeIndex = 1; curNodeIndex < numNode; ++curNodeIndex){
+        const auto& d = parserNodes.at(curNodeIndex);
+        const auto& parent = parserNodes.at(d.parentIndex);
+        childIndexPool[parent.childStart + d.indexWithinParent] = curNodeIndex;
+    }
+}
 
-    // no parameter with given name found
-    return fail;
-#endif
+int Parser::ParseSession::ChildList::upperBound(int nodeIndex) const
+{
+    auto begin = pool->constBegin() + start;
+    auto iter = std::upper_bound(begin, begin + count, nodeIndex);
+    return static_cast<int>(std::distance(begin, iter));
 }
 
-const QList<int>& Parser::IRBuildContext::getNodeChildList(int parentIndex, int childNodeTypeIndex)
+Parser::ParseSession::ChildList Parser::ParseSession::getNodeChildList(int parentIndex, int childNodeTypeIndex)
 {
-    auto& nodeCache = parserNodeChildListCache[parentIndex];
-    {
-        auto iter = nodeCache.find(childNodeTypeIndex);
-        if(iter != nodeCache.end())
-            return iter.value();
+    const ParserNodeData& parent = parserNodes.at(parentIndex);
+    if(childNodeTypeIndex == -1){
+        return ChildList{&childIndexPool, parent.childStart, parent.childNodeCount};
     }
-    // okay, it is not in cache
-    // let's compute it
-
-    if(nodeCache.empty()){
-        // we have not yet built any list
-        // let's prepare the list of all child nodes at the same time
-        QList<int> allChildList;
-        QList<int> wantedChildList;
-        // we go through all ParserNodes after the node specified by parentIndex:
-        // 1. If a node's parent index is smaller than parentIndex, it means that we already went outside the subtree under parent
-        //    and allChildList is already complete
-        // 2. If a node's parent index is equal to parentIndex, add it to allChildList since it is a direct child
-        // 3. If a node's parent index is larger than parentIndex, it is an indirect child
-        for(int curNodeIndex = parentIndex+1, numNode = parserNodes.size(); curNodeIndex < numNode; ++curNodeIndex){
-            const auto& d = parserNodes.at(curNodeIndex);
-            if(d.parentIndex == parentIndex){
-                allChildList.push_back(curNodeIndex);
-
-                // if we also looks for child with specific type, we add them here
-                if(childNodeTypeIndex != -1 && d.nodeTypeIndex == childNodeTypeIndex){
-                    wantedChildList.push_back(curNodeIndex);
-                }
-            }else if(d.parentIndex < parentIndex){
-                break;
-            }
-        }
-        nodeCache.insert(-1, allChildList);
-        if(childNodeTypeIndex != -1){
-            nodeCache.insert(childNodeTypeIndex, wantedChildList);
-        }
-        // we may have childNodeTypeIndex == -1 here
-        return nodeCache[childNodeTypeIndex];
-    }else{
-        // we already have the list of all children
+
+    quint64 key = (static_cast<quint64>(parentIndex) << 32) | static_cast<quint32>(childNodeTypeIndex);
+    auto iter = typedChildRangeCache.find(key);
+    if(iter == typedChildRangeCache.end()){
         // build the wanted list from the list of all direct childs
-        Q_ASSERT(childNodeTypeIndex != -1);
-        auto iter_allChild = nodeCache.find(-1);
-        Q_ASSERT(iter_allChild != nodeCache.end());
-        QList<int> wantedChildList;
-        for(int child: iter_allChild.value()){
-            const auto& d = parserNodes.at(child);
-            if(d.nodeTypeIndex == childNodeTypeIndex){
-                wantedChildList.push_back(child);
+        IndexRange range{typedChildPool.size(), 0};
+        for(int i = parent.childStart, n = parent.childStart + parent.childNodeCount; i < n; ++i){
+            int child = childIndexPool.at(i);
+            if(parserNodes.at(child).nodeTypeIndex == childNodeTypeIndex){
+                typedChildPool.push_back(child);
+                range.count += 1;
             }
         }
-        return nodeCache.insert(childNodeTypeIndex, wantedChildList).value();
+        iter = typedChildRangeCache.insert(key, range);
     }
+    return ChildList{&typedChildPool, iter.value().start, iter.value().count};
+}
+
+Parser::SessionMemoryUsage Parser::ParseSession::getMemoryUsage() const
+{
+    SessionMemoryUsage usage;
+    usage.parserNodes = MemoryUsage::ofVector(parserNodes);
+    usage.parameters = MemoryUsage::ofString(paramPool) + MemoryUsage::ofVector(paramSpans);
+    usage.pathPool = MemoryUsage::ofVector(pathPool);
+    usage.childLists = MemoryUsage::ofVector(childIndexPool)
+                     + MemoryUsage::ofVector(typedChildPool)
+                     + MemoryUsage::ofHash(typedChildRangeCache);
+    return usage;
 }
 
-IRRootInstance* Parser::parse(QVector<QStringRef> &text, const IRRootType& ir, DiagnosticEmitterBase& diagnostic) const
+IRRootInstance* Parser::parse(QVector<QStringRef> &text, const IRRootType& ir, DiagnosticEmitterBase& diagnostic, SessionMemoryUsage* sessionUsage) const
 {
-    IRBuildContext ctx;
-    ctx.parserNodes = patternMatch(text, diagnostic);
-    if(ctx.parserNodes.empty())
+    ParseSession ctx;
+    // report usage on every return path; containers in the session never shrink, so this is its peak
+    struct SessionUsageReporter{
+        const ParseSession& session;
+        SessionMemoryUsage* dest;
+        ~SessionUsageReporter(){
+            if(dest){
+                *dest = session.getMemoryUsage();
+            }
+        }
+    } usageReporter{ctx, sessionUsage};
+    {
+        int totalTextLength = 0;
+        for(const auto& unit : text){
+            totalTextLength += unit.length();
+        }
+        ctx.reserve(text.size(), totalTextLength);
+    }
+    if(!patternMatch(ctx, text, diagnostic))
         return nullptr;
 
     // start to build IR tree
-    std::unique_ptr<IRRootInstance> ptr(new IRRootInstance(ir));
+    // parser nodes map to at most one IR node each
+    IRBuilder builder(ir, ctx.parserNodes.size());
     // root node to root node
     const ParserNodeData& rootData = ctx.parserNodes.front();
     const Node& rootNodeTy = nodes.at(rootData.nodeTypeIndex);
 
     auto helper_buildIRNode = [&](int parserNodeIndex, int irNodeTypeIndex, int parentIRNodeIndex)->int{
-        const IRNodeType& irNodeTy = ptr->getType().getNodeType(irNodeTypeIndex);
+        const IRNodeType& irNodeTy = ir.getNodeType(irNodeTypeIndex);
 
         // step 1: insert node
-        int irNodeIndex = ptr->addNode(irNodeTypeIndex);
-        auto& node = ptr->getNode(irNodeIndex);
-        node.setParent(parentIRNodeIndex);
-        if(parentIRNodeIndex != -1){
-            ptr->getNode(parentIRNodeIndex).addChildNode(irNodeIndex);
-        }
+        int irNodeIndex = builder.addNode(irNodeTypeIndex, parentIRNodeIndex);
+        Q_ASSERT(irNodeIndex >= 0);
 
         // step 2: prepare value transform
-        QList<QVariant> params;
         const ParserNodeData& nodeData = ctx.parserNodes.at(parserNodeIndex);
         const Node& nodeTy = nodes.at(nodeData.nodeTypeIndex);
         Q_ASSERT(nodeTy.combineValueTransform.empty() || nodeTy.combineValueTransform.size() == irNodeTy.getNumParameter());
         QHash<QString,QString> nodeStrData;
         for(int i = 0, n = nodeTy.paramName.size(); i < n; ++i){
-            nodeStrData.insert(nodeTy.paramName.at(i), nodeData.params.at(i));
+            nodeStrData.insert(nodeTy.paramName.at(i), ctx.getParameter(parserNodeIndex, i).toString());
         }
         for(int i = 0, n = irNodeTy.getNumParameter(); i < n; ++i){
             QString value;
@@ -2165,13 +2186,13 @@ IRRootInstance* Parser::parse(QVector<QStringRef> &text, const IRRootType& ir, D
                 // search for ParserNode parameter with the same name
                 // use it as the final value
                 int idx = nodeTy.paramName.indexOf(irParamName);
-                value = nodeData.params.at(idx);
+                value = ctx.getParameter(parserNodeIndex, idx).toString();
             }else{
                 const auto& exprList = nodeTy.combineValueTransform.at(i);
                 bool isAnyExprGood = false;
                 for(const auto& expr : exprList){
                     bool isExprGood = true;
-                    value = performValueTransform(irParamName, nodeStrData, expr, [&](const PatternValueSubExpression::ExternReferenceData& e)->QString{
+                    value = performValueTransform(nodeStrData, expr, [&](const PatternValueSubExpression::ExternReferenceData& e)->QString{
                         QString retVal;
                         bool isThisOneGood = true;
                         std::tie(isThisOneGood, retVal) = ctx.solveExternReference(*this, e, parserNodeIndex);
@@ -2188,27 +2209,24 @@ IRRootInstance* Parser::parse(QVector<QStringRef> &text, const IRRootType& ir, D
                     return -1;
                 }
             }
-            // cast value to IR type
-            QVariant irValue;
+            // cast value to IR type and write it to typed storage
             ValueType irValTy = irNodeTy.getParameterType(i);
             switch(irValTy){
             default: Q_UNREACHABLE(); break;
             case ValueType::String:{
-                irValue = value;
+                builder.setParameter(irNodeIndex, i, value);
             }break;
             case ValueType::Int64:{
                 bool isGood = true;
-                irValue.setValue(value.toLongLong(&isGood));
+                qint64 irValue = value.toLongLong(&isGood);
                 if(!isGood){
                     diagnostic(Diag::Error_Parser_IRBuild_BadCast, nodeTy.nodeName, irNodeTy.getName(), irParamName, irValTy, value);
                     return -1;
                 }
+                builder.setParameter(irNodeIndex, i, irValue);
             }break;
             }
-
-            params.push_back(irValue);
         }
-        node.setParameters(params);
 
         return irNodeIndex;
     };
@@ -2253,6 +2271,7 @@ IRRootInstance* Parser::parse(QVector<QStringRef> &text, const IRRootType& ir, D
         parentStack.push_back(NodeIndexRecord{parserNodeIndex, irNodeIndex});
     }
 
+    std::unique_ptr<IRRootInstance> ptr(builder.finish());
     if(ptr->validate(diagnostic)){
         return ptr.release();
     }
@@ -2261,19 +2280,75 @@ IRRootInstance* Parser::parse(QVector<QStringRef> &text, const IRRootType& ir, D
     return nullptr;
 }
 
-std::pair<int,int> Parser::findLongestMatchingPattern(const QList<Pattern>& patterns, QStringRef text, QHash<QString,QString>& values) const
+namespace{
+class PatternMatchRunnable : public QRunnable
 {
+public:
+    explicit PatternMatchRunnable(std::function<void()> func): func(func){}
+    void run() override {func();}
+private:
+    std::function<void()> func;
+};
+} // anonymous namespace
+
+void Parser::runPatternMatchWorkItems(QThreadPool& pool, QVector<PatternMatchWorkItem>& items, QStringRef text) const
+{
+    auto processItem = [this, &items, text](int itemIndex)->void{
+        PatternMatchWorkItem& item = items[itemIndex];
+        const Node& node = nodes.at(item.nodeTypeIndex);
+        std::tie(item.patternIndex, item.advanceDist) = findLongestMatchingPattern(
+                    node.patterns, node.patternOrder, text, item.rawValues, item.first, item.last);
+    };
+
+    // work items are distributed in an interleaved way; the current thread also takes one share
+    int numShare = std::min(items.size(), pool.maxThreadCount() + 1);
+    auto processShare = [&items, numShare, processItem](int shareIndex)->void{
+        for(int i = shareIndex, n = items.size(); i < n; i += numShare){
+            processItem(i);
+        }
+    };
+    for(int shareIndex = 1; shareIndex < numShare; ++shareIndex){
+        pool.start(new PatternMatchRunnable([processShare, shareIndex](){processShare(shareIndex);}));
+    }
+    processShare(0);
+    pool.waitForDone();
+}
+
+QVector<int> Parser::getPatternOrder(const QList<Pattern>& patterns)
+{
+    QVector<int> order;
+    order.reserve(patterns.size());
+    for(int i = 0, n = patterns.size(); i < n; ++i){
+        order.push_back(i);
+    }
+    std::stable_sort(order.begin(), order.end(), [&patterns](int lhs, int rhs)->bool{
+        return patterns.at(lhs).priorityScore > patterns.at(rhs).priorityScore;
+    });
+    return order;
+}
+
+std::pair<int,int> Parser::findLongestMatchingPattern(const QList<Pattern>& patterns, const QVector<int>& order, QStringRef text, QHash<QString,QString>& values, int first, int last) const
+{
+    Q_ASSERT(order.size() == patterns.size());
     int bestPatternIndex = -1;
     int bestPatternScore = -1;
     int numConsumed = 0;
     QHash<QString, QString> curRawValue;
 
-    for(int i = 0, num = patterns.size(); i < num; ++i){
-        int curConsumeCount = match(text, curRawValue, context, patterns.at(i).elements);
+    // because patterns are tried with descending score and a pattern with the same score and length is not preferred over earlier ones,
+    // once a pattern consumes the entire text, nothing after it can be chosen.
+    // the result is the same as trying all patterns in original order
+    if(last < 0){
+        last = order.size();
+    }
+    for(int i = first; i < last && numConsumed < text.length(); ++i){
+        int patternIndex = order.at(i);
+        const Pattern& pattern = patterns.at(patternIndex);
+        int curConsumeCount = match(text, curRawValue, context, pattern.elements);
         if(curConsumeCount > 0){
-            if(curConsumeCount > numConsumed || (curConsumeCount == numConsumed && patterns.at(i).priorityScore > bestPatternScore)){
-                bestPatternIndex = i;
-                bestPatternScore = patterns.at(i).priorityScore;
+            if(curConsumeCount > numConsumed || (curConsumeCount == numConsumed && pattern.priorityScore > bestPatternScore)){
+                bestPatternIndex = patternIndex;
+                bestPatternScore = pattern.priorityScore;
                 numConsumed = curConsumeCount;
                 values.swap(curRawValue);
             }
@@ -2582,63 +2657,122 @@ int Parser::match(QStringRef input, QHash<QString,QString>& values, const ParseC
     return input.length() - text.length();
 }
 
-QStringList Parser::performValueTransform(const QStringList& paramName, const QHash<QString,QString>& rawValues, const QList<QList<PatternValueSubExpression> > &valueTransform)
+Parser::ValueTransformPlan Parser::compileValueTransform(const QString& paramName, const QList<PatternValueSubExpression>& valueTransform)
 {
-    QStringList result;
-    Q_ASSERT(paramName.size() == valueTransform.size());
-
-    for(int i = 0, num = paramName.size(); i < num; ++i){
-        const QString& param = paramName.at(i);
-        const auto& list = valueTransform.at(i);
-        QString value;
-        if(list.isEmpty()){
-            // direct search from raw values
-            value = rawValues.value(param);
-        }else{
-            for(const auto& expr : list){
-                switch(expr.ty){
-                case PatternValueSubExpression::OpType::Literal:{
-                    value.append(expr.literalData.str);
-                }break;
-                case PatternValueSubExpression::OpType::LocalReference:{
-                    Q_ASSERT(rawValues.count(expr.localReferenceData.valueName) > 0);
-                    value.append(rawValues.value(expr.localReferenceData.valueName));
-                }break;
-                case PatternValueSubExpression::OpType::ExternReference:{
-                    Q_UNREACHABLE();
-                }
-                }
+    ValueTransformPlan plan;
+    if(valueTransform.isEmpty()){
+        // direct search from raw values
+        plan.ty = ValueTransformPlan::PlanType::Forward;
+        plan.slotNames.push_back(paramName);
+        return plan;
+    }
+
+    for(const auto& expr : valueTransform){
+        switch(expr.ty){
+        case PatternValueSubExpression::OpType::Literal:{
+            const QString& str = expr.literalData.str;
+            if(str.isEmpty())
+                break;
+            // merge with previous literal if possible
+            if(!plan.steps.isEmpty() && plan.steps.back().ty == ValueTransformPlan::Step::StepType::Literal){
+                plan.steps.back().length += str.length();
+            }else{
+                plan.steps.push_back(ValueTransformPlan::Step{ValueTransformPlan::Step::StepType::Literal, plan.literalPool.length(), str.length()});
             }
+            plan.literalPool.append(str);
+        }break;
+        case PatternValueSubExpression::OpType::LocalReference:{
+            const QString& valueName = expr.localReferenceData.valueName;
+            int slotIndex = plan.slotNames.indexOf(valueName);
+            if(slotIndex == -1){
+                slotIndex = plan.slotNames.size();
+                plan.slotNames.push_back(valueName);
+            }
+            plan.steps.push_back(ValueTransformPlan::Step{ValueTransformPlan::Step::StepType::LocalRead, slotIndex, 0});
+        }break;
+        case PatternValueSubExpression::OpType::ExternReference:{
+            plan.steps.push_back(ValueTransformPlan::Step{ValueTransformPlan::Step::StepType::ExternRead, plan.externRefs.size(), 0});
+            plan.externRefs.push_back(expr.externReferenceData);
+        }break;
         }
-        result.push_back(value);
     }
-
-    return result;
+    plan.sizeHint = plan.literalPool.length();
+
+    if(plan.steps.isEmpty() || (plan.steps.size() == 1 && plan.steps.front().ty == ValueTransformPlan::Step::StepType::Literal)){
+        plan.ty = ValueTransformPlan::PlanType::Literal;
+        plan.steps.clear();
+    }else if(plan.steps.size() == 1 && plan.steps.front().ty == ValueTransformPlan::Step::StepType::LocalRead){
+        plan.ty = ValueTransformPlan::PlanType::Forward;
+        plan.steps.clear();
+    }else{
+        plan.ty = ValueTransformPlan::PlanType::General;
+    }
+    return plan;
 }
 
-QString Parser::performValueTransform(const QString &paramName,
+template<typename ExternReferenceSolver>
+QString Parser::performValueTransform(
         const QHash<QString,QString>& rawValues,
-        const QList<PatternValueSubExpression> &valueTransform,
-        std::function<QString(const PatternValueSubExpression::ExternReferenceData&)> externReferenceSolver)
+        const ValueTransformPlan& valueTransform,
+        ExternReferenceSolver externReferenceSolver)
 {
-    if(valueTransform.isEmpty())
-        return rawValues.value(paramName);
+    switch(valueTransform.ty){
+    case ValueTransformPlan::PlanType::Literal:
+        return valueTransform.literalPool;
+    case ValueTransformPlan::PlanType::Forward:
+        return rawValues.value(valueTransform.slotNames.front());
+    case ValueTransformPlan::PlanType::General:
+        break;
+    }
+
+    // look up each referenced value once and get the final size
+    int numSlot = valueTransform.slotNames.size();
+    RunTimeSizeArray<const QString*> slotValues(static_cast<std::size_t>(numSlot), nullptr);
+    int totalSize = valueTransform.sizeHint;
+    for(int i = 0; i < numSlot; ++i){
+        auto iter = rawValues.constFind(valueTransform.slotNames.at(i));
+        Q_ASSERT(iter != rawValues.constEnd());
+        if(Q_LIKELY(iter != rawValues.constEnd())){
+            slotValues.at(i) = &iter.value();
+        }
+    }
+    for(const auto& step : valueTransform.steps){
+        if(step.ty == ValueTransformPlan::Step::StepType::LocalRead && slotValues.at(step.index)){
+            totalSize += slotValues.at(step.index)->length();
+        }
+    }
 
     QString value;
-    for(const auto& expr : valueTransform){
-        switch(expr.ty){
-        case PatternValueSubExpression::OpType::Literal:{
-            value.append(expr.literalData.str);
+    value.reserve(totalSize);
+    for(const auto& step : valueTransform.steps){
+        switch(step.ty){
+        case ValueTransformPlan::Step::StepType::Literal:{
+            value.append(valueTransform.literalPool.constData() + step.index, step.length);
         }break;
-        case PatternValueSubExpression::OpType::LocalReference:{
-            Q_ASSERT(rawValues.count(expr.localReferenceData.valueName) > 0);
-            value.append(rawValues.value(expr.localReferenceData.valueName));
+        case ValueTransformPlan::Step::StepType::LocalRead:{
+            if(const QString* str = slotValues.at(step.index)){
+                value.append(*str);
+            }
         }break;
-        case PatternValueSubExpression::OpType::ExternReference:{
-            value.append(externReferenceSolver(expr.externReferenceData));
+        case ValueTransformPlan::Step::StepType::ExternRead:{
+            value.append(externReferenceSolver(valueTransform.externRefs.at(step.index)));
         }break;
         }
     }
 
     return value;
 }
+
+QStringList Parser::performValueTransform(const QHash<QString,QString>& rawValues, const QVector<ValueTransformPlan>& valueTransform)
+{
+    QStringList result;
+    result.reserve(valueTransform.size());
+    for(const auto& plan : valueTransform){
+        result.push_back(performValueTransform(rawValues, plan, [](const PatternValueSubExpression::ExternReferenceData&)->QString{
+            // pattern value transforms are local only
+            Q_UNREACHABLE();
+            return QString();
+        }));
+    }
+    return result;
+}
@@ -11,7 +11,6 @@
 #include <QRegularExpression>
 #include <QVector>
 
-#include <functional>
 #include <utility>
 
 class DiagnosticEmitterBase;
@@ -19,6 +18,8 @@ class DiagnosticEmitterBase;
 class IRRootType;
 class IRRootInstance;
 
+class QThreadPool;
+
 struct ParserNode
 {
     QString name;
@@ -113,12 +114,25 @@ struct ParserPolicy
 
     QList<ParserNode> nodes;
     QString rootParserNodeName;
+
+    // how ambiguous pattern matches are reported by parsers from this policy; see Parser::setAmbiguityReportMode()
+    bool isAmbiguityAggregated = false; //!< false for Parser::AmbiguityReportMode::Immediate, true for Aggregated
+    int ambiguitySampleCount = 3;       //!< (only if isAmbiguityAggregated) maximum sample positions per candidate set
 };
 
 class Parser
 {
     Q_DECLARE_TR_FUNCTIONS(Parser)
 public:
+    /**
+     * @brief The AmbiguityReportMode enum determines how ambiguous pattern matches are reported during parse()
+     */
+    enum class AmbiguityReportMode{
+        Immediate,  //!< emit Warn_Parser_Matching_Ambiguous (with evaluated parameters) at every ambiguous position
+        Aggregated  //!< only record (position, candidate) tuples during matching; emit one summary per candidate set at the end,
+                    //!< followed by Warn_Parser_Matching_Ambiguous for at most ambiguitySampleCount sample positions
+    };
+
     /**
      * @brief getParser get an instance of parser. return nullptr if parser is not valid
      * @param policy the ParserPolicy taking effect
@@ -128,14 +142,52 @@ public:
      */
     static Parser* getParser(const ParserPolicy& policy, const IRRootType& ir, DiagnosticEmitterBase& diagnostic);
 
+    /**
+     * @brief The SessionMemoryUsage struct is an estimated breakdown (in bytes) of memory used by the intermediate state of one parse() call
+     *
+     * The input text and the resulting IR tree (see IRRootInstance::getMemoryUsage()) are not included.
+     */
+    struct SessionMemoryUsage{
+        qint64 parserNodes  = 0;    //!< one record per parser node
+        qint64 parameters   = 0;    //!< parameter strings of parser nodes
+        qint64 pathPool     = 0;    //!< implicit start paths explored during pattern matching
+        qint64 childLists   = 0;    //!< child lists of parser nodes, including lists by type built for extern references
+
+        qint64 getTotal() const {return parserNodes + parameters + pathPool + childLists;}
+    };
+
     /**
      * @brief parse parse the text input and produce the IR tree instance.
      * @param text the text input to pass in. Each item is a text unit (where no pattern can match across unit boundary).
      * @param ir the ir that this parser would generate. This must match with ir from getParser()
      * @param diagnostic the diagnostic where warnings / errors are reported to.
+     * @param sessionUsage if not nullptr, receives memory usage of the parse session when it ends (whether parse succeeds or not)
      * @return Pointer to the new'ed IR tree. The caller takes ownership of returned IR tree.
      */
-    IRRootInstance* parse(QVector<QStringRef>& text, const IRRootType& ir, DiagnosticEmitterBase& diagnostic) const;
+    IRRootInstance* parse(QVector<QStringRef>& text, const IRRootType& ir, DiagnosticEmitterBase& diagnostic, SessionMemoryUsage* sessionUsage = nullptr) const;
+
+    /**
+     * @brief setAmbiguityReportMode set how ambiguous matches are reported in later parse() calls
+     * @param mode the report mode
+     * @param sampleCount (only for Aggregated mode) maximum number of sample positions reported in detail for each candidate set
+     */
+    void setAmbiguityReportMode(AmbiguityReportMode mode, int sampleCount = 3){
+        ambiguityReportMode = mode;
+        ambiguitySampleCount = sampleCount;
+    }
+    AmbiguityReportMode getAmbiguityReportMode() const {return ambiguityReportMode;}
+
+    /**
+     * @brief setParallelPatternMatch enable trying patterns of child nodes on a thread pool when a parent has many of them
+     *
+     * Results are reduced in the original pattern order, so the result (including tie-breaking and ambiguity warnings) is the same as serial matching.
+     * @param threshold minimum number of patterns from direct child nodes to try them in parallel; 0 disables parallel matching
+     * @param maxThreadCount maximum number of worker threads; 0 for QThread::idealThreadCount()
+     */
+    void setParallelPatternMatch(int threshold, int maxThreadCount = 0){
+        parallelPatternThreshold = threshold;
+        parallelPatternThreadCount = maxThreadCount;
+    }
 
 private:
     // private constructor so that only getParser() can create instance
@@ -261,10 +313,41 @@ private:
         LocalReferenceData localReferenceData;
         ExternReferenceData externReferenceData;
     };
+
+    /**
+     * @brief The ValueTransformPlan struct is a value transform (list of PatternValueSubExpression) compiled at getParser() time
+     *
+     * Literals are concatenated in one string and each local value name is resolved once per evaluation,
+     * so evaluation only copies spans into a pre-sized result.
+     */
+    struct ValueTransformPlan{
+        enum class PlanType{
+            Literal,    //!< the result is always literalPool; no copy is made
+            Forward,    //!< the result is the only local value referenced (slotNames[0]); the captured value is forwarded without copy
+            General     //!< execute the steps in order
+        };
+        struct Step{
+            enum class StepType{
+                Literal,    //!< append literalPool.mid(index, length)
+                LocalRead,  //!< append the local value with name slotNames[index]
+                ExternRead  //!< append the result from solving externRefs[index]
+            };
+            StepType ty;
+            int index;
+            int length;
+        };
+        PlanType ty = PlanType::Literal;
+        QString literalPool;
+        QStringList slotNames;      //!< name of local values referenced; each name appears once
+        QVector<Step> steps;
+        QVector<PatternValueSubExpression::ExternReferenceData> externRefs;
+        int sizeHint = 0;           //!< total length of literals; length of local values are added during evaluation
+    };
+
     struct Pattern{
         QList<SubPattern> elements;
-        QList<QList<PatternValueSubExpression>> valueTransform;//!< for each parameter of parser node (outer index),
-                                                               //!< how is the final value made by concatenating sub expressions
+        QVector<ValueTransformPlan> valueTransform;//!< for each parameter of parser node (outer index),
+                                                   //!< how is the final value made by concatenating sub expressions
         int priorityScore;  //!< a score calculated based on complexity of pattern
                             //!< (number of sub patterns, length of literals, etc)
                             //!< A pattern with higher score is chosen if it matches same length of text with other patterns
@@ -338,41 +421,77 @@ private:
      */
     static int match(QStringRef input, QHash<QString,QString>& values, const ParseContext& ctx, const QList<SubPattern>& pattern);
 
+    /**
+     * @brief compileValueTransform compile a value transform into a ValueTransformPlan
+     * @param paramName the name of parameter; an empty transform forwards the raw value with this name
+     * @param valueTransform the sub expressions to concatenate
+     * @return the compiled plan
+     */
+    static ValueTransformPlan compileValueTransform(const QString& paramName, const QList<PatternValueSubExpression>& valueTransform);
+
     /**
      * @brief performValueTransform is for transforming the parsed raw value to parser node parameters
-     * @param paramName list of parameter names
      * @param rawValues the raw values populated by match()
      * @param valueTransform describes how each parameters get their value from rawValues
      * @return list of parameter values
      */
     static QStringList performValueTransform(
-            const QStringList& paramName,
             const QHash<QString,QString>& rawValues,
-            const QList<QList<PatternValueSubExpression>>& valueTransform
+            const QVector<ValueTransformPlan>& valueTransform
     );
 
     /**
      * @brief performValueTransform variant that take an expression solver callback. This must only work with one parameter at a time.
-     * @param paramName the name of parameter
      * @param rawValues the raw values populated by match()
      * @param valueTransform describes how the parameter get its value from rawValues
-     * @param externReferenceSolver used to resolve variable references that are not in rawValues
-     * @return
+     * @param externReferenceSolver used to resolve variable references that are not in rawValues;
+     *        callable as QString(const PatternValueSubExpression::ExternReferenceData&)
+     * @return the parameter value
      */
-    static QString performValueTransform(const QString& paramName,
+    template<typename ExternReferenceSolver>
+    static QString performValueTransform(
             const QHash<QString,QString>& rawValues,
-            const QList<PatternValueSubExpression>& valueTransform,
-            std::function<QString(const PatternValueSubExpression::ExternReferenceData &)> externReferenceSolver
+            const ValueTransformPlan& valueTransform,
+            ExternReferenceSolver externReferenceSolver
     );
 
     /**
      * @brief findLongestMatchingPattern tries all listed pattern on beginning of text and find the one that consumes more characters than others
+     *
+     * Patterns are tried in the given order, which must be by priorityScore in descending order (see getPatternOrder()).
+     * The search stops as soon as a pattern consumes the entire text, since no later pattern can be better.
      * @param patterns the list of patterns to try on
+     * @param order the order of patterns to try
      * @param text input text
      * @param values the raw values retrieved when doing the matching
+     * @param first index in order of the first pattern to try
+     * @param last one past the index in order of last pattern to try; -1 for all patterns
      * @return pair of <pattern index, # characters consumed>; <-1,0> if no pattern applies
      */
-    std::pair<int,int> findLongestMatchingPattern(const QList<Pattern>& patterns, QStringRef text, QHash<QString,QString>& values) const;
+    std::pair<int,int> findLongestMatchingPattern(const QList<Pattern>& patterns, const QVector<int>& order, QStringRef text, QHash<QString,QString>& values, int first = 0, int last = -1) const;
+
+    /**
+     * @brief getPatternOrder get the order of trying patterns in findLongestMatchingPattern()
+     * @return index of patterns, sorted by priorityScore in descending order. Patterns with the same score keep their order.
+     */
+    static QVector<int> getPatternOrder(const QList<Pattern>& patterns);
+
+    /**
+     * @brief The PatternMatchWorkItem struct describes a range of patterns from one parser node to try in parallel pattern matching
+     */
+    struct PatternMatchWorkItem{
+        int nodeTypeIndex;  //!< index in Parser::nodes
+        int first;          //!< first pattern to try (index in Node::patternOrder)
+        int last;           //!< one past last pattern to try (index in Node::patternOrder)
+        int patternIndex;   //!< [result] best pattern in the range; -1 if none applies
+        int advanceDist;    //!< [result] number of characters consumed by the best pattern
+        QHash<QString,QString> rawValues;   //!< [result] raw values from the best pattern
+    };
+
+    /**
+     * @brief runPatternMatchWorkItems run findLongestMatchingPattern() for all work items using the thread pool and current thread
+     */
+    void runPatternMatchWorkItems(QThreadPool& pool, QVector<PatternMatchWorkItem>& items, QStringRef text) const;
 
     static int computePatternScore(const QList<SubPattern>& pattern, const QList<int>& matchPairScore);
 
@@ -384,22 +503,87 @@ private:
         int parentIndex;        //!< parent parser node in the list containning this item
         int indexWithinParent;  //!< index of node within parent
         int childNodeCount;     //!< How many child node do this node has
-        QStringList params;
+        int paramStart;         //!< index of the first parameter in ParseSession::paramSpans; there are Node::paramName.size() of them
+        int childStart;         //!< index of the first child in ParseSession::childIndexPool; only valid after ParseSession::finalizeChildList()
     };
-    QList<ParserNodeData> patternMatch(QVector<QStringRef>& text, DiagnosticEmitterBase& diagnostic) const;
 
-    struct IRBuildContext{
-        QList<ParserNodeData> parserNodes;
-        QHash<int,QHash<int,QList<int>>> parserNodeChildListCache;//!< [ParserNodeIndex][ChildParserNodeTypeIndex] -> [list of child node index in parserNodes]
+    /**
+     * @brief The ParseSession struct owns all intermediate data of one parse() call
+     *
+     * Parameter strings share one string pool, and children / implicit start paths are index ranges into flat vectors,
+     * so that a parse does not allocate per node and all of the session is released at once when it goes out of scope.
+     */
+    struct ParseSession{
+        struct StringSpan{
+            int start;
+            int length;
+        };
+        struct PathEntry{
+            int prev;           //!< index of previous step in pathPool; -1 if this is the first step
+            int nodeTypeIndex;  //!< the implicitly started ParserNode type at this step
+        };
+        struct IndexRange{
+            int start;
+            int count;
+        };
+
+        /**
+         * @brief The ChildList struct is a view of a list of child parser node indices
+         */
+        struct ChildList{
+            const QVector<int>* pool;
+            int start;
+            int count;
+
+            int size() const {return count;}
+            int at(int i) const {Q_ASSERT(i >= 0 && i < count); return pool->at(start + i);}
+
+            /**
+             * @brief upperBound find the number of child in this list whose parser node index is not greater than nodeIndex
+             */
+            int upperBound(int nodeIndex) const;
+        };
 
+        QVector<ParserNodeData> parserNodes;
+        QString paramPool;                      //!< all parameter strings, concatenated
+        QVector<StringSpan> paramSpans;         //!< each parameter is a span in paramPool
+        QVector<PathEntry> pathPool;            //!< implicit start paths explored at current position
+        QVector<int> childIndexPool;            //!< [childStart, childStart + childNodeCount) of each node are its direct children
+        QVector<int> typedChildPool;            //!< lists of direct children with specific type, built on demand
+        QHash<quint64, IndexRange> typedChildRangeCache;   //!< [ParentIndex << 32 | ChildTypeIndex] -> range in typedChildPool
 
         /**
-         * @brief getNodeChildList helper function to access parserNodeChildListCache; build the list if not found in cache
+         * @brief reserve preallocate the pools based on the size of input
+         * @param numTextUnit number of text units
+         * @param totalTextLength total number of characters in all text units
+         */
+        void reserve(int numTextUnit, int totalTextLength);
+
+        /**
+         * @brief addParameters copy parameters into the string pool
+         * @return the paramStart for ParserNodeData
+         */
+        int addParameters(const QStringList& params);
+
+        QStringRef getParameter(int nodeIndex, int paramIndex) const{
+            const StringSpan& span = paramSpans.at(parserNodes.at(nodeIndex).paramStart + paramIndex);
+            return QStringRef(&paramPool, span.start, span.length);
+        }
+
+        /**
+         * @brief finalizeChildList populate childIndexPool and childStart after pattern matching completes
+         */
+        void finalizeChildList();
+
+        /**
+         * @brief getNodeChildList get list of child of given node; build the list if it is not built yet
          * @param parentIndex parent index where list of child is needed
          * @param childNodeTypeIndex child parser node type index; -1 if all child is needed
-         * @return reference to child node index (in parserNodes) list
+         * @return view of child node index (in parserNodes) list. The view is invalidated by next call to this function.
          */
-        const QList<int>& getNodeChildList(int parentIndex, int childNodeTypeIndex);
+        ChildList getNodeChildList(int parentIndex, int childNodeTypeIndex);
+
+        SessionMemoryUsage getMemoryUsage() const;
 
         /**
          * @brief solveExternReference helper function for solve extern variable reference from parser node specified by nodeIndex
@@ -411,6 +595,29 @@ private:
         std::pair<bool,QString> solveExternReference(const Parser &p, const PatternValueSubExpression::ExternReferenceData& expr, int nodeIndex);
     };
 
+    /**
+     * @brief patternMatch perform pattern matching on the text and populate parser nodes in session
+     * @return true if the text is successfully matched, false otherwise
+     */
+    bool patternMatch(ParseSession& session, QVector<QStringRef>& text, DiagnosticEmitterBase& diagnostic) const;
+
+    /**
+     * @brief The AmbiguityRecordGroup struct aggregates all ambiguous positions having the same candidate set in AmbiguityReportMode::Aggregated
+     */
+    struct AmbiguityRecordGroup{
+        QList<int> candidates;          //!< flattened list of [ParserNodeTypeIndex][PatternIndex] pairs, in candidate order
+        int occurrenceCount = 0;        //!< number of positions where this candidate set is ambiguous
+        QList<QStringRef> sampleInput;  //!< remaining text unit at first few positions, for re-matching when reporting
+        QList<int> sampleLength;        //!< length of ambiguous text for each sample
+    };
+
+    /**
+     * @brief reportAggregatedAmbiguity emit warnings for recorded ambiguity groups; parameter values are only computed for samples
+     * @param groups the groups collected by patternMatch(), in order of first occurrence
+     * @param diagnostic the diagnostic where warnings are reported to
+     */
+    void reportAggregatedAmbiguity(const QList<AmbiguityRecordGroup>& groups, DiagnosticEmitterBase& diagnostic) const;
+
 private:
     // actual data
 
@@ -419,19 +626,27 @@ private:
         QList<Pattern> patterns;            //!< nodes with no pattern starts implicitly, i.e. when child node pattern matches.
                                             //!< These nodes should not have parameters
         QList<Pattern> earlyExitPatterns;
+        QVector<int> patternOrder;          //!< index of patterns, sorted by priorityScore in descending order (stable)
+        QVector<int> earlyExitPatternOrder; //!< index of earlyExitPatterns, sorted by priorityScore in descending order (stable)
+        int maxPatternScore = -1;           //!< maximum priorityScore among patterns; -1 if there is no pattern
         QStringList paramName;
 
         int combineToIRNodeIndex;           //!< the IRNode index to tranform to; -1 if this is a parser-only node
 
-        QList<QList<QList<PatternValueSubExpression>>> combineValueTransform;   //!< [ParamIndex][ExprIndex][List of sub expressions]
-                                                                                //!< for combine value transform, for each parameter, we allow multiple expression
-                                                                                //!< the result of first successful evaluation is used as final result
+        QList<QList<ValueTransformPlan>> combineValueTransform; //!< [ParamIndex][ExprIndex] -> compiled list of sub expressions
+                                                                //!< for combine value transform, for each parameter, we allow multiple expression
+                                                                //!< the result of first successful evaluation is used as final result
         QList<int> allowedChildNodeIndexList;
     };
 
     // node 0 is the root node; if the root node has patterns, it must be matched first, otherwise the root node implicitly starts
     QList<Node> nodes;
     ParseContext context;
+
+    AmbiguityReportMode ambiguityReportMode = AmbiguityReportMode::Immediate;
+    int ambiguitySampleCount = 3;
+    int parallelPatternThreshold = 0;
+    int parallelPatternThreadCount = 0;
 };
 
 #endif // PARSER_H
@@ -0,0 +1,44 @@
+#ifndef SYMBOLTABLE_H
+#define SYMBOLTABLE_H
+
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+/**
+ * @brief The SymbolTable class assigns each distinct name an integer id
+ *
+ * Ids are dense (0, 1, 2, ...) in the order names are first interned and never change afterwards,
+ * so that tables keyed by name can be arrays indexed by id. Names are only hashed when they are interned,
+ * i.e. when a Task is validated after loading; lookups during execution go through id-indexed arrays.
+ */
+class SymbolTable
+{
+public:
+    int intern(const QString& name){
+        auto iter = nameToId.constFind(name);
+        if(iter != nameToId.constEnd())
+            return iter.value();
+        int id = names.size();
+        names.push_back(name);
+        nameToId.insert(name, id);
+        return id;
+    }
+    int             find(const QString& name)   const {return nameToId.value(name, -1);}
+    const QString&  getName(int id)             const {return names.at(id);}
+    int             size()                      const {return names.size();}
+
+    /**
+     * @brief lookup read an id-indexed table
+     * @return table[id]; -1 if id is -1 or beyond the table (i.e. the symbol is interned after the table is built)
+     */
+    static int lookup(const QVector<int>& table, int id){
+        return (id >= 0 && id < table.size())? table.at(id) : -1;
+    }
+
+private:
+    QVector<QString> names;         //!< [id] -> name
+    QHash<QString, int> nameToId;   //!< [name] -> id
+};
+
+#endif // SYMBOLTABLE_H
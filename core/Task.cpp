@@ -5,10 +5,16 @@
 #include "core/IR.h"
 #include "util/ADT.h"
 
+#include <QAtomicInteger>
 #include <QQueue>
 
 #include <functional>
 
+namespace{
+// last value given out by Task::validate(); see Task::getGeneration()
+QAtomicInteger<quint64> lastTaskGeneration(0);
+}
+
 bool Function::validate(DiagnosticEmitterBase& diagnostic, const Task& task)
 {
     // POSSIBLE IMPROVEMENT:
@@ -205,8 +211,9 @@ bool Function::validate(DiagnosticEmitterBase& diagnostic, const Task& task)
     }
     calledFunctions.clear();
     QHash<QString, int> calledFunctionNameToIndex; // actually just use it as a set
-    for(const auto& stmt: callStmtList){
+    for(auto& stmt: callStmtList){
         int functionIndex = task.getFunctionIndex(stmt.functionName);
+        stmt.functionIndex = functionIndex;
         if(Q_UNLIKELY(functionIndex == -1)){
             diagnostic(Diag::Error_Func_Call_CalleeNotFound, stmt.functionName);
             isValidated = false;
@@ -307,6 +314,26 @@ bool Function::validate(DiagnosticEmitterBase& diagnostic, const Task& task)
     return isValidated;
 }
 
+void Function::resolveSymbols(SymbolTable& symbols)
+{
+    // if a name is used by more than one local variable, the first one is taken; validate() reports the name clash
+    for(const auto& name : localVariableNames){
+        symbols.intern(name);
+    }
+    localVariableBySymbol.fill(-1, symbols.size());
+    for(int i = localVariableNames.size()-1; i >= 0; --i){
+        localVariableBySymbol[symbols.find(localVariableNames.at(i))] = i;
+    }
+    for(ExpressionBase* ptr : exprList){
+        ptr->resolveSymbols(symbols);
+    }
+    for(auto& stmt : assignStmtList){
+        if(stmt.lvalueExprIndex == -1){
+            stmt.lvalueSymbol = symbols.intern(stmt.lvalueName);
+        }
+    }
+}
+
 Task::Task(const IRRootType& root)
     : root(root)
 {
@@ -340,7 +367,9 @@ int Task::addNewPass()
 
 bool Task::validate(DiagnosticEmitterBase& diagnostic)
 {
+    generation = lastTaskGeneration.fetchAndAddRelaxed(1) + 1;
     isValidated = true;
+    isSubtreeLocalTask = false;
     auto checkDomain = [&](MemberDecl& decl)->void{
         decl.varNameToIndex.clear();
         for(int i = 0, len = decl.varNameList.size(); i < len; ++i){
@@ -442,6 +471,8 @@ bool Task::validate(DiagnosticEmitterBase& diagnostic)
     if(Q_UNLIKELY(!isValidated))
         return isValidated;
 
+    buildSymbolTable();
+
     for(int i = 0, len = functions.size(); i < len; ++i){
         DiagnosticPathNode dnode(diagnostic, tr("Function %1").arg(QString::number(i)));
         // no short circuit
@@ -465,5 +496,72 @@ bool Task::validate(DiagnosticEmitterBase& diagnostic)
             diagnostic(Diag::Warn_Task_UnreachableFunction, functions.at(i).getName());
         }
     }
+
+    // subtree locality analysis; see isSubtreeLocal()
+    isSubtreeLocalTask = isValidated && globalVariables.varNameList.isEmpty();
+    for(int i = 0, len = nodeMemberDecl.size(); isSubtreeLocalTask && i < len; ++i){
+        for(ValueType ty : nodeMemberDecl.at(i).varTyList){
+            if(ty == ValueType::NodePtr || ty == ValueType::ValuePtr){
+                isSubtreeLocalTask = false;
+                break;
+            }
+        }
+    }
+    for(int i = 0, len = functions.size(); isSubtreeLocalTask && i < len; ++i){
+        const Function& f = functions.at(i);
+        for(int j = 0, numExpr = f.getNumExpression(); j < numExpr; ++j){
+            if(!f.getExpression(j)->isSubtreeLocal()){
+                isSubtreeLocalTask = false;
+                break;
+            }
+        }
+    }
     return isValidated;
 }
+
+void Task::buildSymbolTable()
+{
+    // names of declarations are interned first; names only referenced from functions (including the ones that
+    // do not resolve to anything) come after them and simply map to -1 in all tables
+    symbols = SymbolTable();
+    auto buildTable = [this](const QStringList& names, QVector<int>& table)->void{
+        for(const auto& name : names){
+            symbols.intern(name);
+        }
+        // if a name appears more than once, the first one is taken
+        table.fill(-1, symbols.size());
+        for(int i = names.size()-1; i >= 0; --i){
+            table[symbols.find(names.at(i))] = i;
+        }
+    };
+
+    int numNodeType = root.getNumNodeType();
+    QStringList nodeTypeNames;
+    for(int i = 0; i < numNodeType; ++i){
+        nodeTypeNames.push_back(root.getNodeType(i).getName());
+    }
+    buildTable(nodeTypeNames, nodeTypeBySymbol);
+
+    nodeParameterBySymbol.resize(numNodeType);
+    nodeMemberBySymbol.resize(numNodeType);
+    for(int i = 0; i < numNodeType; ++i){
+        const IRNodeType& nodeTy = root.getNodeType(i);
+        QStringList parameterNames;
+        for(int j = 0, numParam = nodeTy.getNumParameter(); j < numParam; ++j){
+            parameterNames.push_back(nodeTy.getParameterName(j));
+        }
+        buildTable(parameterNames, nodeParameterBySymbol[i]);
+        buildTable(nodeMemberDecl.at(i).varNameList, nodeMemberBySymbol[i]);
+    }
+    buildTable(globalVariables.varNameList, globalVariableBySymbol);
+
+    QStringList functionNames;
+    for(const auto& f : functions){
+        functionNames.push_back(f.getName());
+    }
+    buildTable(functionNames, functionBySymbol);
+
+    for(auto& f : functions){
+        f.resolveSymbols(symbols);
+    }
+}
@@ -8,6 +8,7 @@
 
 #include "core/Value.h"
 #include "core/Expression.h"
+#include "core/SymbolTable.h"
 
 class DiagnosticEmitterBase;
 class ExecutionContext;
@@ -35,6 +36,7 @@ struct AssignmentStatement{
     int lvalueExprIndex;    //!< expression index of left hand side; -1 for name based assignment
     int rvalueExprIndex;    //!< expression index of right hand side
     QString lvalueName;     //!< name of variable at left hand size; only used if expr index is -1
+    int lvalueSymbol = -1;  //!< symbol id of lvalueName; set by Task::validate()
 };
 
 struct OutputStatement{
@@ -44,6 +46,7 @@ struct OutputStatement{
 struct CallStatement{
     QString functionName;
     QList<int> argumentExprList;
+    int functionIndex = -1; //!< index of callee in Task; set by Function::validate()
 };
 
 struct BranchStatement{
@@ -102,6 +105,7 @@ public:
     int getNumLocalVariable() const {return localVariableNames.size();}
 
     int             getLocalVariableIndex       (const QString& varName)    const {return localVariableNameToIndex.value(varName, -1);}
+    int             getLocalVariableIndex       (int symbol)                const {return SymbolTable::lookup(localVariableBySymbol, symbol);}
     const QString&  getLocalVariableName        (int localVarIndex)         const {return localVariableNames.at(localVarIndex);}
     ValueType       getLocalVariableType        (int localVarIndex)         const {return localVariableTypes.at(localVarIndex);}
     const QVariant& getLocalVariableInitializer (int localVarIndex)         const {return localVariableInitializer.at(localVarIndex);}
@@ -226,6 +230,13 @@ public:
 
     bool validate(DiagnosticEmitterBase& diagnostic, const Task& task);
 
+    /**
+     * @brief resolveSymbols intern names of local variables and all names referenced by expressions and statements
+     *
+     * Called by Task::validate() before validate().
+     */
+    void resolveSymbols(SymbolTable& symbols);
+
 private:
     ExprList exprList;
     QList<Statement> stmtList;
@@ -255,6 +266,9 @@ private:
     QHash<QString, int> externVariableNameToIndex;
     QHash<QString, int> localVariableNameToIndex;
 
+    // constructed during resolveSymbols()
+    QVector<int> localVariableBySymbol; //!< [symbol id] -> local variable index
+
     // constructed during validate()
     QStringList calledFunctions;// debug / error checking purpose only
 };
@@ -352,12 +366,45 @@ public:
 
     const IRRootType& getRootType() const {return root;}
 
+    //-------------------------------------------------------------------------
+    // lookup by symbol id, for use during execution; only available after validate()
+    // names are interned into the symbol table by validate(), including the names of node types and parameters in IRRootType
+    // all of them return -1 if the symbol does not name such an entity
+
+    const SymbolTable& getSymbolTable() const {return symbols;}
+
+    int getGlobalVariableIndex  (int symbol)                    const {return SymbolTable::lookup(globalVariableBySymbol, symbol);}
+    int getNodeMemberIndex      (int nodeTypeIndex, int symbol) const {return SymbolTable::lookup(nodeMemberBySymbol.at(nodeTypeIndex), symbol);}
+    int getNodeParameterIndex   (int nodeTypeIndex, int symbol) const {return SymbolTable::lookup(nodeParameterBySymbol.at(nodeTypeIndex), symbol);}
+    int getNodeTypeIndex        (int symbol)                    const {return SymbolTable::lookup(nodeTypeBySymbol, symbol);}
+    int getFunctionIndex        (int symbol)                    const {return SymbolTable::lookup(functionBySymbol, symbol);}
+
     //-------------------------------------------------------------------------
 
     bool validated() const {return isValidated;}
     bool validate(DiagnosticEmitterBase& diagnostic);
 
+    /**
+     * @brief isSubtreeLocal whether callbacks on a node can only observe and modify the subtree of that node
+     *
+     * This holds if the task has no global variables, no node member holds a pointer (pointers carry node indices),
+     * and no expression reaches outside current node's subtree. Then the output and node member values produced by
+     * traversing a subtree in each pass only depend on the subtree's content, which is what ExecutionCache relies on.
+     * Only available after validate().
+     */
+    bool isSubtreeLocal() const {return isSubtreeLocalTask;}
+
+    /**
+     * @brief getGeneration identifies the content of this task as of the last validate()
+     *
+     * Unique among all Task objects in the process and renewed by every validate(), so state keyed on it (e.g. ExecutionCache)
+     * is never taken for another task, even one allocated where a destroyed task was. 0 before the first validate().
+     */
+    quint64 getGeneration() const {return generation;}
+
 private:
+    void buildSymbolTable();
+
     struct MemberDecl{
         QHash<QString, int> varNameToIndex;
         QStringList varNameList;
@@ -378,6 +425,8 @@ private:
 
     const IRRootType& root;
     bool isValidated = false;
+    bool isSubtreeLocalTask = false;
+    quint64 generation = 0;
     MemberDecl globalVariables;
 
     // indexed by nodeIndex as in IRRoot
@@ -387,6 +436,14 @@ private:
     QList<Function> functions;
     // constructed during validation
     QHash<QString, int> functionNameToIndex;
+
+    // constructed during validation; see buildSymbolTable()
+    SymbolTable symbols;
+    QVector<int> globalVariableBySymbol;            //!< [symbol id] -> global variable index
+    QVector<QVector<int>> nodeMemberBySymbol;       //!< [node type index] -> ([symbol id] -> node member index)
+    QVector<QVector<int>> nodeParameterBySymbol;    //!< [node type index] -> ([symbol id] -> parameter index)
+    QVector<int> nodeTypeBySymbol;                  //!< [symbol id] -> node type index
+    QVector<int> functionBySymbol;                  //!< [symbol id] -> function index
 };
 
 #endif // TASK_H
@@ -2,6 +2,7 @@
 
 #include "core/Value.h"
 #include "core/IR.h"
+#include "core/IRBuilder.h"
 #include "core/DiagnosticEmitter.h"
 #include "util/ADT.h"
 
@@ -10,8 +11,11 @@
 #include <QXmlStreamWriter>
 
 #include <memory>
+#include <vector>
 
 #define XML_INDENT_SPACE 2
+// nodes nested deeper than this are written without indentation, otherwise output size is quadratic in tree depth
+#define XML_MAX_INDENT_DEPTH 64
 
 namespace{
 const QString STR_XML_IRROOTINST = QStringLiteral("IRInstance");
@@ -56,7 +60,7 @@ std::pair<bool,ValueType> getValueTypeFromName(QStringRef name)
 }
 
 namespace {
-void writeToXML_IRNode(QXmlStreamWriter& xml, const IRRootInstance& ir, int nodeIndex)
+void writeToXML_IRNodeStart(QXmlStreamWriter& xml, const IRRootInstance& ir, int nodeIndex)
 {
     const auto& nodeInst = ir.getNode(nodeIndex);
     int tyIndex = nodeInst.getTypeIndex();
@@ -70,26 +74,46 @@ void writeToXML_IRNode(QXmlStreamWriter& xml, const IRRootInstance& ir, int node
         xml.writeAttribute(STR_XML_IRNODEINST_PARAM_NAME, paramName);
         ValueType valTy = nodeTy.getParameterType(i);
         xml.writeAttribute(STR_XML_IRNODEINST_PARAM_TYPE, getValueTypeName(valTy));
-        const QVariant& val = nodeInst.getParameter(i);
         switch(valTy){
         case ValueType::String:
-            xml.writeCharacters(val.toString());
+            xml.writeCharacters(nodeInst.getParameterAs<QString>(i));
             break;
         case ValueType::Int64:
-            xml.writeCharacters(QString::number(val.toLongLong()));
+            xml.writeCharacters(QString::number(nodeInst.getParameterAs<qint64>(i)));
             break;
         default:
             Q_UNREACHABLE();
         }
         xml.writeEndElement(); // parameter
     }
-    if(nodeInst.getNumChildNode() > 0){
-        for(int i = 0, n = nodeInst.getNumChildNode(); i < n; ++i){
-            writeToXML_IRNode(xml, ir, nodeInst.getChildNodeByOrder(i));
+}
+
+// the tree is walked with an explicit stack, so the depth is not limited by the thread stack size
+// xml should have auto formatting enabled
+void writeToXML_IRNode(QXmlStreamWriter& xml, const IRRootInstance& ir, int nodeIndex)
+{
+    struct Entry{
+        int nodeIndex;
+        int childOrder; // next child to write
+    };
+    QVector<Entry> stack;
+    writeToXML_IRNodeStart(xml, ir, nodeIndex);
+    stack.push_back(Entry{nodeIndex, 0});
+    while(!stack.isEmpty()){
+        Entry& top = stack.back();
+        const auto& nodeInst = ir.getNode(top.nodeIndex);
+        if(top.childOrder < nodeInst.getNumChildNode()){
+            int childIndex = nodeInst.getChildNodeByOrder(top.childOrder);
+            top.childOrder += 1;
+            xml.setAutoFormatting(stack.size() < XML_MAX_INDENT_DEPTH);
+            writeToXML_IRNodeStart(xml, ir, childIndex);
+            stack.push_back(Entry{childIndex, 0});
+        }else{
+            stack.pop_back();
+            xml.setAutoFormatting(stack.size() < XML_MAX_INDENT_DEPTH);
+            xml.writeEndElement(); // node instance
         }
     }
-
-    xml.writeEndElement(); // node instance
 }
 }
 
@@ -110,8 +134,12 @@ void XML::writeIRInstance(const IRRootInstance& ir, QIODevice* dest)
 }
 
 namespace{
-bool readFromXML_IRNodeInstance(QXmlStreamReader& xml, DiagnosticEmitterBase& diagnostic,
-                                const IRRootType& ty, IRRootInstance& root, int parentIndex, int& nodeIndex){
+// read the start element and parameters of a node, and add it to builder
+// isEndElementFound is set if the end element of the node is also read (i.e. the node has no child)
+// pathNode is the diagnostic path node of the node; the caller releases it after all children are read
+bool readFromXML_IRNodeStart(QXmlStreamReader& xml, DiagnosticEmitterBase& diagnostic,
+                             const IRRootType& ty, IRBuilder& builder, int parentIndex, int& nodeIndex,
+                             bool& isEndElementFound, std::unique_ptr<DiagnosticPathNode>& pathNode){
     Q_ASSERT(xml.isStartElement());
     if(Q_UNLIKELY(xml.name() != STR_XML_IRNODEINST)){
         diagnostic(Diag::Error_XML_UnexpectedElement,
@@ -133,7 +161,7 @@ bool readFromXML_IRNodeInstance(QXmlStreamReader& xml, DiagnosticEmitterBase& di
                        STR_XML_IRNODEINST, attr.name().toString(), attr.value().toString());
         }
     }
-    DiagnosticPathNode pathNode(diagnostic, QCoreApplication::tr("Node %1").arg(nodeIndex));
+    pathNode.reset(new DiagnosticPathNode(diagnostic, QCoreApplication::tr("Node %1").arg(nodeIndex)));
     int nodeTyIndex = ty.getNodeTypeIndex(tyName);
     if(Q_UNLIKELY(nodeTyIndex == -1)){
         diagnostic(Diag::Error_XML_UnknownIRNodeType,
@@ -142,18 +170,18 @@ bool readFromXML_IRNodeInstance(QXmlStreamReader& xml, DiagnosticEmitterBase& di
                    tyName);
         return false;
     }
-    pathNode.setDetailedName(tyName);
+    pathNode->setDetailedName(tyName);
     const IRNodeType& nodeTy = ty.getNodeType(nodeTyIndex);
     int numParams = nodeTy.getNumParameter();
-    QList<QVariant> args;
+    QList<IRParameterValue> args;
     args.reserve(numParams);
     for(int i = 0; i < numParams; ++i){
-        args.push_back(QVariant());
+        args.push_back(IRParameterValue());
     }
     RunTimeSizeArray<bool> isArgSet(static_cast<std::size_t>(numParams), false);
 
     // deal with all parameters
-    bool isEndElementFound = false;
+    isEndElementFound = false;
     while(!xml.atEnd()){
         xml.readNext();
         if(Q_UNLIKELY(xml.hasError())){
@@ -256,14 +284,14 @@ bool readFromXML_IRNodeInstance(QXmlStreamReader& xml, DiagnosticEmitterBase& di
                        paramName);
             return false;
         }
-        QVariant data;
+        IRParameterValue data;
         switch(paramType){
         case ValueType::String:{
-            data = paramData;
+            data = IRParameterValue(paramData);
         }break;
         case ValueType::Int64:{
             bool isGood = false;
-            data = paramData.toLongLong(&isGood);
+            data = IRParameterValue(paramData.toLongLong(&isGood));
             if(Q_UNLIKELY(!isGood)){
                 diagnostic(Diag::Error_XML_IRNode_Param_InvalidValue,
                            static_cast<int>(xml.lineNumber()),
@@ -300,10 +328,10 @@ bool readFromXML_IRNodeInstance(QXmlStreamReader& xml, DiagnosticEmitterBase& di
                        static_cast<int>(xml.columnNumber()));
             switch(nodeTy.getParameterType(i)){
             case ValueType::String:{
-                args[i] = QString();
+                args[i] = IRParameterValue(QString());
             }break;
             case ValueType::Int64:{
-                args[i] = static_cast<qlonglong>(0);
+                args[i] = IRParameterValue(static_cast<qint64>(0));
             }break;
             default:
                 Q_UNREACHABLE();
@@ -311,60 +339,99 @@ bool readFromXML_IRNodeInstance(QXmlStreamReader& xml, DiagnosticEmitterBase& di
         }
     }
 
-    if(parentIndex != -1){
-        root.getNode(parentIndex).addChildNode(nodeIndex);
-    }
-    int currentNodeIndex = root.addNode(nodeTyIndex);
+    int currentNodeIndex = builder.addNode(nodeTyIndex, parentIndex);
     Q_ASSERT(currentNodeIndex == nodeIndex);
     nodeIndex += 1;
+    builder.setParameters(currentNodeIndex, args);
 
-    IRNodeInstance& inst = root.getNode(currentNodeIndex);
-    inst.setParent(parentIndex);
-    inst.setParameters(args);
-
-    // skip first readNext(); that is done when trying to find end of parameters
-    bool isFirstReadAfterParameter = true;
-    if(!isEndElementFound){
-        // deal with all child elements
-        while(!xml.atEnd()){
-            if(isFirstReadAfterParameter){
-                isFirstReadAfterParameter = false;
-            }else{
-                xml.readNext();
-            }
-            if(Q_UNLIKELY(xml.hasError())){
-                diagnostic(Diag::Error_XML_InvalidXML,
-                           static_cast<int>(xml.lineNumber()),
-                           static_cast<int>(xml.columnNumber()),
-                           xml.errorString());
-                return false;
-            }
-            if(xml.isComment() || xml.isCharacters())
-                continue;
-            if(xml.isEndElement()){
-                isEndElementFound = true;
-                break;
-            }
-            if(Q_UNLIKELY(!xml.isStartElement())){
-                diagnostic(Diag::Error_XML_ExpectingStartElement,
-                           static_cast<int>(xml.lineNumber()),
-                           static_cast<int>(xml.columnNumber()),
-                           xml.tokenString());
+    return true;
+}
+
+// read a node and all its descendants
+// the tree is walked with an explicit stack, so the depth is not limited by the thread stack size
+bool readFromXML_IRNodeInstance(QXmlStreamReader& xml, DiagnosticEmitterBase& diagnostic,
+                                const IRRootType& ty, IRBuilder& builder, int parentIndex, int& nodeIndex){
+    struct Entry{
+        int nodeIndex;
+        std::unique_ptr<DiagnosticPathNode> pathNode;
+    };
+    std::vector<Entry> stack;
+    // diagnostic path nodes must be released in reverse order of creation
+    auto unwind = [&stack]()->void{
+        while(!stack.empty()){
+            stack.pop_back();
+        }
+    };
+
+    // skip first readNext() after a node is started; that is done when trying to find end of parameters
+    bool isFirstReadAfterParameter = false;
+    bool isNodeStartPending = true;
+    while(true){
+        if(isNodeStartPending){
+            isNodeStartPending = false;
+            int currentNodeIndex = nodeIndex;
+            bool isEndElementFound = false;
+            std::unique_ptr<DiagnosticPathNode> pathNode;
+            int currentParentIndex = stack.empty()? parentIndex : stack.back().nodeIndex;
+            if(Q_UNLIKELY(!readFromXML_IRNodeStart(xml, diagnostic, ty, builder, currentParentIndex, nodeIndex, isEndElementFound, pathNode))){
+                pathNode.reset();
+                unwind();
                 return false;
             }
-            if(Q_UNLIKELY(xml.name() == STR_XML_IRNODEINST_PARAM)){
-                diagnostic(Diag::Error_XML_IRNode_ParamAfterChildNode,
-                           static_cast<int>(xml.lineNumber()),
-                           static_cast<int>(xml.columnNumber()));
-                return false;
+            if(isEndElementFound){
+                pathNode.reset();
+                if(stack.empty())
+                    return true;
+            }else{
+                stack.push_back(Entry{currentNodeIndex, std::move(pathNode)});
+                isFirstReadAfterParameter = true;
             }
-            // child node
-            bool isChildGood = readFromXML_IRNodeInstance(xml, diagnostic, ty, root, currentNodeIndex, nodeIndex);
-            if(Q_UNLIKELY(!isChildGood))
-                return false;
         }
+
+        // deal with child elements of the node on top of stack
+        if(xml.atEnd()){
+            unwind();
+            return true;
+        }
+        if(isFirstReadAfterParameter){
+            isFirstReadAfterParameter = false;
+        }else{
+            xml.readNext();
+        }
+        if(Q_UNLIKELY(xml.hasError())){
+            diagnostic(Diag::Error_XML_InvalidXML,
+                       static_cast<int>(xml.lineNumber()),
+                       static_cast<int>(xml.columnNumber()),
+                       xml.errorString());
+            unwind();
+            return false;
+        }
+        if(xml.isComment() || xml.isCharacters())
+            continue;
+        if(xml.isEndElement()){
+            stack.pop_back();
+            if(stack.empty())
+                return true;
+            continue;
+        }
+        if(Q_UNLIKELY(!xml.isStartElement())){
+            diagnostic(Diag::Error_XML_ExpectingStartElement,
+                       static_cast<int>(xml.lineNumber()),
+                       static_cast<int>(xml.columnNumber()),
+                       xml.tokenString());
+            unwind();
+            return false;
+        }
+        if(Q_UNLIKELY(xml.name() == STR_XML_IRNODEINST_PARAM)){
+            diagnostic(Diag::Error_XML_IRNode_ParamAfterChildNode,
+                       static_cast<int>(xml.lineNumber()),
+                       static_cast<int>(xml.columnNumber()));
+            unwind();
+            return false;
+        }
+        // child node
+        isNodeStartPending = true;
     }
-    return true;
 }
 }
 IRRootInstance* XML::readIRInstance(const IRRootType &ty, DiagnosticEmitterBase& diagnostic, QIODevice* src)
@@ -372,7 +439,7 @@ IRRootInstance* XML::readIRInstance(const IRRootType &ty, DiagnosticEmitterBase&
     Q_ASSERT(ty.validated());
 
     QXmlStreamReader xml(src);
-    std::unique_ptr<IRRootInstance> ptr;
+    std::unique_ptr<IRBuilder> builder;
 
     // loop till the StartElement of IRRootInstance
     while(!xml.atEnd()){
@@ -406,11 +473,11 @@ IRRootInstance* XML::readIRInstance(const IRRootType &ty, DiagnosticEmitterBase&
                            STR_XML_IRROOTINST, attr.name().toString(), attr.value().toString());
             }
         }
-        ptr.reset(new IRRootInstance(ty));
+        builder.reset(new IRBuilder(ty));
         break;
     }
 
-    if(Q_UNLIKELY(!ptr)){
+    if(Q_UNLIKELY(!builder)){
         // something is wrong
         if(xml.hasError()){
             diagnostic(Diag::Error_XML_InvalidXML,
@@ -445,7 +512,7 @@ IRRootInstance* XML::readIRInstance(const IRRootType &ty, DiagnosticEmitterBase&
     DiagnosticPathNode pathNode(diagnostic, QCoreApplication::tr("IR Root"));
 
     int nodeIndex = 0;
-    bool isRootGood = readFromXML_IRNodeInstance(xml, diagnostic, ty, *ptr, -1, nodeIndex);
+    bool isRootGood = readFromXML_IRNodeInstance(xml, diagnostic, ty, *builder, -1, nodeIndex);
     if(!isRootGood){
         return nullptr;
     }
@@ -465,6 +532,7 @@ IRRootInstance* XML::readIRInstance(const IRRootType &ty, DiagnosticEmitterBase&
         return nullptr;
     }
 
+    std::unique_ptr<IRRootInstance> ptr(builder->finish());
     if(Q_UNLIKELY(!(ptr->validate(diagnostic)))){
         return nullptr;
     }
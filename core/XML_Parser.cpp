@@ -17,6 +17,10 @@ const QString STR_PARSER = QStringLiteral("Parser");
 const QString STR_EXPR_START = QStringLiteral("ExprStart");
 const QString STR_EXPR_END = QStringLiteral("ExprEnd");
 const QString STR_ROOTNODE_NAME = QStringLiteral("RootNodeName");
+const QString STR_AMBIGUITY_REPORT = QStringLiteral("AmbiguityReport");
+const QString STR_AMBIGUITY_REPORT_IMMEDIATE = QStringLiteral("Immediate");
+const QString STR_AMBIGUITY_REPORT_AGGREGATED = QStringLiteral("Aggregated");
+const QString STR_AMBIGUITY_SAMPLE_COUNT = QStringLiteral("SampleCount");
 const QString STR_MATCHPAIR_LIST = QStringLiteral("MatchPairList");
 const QString STR_MATCHPAIR = QStringLiteral("MatchPair");
 const QString STR_MATCHPAIR_START = QStringLiteral("Start");
@@ -68,6 +72,10 @@ void XML::writeParser(const ParserPolicy& p, QXmlStreamWriter& xml)
     writeAsElement(xml, STR_EXPR_START,     p.exprStartMark);
     writeAsElement(xml, STR_EXPR_END,       p.exprEndMark);
     writeAsElement(xml, STR_ROOTNODE_NAME,  p.rootParserNodeName);
+    xml.writeStartElement(STR_AMBIGUITY_REPORT);
+    xml.writeAttribute(STR_AMBIGUITY_SAMPLE_COUNT, QString::number(p.ambiguitySampleCount));
+    xml.writeCharacters(p.isAmbiguityAggregated? STR_AMBIGUITY_REPORT_AGGREGATED : STR_AMBIGUITY_REPORT_IMMEDIATE);
+    xml.writeEndElement();
 
     // match pairs
     xml.writeStartElement(STR_MATCHPAIR_LIST);
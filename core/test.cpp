@@ -1,4 +1,7 @@
 #include "core/XML.h"
+#include "core/IRBinary.h"
+#include "core/IRBuilder.h"
+#include "core/IRCodegen.h"
 #include "core/Bundle.h"
 #include "core/DiagnosticEmitter.h"
 #include "core/Expression.h"
@@ -7,41 +10,159 @@
 #include "core/CLIDriver.h"
 #include "core/OutputHandlerBase.h"
 #include "core/ExecutionContext.h"
+#include "core/ExecutionCache.h"
 #include "core/Parser.h"
 
+#include <QBuffer>
 #include <QDebug>
+#include <QElapsedTimer>
 
+#include <functional>
 #include <stdexcept>
 #include <memory>
 
-void testWriteXML(){
-    ConsoleDiagnosticEmitter diag;
-    IRRootType* ty = new IRRootType("test");
-    {
-        IRNodeType speech("speech");
-        speech.addParameter("character", ValueType::String, false);
-        speech.addParameter("dummy", ValueType::Int64, false);
-        speech.addParameter("text", ValueType::String, false);
-        IRNodeType back("back");
-        back.addParameter("text", ValueType::String, false);
-        IRNodeType root("root");
-        root.addChildNode("speech");
-        root.addChildNode("back");
-        ty->addNodeTypeDefinition(root);
-        ty->addNodeTypeDefinition(speech);
-        ty->addNodeTypeDefinition(back);
-        ty->setRootNodeType("root");
+namespace{
+// keeps diagnostics as text (path, id and arguments) so that runs can be compared
+class TextRecordingDiagnosticEmitter: public DiagnosticEmitterBase
+{
+public:
+    virtual ~TextRecordingDiagnosticEmitter() override {}
+    virtual void diagnosticHandle(Diag::ID id, const QList<QVariant>& data) override{
+        QString text;
+        for(auto ptr = currentHead(); ptr; ptr = ptr->getPrev()){
+            text.prepend(ptr->getPathName() + '(' + ptr->getDetailedName() + ")/");
+        }
+        text.append(QString::number(static_cast<int>(id)));
+        for(const auto& item : data){
+            text.append(' ');
+            text.append(item.toString());
+        }
+        records.push_back(text);
+    }
+    // whether any record (after the path) starts with the given diagnostic id
+    bool contains(Diag::ID id) const{
+        QString prefix = QString::number(static_cast<int>(id)) + ' ';
+        for(const auto& record : records){
+            if(record.section('/', -1).startsWith(prefix))
+                return true;
+        }
+        return false;
+    }
+    // records of the given diagnostic id, without the path
+    QStringList getRecords(Diag::ID id) const{
+        QString prefix = QString::number(static_cast<int>(id)) + ' ';
+        QStringList result;
+        for(const auto& record : records){
+            QString text = record.section('/', -1);
+            if(text.startsWith(prefix)){
+                result.push_back(text);
+            }
+        }
+        return result;
+    }
+    QStringList records;
+};
+
+// IR type where node "root" has children of node "line", which has one String parameter "text"
+IRRootType* createLineIRType(DiagnosticEmitterBase& diagnostic)
+{
+    IRRootType* ty = new IRRootType("lines");
+    IRNodeType line("line");
+    line.addParameter("text", ValueType::String, false);
+    IRNodeType root("root");
+    root.addChildNode("line");
+    ty->addNodeTypeDefinition(root);
+    ty->addNodeTypeDefinition(line);
+    ty->setRootNodeType("root");
+    bool isTypeValidated = ty->validate(diagnostic);
+    Q_ASSERT(isTypeValidated);
+    Q_UNUSED(isTypeValidated)
+    return ty;
+}
+
+// parser policy for createLineIRType(); each of lineNodes (only name and patterns are needed) becomes a child of root converted to "line"
+ParserPolicy createLinePolicy(QList<ParserNode> lineNodes)
+{
+    ParserPolicy policy;
+    policy.name = QStringLiteral("LineParser");
+    policy.exprStartMark = QStringLiteral("<");
+    policy.exprEndMark = QStringLiteral(">");
+    policy.ignoreList.push_back(QStringLiteral(" "));
+    policy.rootParserNodeName = QStringLiteral("root");
+    ParserNode rootNode;
+    rootNode.name = policy.rootParserNodeName;
+    for(auto& node : lineNodes){
+        rootNode.childNodeNameList.push_back(node.name);
+        node.parameterNameList.push_back(QStringLiteral("text"));
+        node.combineToNodeTypeName = QStringLiteral("line");
+    }
+    policy.nodes.push_back(rootNode);
+    policy.nodes.append(lineNodes);
+    return policy;
+}
+
+// calls probe while a task is executing, so that interfaces needing a stack frame can be called from tests
+// the probe must not reach outside the current subtree if isLocal is set
+class ProbeExpression: public ExpressionBase
+{
+public:
+    explicit ProbeExpression(std::function<void(ExecutionContext&)> probe, bool isLocal = false): probe(probe), isLocal(isLocal){}
+    virtual ~ProbeExpression() override {}
+    virtual ProbeExpression* clone() const override {return new ProbeExpression(probe, isLocal);}
+    virtual ValueType getExpressionType() const override {return ValueType::String;}
+    virtual bool evaluate(ExecutionContext& ctx, QVariant& retVal, const QList<QVariant>& dependentExprResults) const override{
+        Q_UNUSED(dependentExprResults)
+        probe(ctx);
+        retVal = QString();
+        return true;
     }
-    Q_ASSERT(ty->validate(diag));
-    int speechTyIndex = ty->getNodeTypeIndex("speech");
-    int backTyIndex = ty->getNodeTypeIndex("back");
+    virtual bool isSubtreeLocal() const override {return isLocal;}
+private:
+    std::function<void(ExecutionContext&)> probe;
+    bool isLocal;
+};
+
+ParserNode::Pattern createPattern(const QString& patternString, int priorityScore = 0)
+{
+    ParserNode::Pattern pattern;
+    pattern.patternString = patternString;
+    pattern.priorityScore = priorityScore;
+    return pattern;
+}
 
-    IRRootInstance* inst = new IRRootInstance(*ty);
-    int rootIdx = inst->addNode(ty->getNodeTypeIndex("root"));
-    auto& root = inst->getNode(rootIdx);
-    int s1 = inst->addNode(speechTyIndex);
+// IR type where node "root" has children of node "speech" (character, dummy, text) and "back" (text)
+IRRootType* createSpeechIRType(DiagnosticEmitterBase& diagnostic)
+{
+    IRRootType* ty = new IRRootType("test");
+    IRNodeType speech("speech");
+    speech.addParameter("character", ValueType::String, false);
+    speech.addParameter("dummy", ValueType::Int64, false);
+    speech.addParameter("text", ValueType::String, false);
+    IRNodeType back("back");
+    back.addParameter("text", ValueType::String, false);
+    IRNodeType root("root");
+    root.addChildNode("speech");
+    root.addChildNode("back");
+    ty->addNodeTypeDefinition(root);
+    ty->addNodeTypeDefinition(speech);
+    ty->addNodeTypeDefinition(back);
+    ty->setRootNodeType("root");
+    // no side effect in Q_ASSERT; everything must still run in release build
+    bool isTypeValidated = ty->validate(diagnostic);
+    Q_ASSERT(isTypeValidated);
+    Q_UNUSED(isTypeValidated)
+    return ty;
+}
+
+// validated instance of createSpeechIRType(): root (node 0) with a speech (node 1) and a back (node 2)
+IRRootInstance* createSpeechIRInstance(const IRRootType& ty, DiagnosticEmitterBase& diagnostic)
+{
+    IRRootInstance* inst = new IRRootInstance(ty);
+    int rootIdx = inst->addNode(ty.getNodeTypeIndex("root"));
+    auto root = inst->getNode(rootIdx);
+    int s1 = inst->addNode(ty.getNodeTypeIndex("speech"));
     {
-        auto& s1n = inst->getNode(s1);
+        auto s1n = inst->getNode(s1);
         s1n.setParent(rootIdx);
         root.addChildNode(s1);
         QList<QVariant> args;
@@ -50,31 +171,193 @@ void testWriteXML(){
         args.push_back(QVariant("Hello world!\nUmm.."));
         s1n.setParameters(args);
     }
-    int b1 = inst->addNode(backTyIndex);
+    int b1 = inst->addNode(ty.getNodeTypeIndex("back"));
     {
-        auto& b1n = inst->getNode(b1);
+        auto b1n = inst->getNode(b1);
         b1n.setParent(rootIdx);
         root.addChildNode(b1);
         QList<QVariant> args;
         args.push_back(QVariant(""));
         b1n.setParameters(args);
     }
-    Q_ASSERT(inst->validate(diag));
+    bool isValidated = inst->validate(diagnostic);
+    Q_ASSERT(isValidated);
+    Q_UNUSED(isValidated)
+    return inst;
+}
+
+// validated instance of createSpeechIRType() whose root is a single speech node; for graftSubtree()
+IRRootInstance* createGraftedSpeech(const IRRootType& ty, DiagnosticEmitterBase& diagnostic)
+{
+    IRRootInstance* speechOnly = new IRRootInstance(ty);
+    auto s2n = speechOnly->getNode(speechOnly->addNode(ty.getNodeTypeIndex("speech")));
+    QList<QVariant> args;
+    args.push_back(QVariant("TB"));
+    args.push_back(QVariant(1ll));
+    args.push_back(QVariant("Grafted"));
+    s2n.setParameters(args);
+    bool isValidated = speechOnly->validate(diagnostic);
+    Q_ASSERT(isValidated);
+    Q_UNUSED(isValidated)
+    return speechOnly;
+}
+
+// whether all nodes of both instances have the same type, children and parameters
+bool isSameContent(const IRInstanceReaderBase& lhs, const IRRootInstance& rhs)
+{
+    if(lhs.getNumNode() != rhs.getNumNode())
+        return false;
+    for(int i = 0, n = lhs.getNumNode(); i < n; ++i){
+        IRConstNodeInstance node = rhs.getNode(i);
+        if(lhs.getTypeIndex(i) != node.getTypeIndex() || lhs.getParentIndex(i) != node.getParentIndex()
+                || lhs.getNumChildNode(i) != node.getNumChildNode())
+            return false;
+        for(int j = 0, numParam = rhs.getType().getNodeType(node.getTypeIndex()).getNumParameter(); j < numParam; ++j){
+            if(lhs.getParameter(i, j) != node.getParameter(j))
+                return false;
+        }
+    }
+    return true;
+}
+}
+
+// XML write, read back and write again
+void testWriteXML(){
+    ConsoleDiagnosticEmitter diag;
+    std::unique_ptr<IRRootType> ty(createSpeechIRType(diag));
+    std::unique_ptr<IRRootInstance> inst(createSpeechIRInstance(*ty, diag));
     QFile f("test.txt");
-    Q_ASSERT(f.open(QIODevice::WriteOnly));
+    bool isOpened = f.open(QIODevice::WriteOnly);
+    Q_ASSERT(isOpened);
     XML::writeIRInstance(*inst, &f);
     f.close();
-    Q_ASSERT(f.open(QIODevice::ReadOnly));
-    IRRootInstance* readBack = XML::readIRInstance(*ty, diag, &f);
-    Q_ASSERT(readBack != nullptr);
+    isOpened = f.open(QIODevice::ReadOnly);
+    Q_ASSERT(isOpened);
+    std::unique_ptr<IRRootInstance> readBack(XML::readIRInstance(*ty, diag, &f));
+    Q_ASSERT(readBack != nullptr && readBack->validated());
+    Q_ASSERT(isSameContent(IRRootInstanceReader(*readBack), *inst));
     f.close();
     f.setFileName("test2.txt");
-    Q_ASSERT(f.open(QIODevice::WriteOnly));
+    isOpened = f.open(QIODevice::WriteOnly);
+    Q_ASSERT(isOpened);
     XML::writeIRInstance(*readBack, &f);
     f.close();
-    delete readBack;
-    delete inst;
-    delete ty;
+    Q_UNUSED(isOpened)
+}
+
+// binary write and read back into an IRRootInstance
+void testBinaryRoundTrip(){
+    ConsoleDiagnosticEmitter diag;
+    std::unique_ptr<IRRootType> ty(createSpeechIRType(diag));
+    std::unique_ptr<IRRootInstance> inst(createSpeechIRInstance(*ty, diag));
+    QFile f("test.bin");
+    bool isOpened = f.open(QIODevice::WriteOnly);
+    Q_ASSERT(isOpened);
+    bool isBinaryWritten = IRBinary::writeIRInstance(*inst, &f);
+    Q_ASSERT(isBinaryWritten);
+    Q_UNUSED(isBinaryWritten)
+    f.close();
+    isOpened = f.open(QIODevice::ReadOnly);
+    Q_ASSERT(isOpened);
+    Q_UNUSED(isOpened)
+    std::unique_ptr<IRRootInstance> readBack(IRBinary::readIRInstance(*ty, diag, &f));
+    Q_ASSERT(readBack != nullptr && readBack->validated());
+    Q_ASSERT(isSameContent(IRRootInstanceReader(*readBack), *inst));
+    f.close();
+}
+
+// reading a binary IR file in place through IRPagedInstance
+void testPagedInstance(){
+    ConsoleDiagnosticEmitter diag;
+    std::unique_ptr<IRRootType> ty(createSpeechIRType(diag));
+    std::unique_ptr<IRRootInstance> inst(createSpeechIRInstance(*ty, diag));
+    QFile f("test_paged.bin");
+    bool isOpened = f.open(QIODevice::WriteOnly);
+    Q_ASSERT(isOpened);
+    Q_UNUSED(isOpened)
+    bool isBinaryWritten = IRBinary::writeIRInstance(*inst, &f);
+    Q_ASSERT(isBinaryWritten);
+    Q_UNUSED(isBinaryWritten)
+    f.close();
+    std::unique_ptr<IRPagedInstance> paged(IRPagedInstance::open(*ty, diag, "test_paged.bin", 1));
+    Q_ASSERT(paged != nullptr && paged->isMemoryMapped());
+    Q_ASSERT(isSameContent(*paged, *inst));
+    Q_ASSERT(!paged->hasReadError());
+}
+
+void testCodegen(){
+    ConsoleDiagnosticEmitter diag;
+    std::unique_ptr<IRRootType> ty(createSpeechIRType(diag));
+    QString header;
+    bool isHeaderGenerated = IRCodegen::generateHeader(*ty, diag, header);
+    Q_ASSERT(isHeaderGenerated && header.contains(QStringLiteral("get_character()")));
+    Q_UNUSED(isHeaderGenerated)
+    Q_ASSERT(IRCodegen::getIdentifier(QStringLiteral("1st-class")) == QStringLiteral("N1st_class"));
+    Q_ASSERT(IRCodegen::getIdentifier(QStringLiteral("class")) == QStringLiteral("class_"));
+}
+
+// position of nodes among all children and among children of the same type
+void testNodeOrdinal(){
+    ConsoleDiagnosticEmitter diag;
+    std::unique_ptr<IRRootType> ty(createSpeechIRType(diag));
+    std::unique_ptr<IRRootInstance> inst(createSpeechIRInstance(*ty, diag));
+    IRRootInstanceReader reader(*inst);
+    Q_ASSERT(inst->getNode(0).getOrderInParent() == 0 && reader.getIndexUnderType(0) == 0);
+    Q_ASSERT(inst->getNode(1).getOrderInParent() == 0 && inst->getNode(1).getIndexUnderType() == 0);
+    Q_ASSERT(inst->getNode(2).getOrderInParent() == 1 && inst->getNode(2).getIndexUnderType() == 0);
+    Q_ASSERT(reader.getIndexUnderType(1) == 0 && reader.getIndexUnderType(2) == 0);
+    int speechLocalIndex = reader.getLocalTypeIndex(0, ty->getNodeTypeIndex("speech"));
+    Q_ASSERT(reader.getNumChildNodeUnderType(0, speechLocalIndex) == 1 && reader.getChildNodeIndex(0, speechLocalIndex, 0) == 1);
+    Q_UNUSED(speechLocalIndex)
+}
+
+void testGraft(){
+    ConsoleDiagnosticEmitter diag;
+    std::unique_ptr<IRRootType> ty(createSpeechIRType(diag));
+    std::unique_ptr<IRRootInstance> inst(createSpeechIRInstance(*ty, diag));
+    std::unique_ptr<IRRootInstance> speechOnly(createGraftedSpeech(*ty, diag));
+    int grafted = inst->graftSubtree(0, *speechOnly, diag);
+    Q_ASSERT(grafted == 3 && inst->validated() && inst->getNode(0).getNumChildNode() == 3);
+    Q_ASSERT(inst->getNode(grafted).getParameter(0) == QVariant("TB") && inst->getNode(grafted).getParentIndex() == 0);
+    Q_ASSERT(inst->getNode(grafted).getOrderInParent() == 2 && inst->getNode(grafted).getIndexUnderType() == 1);
+    Q_ASSERT(IRRootInstanceReader(*inst).getIndexUnderType(2) == 0);
+    Q_UNUSED(grafted)
+}
+
+// string parameters stored as UTF-8 must read back the same, including after revalidate() and graftSubtree()
+void testUtf8StringPool(){
+    ConsoleDiagnosticEmitter diag;
+    std::unique_ptr<IRRootType> ty(createSpeechIRType(diag));
+    std::unique_ptr<IRRootInstance> inst(createSpeechIRInstance(*ty, diag));
+    inst->setStringStorageMode(IRStringPool::StorageMode::Utf8);
+    Q_ASSERT(inst->getStringStorageMode() == IRStringPool::StorageMode::Utf8);
+    Q_ASSERT(inst->getNode(1).getParameter(2) == QVariant("Hello world!\nUmm.."));
+    Q_ASSERT(inst->getNode(1).getParameterAs<QString>(0) == QStringLiteral("TA"));
+
+    // edit, then revalidate
+    const QString edited = QString::fromUtf8("Edited \xc3\xbc");
+    inst->getNode(1).setParameter(2, edited);
+    bool isRevalidated = inst->revalidate(diag);
+    Q_ASSERT(isRevalidated);
+    Q_UNUSED(isRevalidated)
+    Q_ASSERT(inst->getNode(1).getParameter(2) == QVariant(edited));
+    Q_ASSERT(inst->getNode(1).getParameterAs<QString>(2) == edited);
+    Q_ASSERT(IRRootInstanceReader(*inst).getParameter(1, 2) == QVariant(edited));
+
+    // graft from an instance in Utf16 mode
+    std::unique_ptr<IRRootInstance> speechOnly(createGraftedSpeech(*ty, diag));
+    int grafted = inst->graftSubtree(0, *speechOnly, diag);
+    Q_ASSERT(grafted == 3 && inst->validated());
+    Q_ASSERT(inst->getNode(grafted).getParameter(0) == QVariant("TB"));
+    Q_ASSERT(inst->getNode(grafted).getParameterAs<QString>(2) == QStringLiteral("Grafted"));
+    Q_ASSERT(IRRootInstanceReader(*inst).getParameter(grafted, 2) == QVariant("Grafted"));
+    Q_ASSERT(inst->getStringPool().find(QStringLiteral("TB")) >= 0 && inst->getStringPool().find(QStringLiteral("TC")) < 0);
+
+    // converting back keeps all values
+    inst->setStringStorageMode(IRStringPool::StorageMode::Utf16);
+    Q_ASSERT(inst->getNode(grafted).getParameter(0) == QVariant("TB"));
+    Q_ASSERT(inst->getNode(1).getParameter(2) == QVariant(edited));
+    Q_UNUSED(grafted)
 }
 
 void testParser(){
@@ -95,7 +378,9 @@ void testParser(){
         ty->addNodeTypeDefinition(back);
         ty->setRootNodeType("root");
     }
-    Q_ASSERT(ty->validate(diag));
+    bool isTypeValidated = ty->validate(diag);
+    Q_ASSERT(isTypeValidated);
+    Q_UNUSED(isTypeValidated)
     ParserPolicy policy;
     policy.name = QStringLiteral("TestParser");
     ParserPolicy::MatchPairRecord quote;
@@ -159,7 +444,8 @@ void testParser(){
         policy.nodes.push_back(backNode);
     }
     QFile f("policy.txt");
-    Q_ASSERT(f.open(QIODevice::WriteOnly));
+    bool isOpened = f.open(QIODevice::WriteOnly);
+    Q_ASSERT(isOpened);
     QXmlStreamWriter xml(&f);
     xml.setAutoFormatting(true);
     xml.setAutoFormattingIndent(2);
@@ -176,12 +462,251 @@ void testParser(){
     tu.push_back(QStringRef(&l1));
     tu.push_back(QStringRef(&l2));
     tu.push_back(QStringRef(&l3));
-    IRRootInstance* ir = p->parse(tu, *ty, diag);
+    Parser::SessionMemoryUsage sessionUsage;
+    IRRootInstance* ir = p->parse(tu, *ty, diag, &sessionUsage);
     Q_ASSERT(ir != nullptr);
+    Q_ASSERT(sessionUsage.parserNodes > 0 && sessionUsage.getTotal() >= sessionUsage.parameters);
+    IRMemoryUsage irUsage = ir->getMemoryUsage();
+    Q_ASSERT(irUsage.perNodeType.size() == ty->getNumNodeType() && irUsage.nodeStructure > 0);
     f.setFileName("ir.txt");
-    Q_ASSERT(f.open(QIODevice::WriteOnly));
+    isOpened = f.open(QIODevice::WriteOnly);
+    Q_ASSERT(isOpened);
     XML::writeIRInstance(*ir, &f);
     f.close();
+    Q_UNUSED(isOpened)
+}
+
+// every text unit matches two parser nodes equally well; both report modes must describe the same positions
+void testParserAmbiguity(){
+    ConsoleDiagnosticEmitter diag;
+    std::unique_ptr<IRRootType> ty(createLineIRType(diag));
+    ParserNode lineA;
+    lineA.name = QStringLiteral("lineA");
+    lineA.patterns.push_back(createPattern(QStringLiteral("<text>")));
+    ParserNode lineB;
+    lineB.name = QStringLiteral("lineB");
+    lineB.patterns.push_back(createPattern(QStringLiteral("<text>")));
+    ParserPolicy policy = createLinePolicy(QList<ParserNode>{lineA, lineB});
+
+    std::unique_ptr<Parser> p(Parser::getParser(policy, *ty, diag));
+    Q_ASSERT(p != nullptr && p->getAmbiguityReportMode() == Parser::AmbiguityReportMode::Immediate);
+    QStringList lines{QStringLiteral("u1"), QStringLiteral("u2"), QStringLiteral("u3"), QStringLiteral("u4"), QStringLiteral("u5")};
+    QVector<QStringRef> tu;
+    for(const QString& line : lines){
+        tu.push_back(QStringRef(&line));
+    }
+    auto run = [&](TextRecordingDiagnosticEmitter& recorder)->void{
+        std::unique_ptr<IRRootInstance> ir(p->parse(tu, *ty, recorder));
+        Q_ASSERT(ir != nullptr && ir->getNumNode() == 1 + lines.size());
+    };
+
+    TextRecordingDiagnosticEmitter immediate;
+    run(immediate);
+    QStringList immediateWarnings = immediate.getRecords(Diag::Warn_Parser_Matching_Ambiguous);
+    Q_ASSERT(immediateWarnings.size() == lines.size());
+    Q_ASSERT(immediate.getRecords(Diag::Warn_Parser_Matching_AmbiguousSummary).isEmpty());
+
+    // the mode in the policy is what the parser starts with
+    const int sampleCount = 2;
+    policy.isAmbiguityAggregated = true;
+    policy.ambiguitySampleCount = sampleCount;
+    p.reset(Parser::getParser(policy, *ty, diag));
+    Q_ASSERT(p != nullptr && p->getAmbiguityReportMode() == Parser::AmbiguityReportMode::Aggregated);
+    TextRecordingDiagnosticEmitter aggregated;
+    run(aggregated);
+    // one summary for the only candidate set: [OccurrenceCount][SampleCount], then the samples in input order
+    QStringList summary = aggregated.getRecords(Diag::Warn_Parser_Matching_AmbiguousSummary);
+    Q_ASSERT(summary.size() == 1);
+    QStringList summaryArgs = summary.front().split(' ');
+    Q_ASSERT(summaryArgs.size() >= 3 && summaryArgs.at(1).toInt() == lines.size() && summaryArgs.at(2).toInt() == sampleCount);
+    Q_ASSERT(aggregated.getRecords(Diag::Warn_Parser_Matching_Ambiguous) == immediateWarnings.mid(0, sampleCount));
+    Q_UNUSED(summaryArgs)
+}
+
+// parallel pattern matching must give the same IR and diagnostics as serial matching, including ties between patterns
+void testParallelPatternMatch(){
+    ConsoleDiagnosticEmitter diag;
+    std::unique_ptr<IRRootType> ty(createLineIRType(diag));
+    ParserNode lineA;
+    lineA.name = QStringLiteral("lineA");
+    lineA.patterns.push_back(createPattern(QStringLiteral("x<text>")));
+    lineA.patterns.push_back(createPattern(QStringLiteral("<text>")));
+    ParserNode lineB;
+    lineB.name = QStringLiteral("lineB");
+    lineB.patterns.push_back(createPattern(QStringLiteral("<text>")));
+    lineB.patterns.push_back(createPattern(QStringLiteral("y<text>")));
+    lineB.patterns.push_back(createPattern(QStringLiteral("xy<text>")));
+    ParserNode lineC;
+    lineC.name = QStringLiteral("lineC");
+    lineC.patterns.push_back(createPattern(QStringLiteral("<text>;")));
+    std::unique_ptr<Parser> p(Parser::getParser(createLinePolicy(QList<ParserNode>{lineA, lineB, lineC}), *ty, diag));
+    Q_ASSERT(p != nullptr);
+
+    // "plain" ties between lineA and lineB with the same pattern, length and score
+    QStringList lines{QStringLiteral("x1"), QStringLiteral("y2"), QStringLiteral("xy3"), QStringLiteral("z4;"), QStringLiteral("plain")};
+    QVector<QStringRef> tu;
+    for(const QString& line : lines){
+        tu.push_back(QStringRef(&line));
+    }
+    auto run = [&](TextRecordingDiagnosticEmitter& recorder)->QByteArray{
+        std::unique_ptr<IRRootInstance> ir(p->parse(tu, *ty, recorder));
+        Q_ASSERT(ir != nullptr && ir->getNumNode() == 1 + lines.size());
+        QBuffer buffer;
+        buffer.open(QIODevice::WriteOnly);
+        XML::writeIRInstance(*ir, &buffer);
+        return buffer.data();
+    };
+
+    TextRecordingDiagnosticEmitter serialDiag;
+    QByteArray serialIR = run(serialDiag);
+    Q_ASSERT(serialDiag.contains(Diag::Warn_Parser_Matching_Ambiguous));
+    p->setParallelPatternMatch(1, 4);
+    TextRecordingDiagnosticEmitter parallelDiag;
+    QByteArray parallelIR = run(parallelDiag);
+    Q_ASSERT(serialIR == parallelIR && serialDiag.records == parallelDiag.records);
+    Q_UNUSED(serialIR)
+    Q_UNUSED(parallelIR)
+}
+
+// patterns are tried by descending score; the chosen pattern must be the same as trying them in original order
+void testPatternOrder(){
+    ConsoleDiagnosticEmitter diag;
+    std::unique_ptr<IRRootType> ty(createLineIRType(diag));
+    // on "vx", all patterns consume the whole text; pattern 1 wins by score, and over pattern 2 by original order
+    ParserNode line;
+    line.name = QStringLiteral("lineA");
+    line.patterns.push_back(createPattern(QStringLiteral("<text>"), 1));
+    line.patterns.push_back(createPattern(QStringLiteral("v<text>"), 5));
+    line.patterns.push_back(createPattern(QStringLiteral("<text>"), 5));
+    std::unique_ptr<Parser> p(Parser::getParser(createLinePolicy(QList<ParserNode>{line}), *ty, diag));
+    Q_ASSERT(p != nullptr);
+
+    QString text = QStringLiteral("vx");
+    QVector<QStringRef> tu;
+    tu.push_back(QStringRef(&text));
+    std::unique_ptr<IRRootInstance> ir(p->parse(tu, *ty, diag));
+    Q_ASSERT(ir != nullptr && ir->getNumNode() == 2);
+    const IRRootInstance& result = *ir;
+    Q_ASSERT(result.getNode(1).getParameterAs<QString>(0) == QStringLiteral("x"));
+}
+
+// lookup of nodes by type and of children by unique or indexed key, through the expressions and ExecutionContext
+void testKeyedLookup(){
+    ConsoleDiagnosticEmitter diag;
+    // the IR type is read from bundle JSON to cover the "Indexed" flag
+    QByteArray json = QByteArrayLiteral(
+        "{\"IRSet\": [{\"Name\": \"keyed\", \"Root\": \"root\", \"Node\": ["
+        "  {\"Name\": \"root\", \"Child\": [\"item\"]},"
+        "  {\"Name\": \"item\", \"Parameter\": ["
+        "    {\"Name\": \"name\", \"Type\": \"String\", \"Indexed\": true},"
+        "    {\"Name\": \"id\", \"Type\": \"Int\", \"Unique\": true},"
+        "    {\"Name\": \"tag\", \"Type\": \"String\"}]}]}]}");
+    std::unique_ptr<Bundle> bundle(Bundle::fromJson(json, diag));
+    Q_ASSERT(bundle != nullptr && bundle->getNumIR() == 1);
+    const IRRootType& ty = bundle->getIR(0);
+    int itemTyIndex = ty.getNodeTypeIndex(QStringLiteral("item"));
+    const IRNodeType& itemTy = ty.getNodeType(itemTyIndex);
+    int nameParam = itemTy.getParameterIndex(QStringLiteral("name"));
+    Q_ASSERT(itemTy.getParameterIsIndexed(nameParam) && !itemTy.getParameterIsUnique(nameParam));
+    Q_ASSERT(!itemTy.getParameterIsIndexed(itemTy.getParameterIndex(QStringLiteral("tag"))));
+
+    // items (node 1 to 5) are named a, dup, b, dup, dup with id 10 to 14
+    const QStringList names{QStringLiteral("a"), QStringLiteral("dup"), QStringLiteral("b"), QStringLiteral("dup"), QStringLiteral("dup")};
+    IRBuilder builder(ty, 1 + names.size());
+    builder.addNode(ty.getNodeTypeIndex(QStringLiteral("root")), -1);
+    for(int i = 0; i < names.size(); ++i){
+        int item = builder.addNode(itemTyIndex, 0);
+        builder.setParameters(item, QList<IRParameterValue>{IRParameterValue(names.at(i)), IRParameterValue(static_cast<qint64>(10 + i)), IRParameterValue(QString())});
+    }
+    std::unique_ptr<IRRootInstance> inst(builder.finish());
+    bool isValidated = inst->validate(diag);
+    Q_ASSERT(isValidated);
+    const QString missingKey = QStringLiteral("missing");
+    Q_ASSERT(inst->getStringPool().find(missingKey) < 0);
+
+    Task t(ty);
+    Function f(QStringLiteral("probe"));
+    int ordinalExpr = f.addExpression(new LiteralExpression(static_cast<qint64>(0)));
+    int rootExpr = f.addExpression(new NodePtrExpression(NodePtrExpression::NodeSpecifier::RootNode));
+    int nameKeyExpr = f.addExpression(new LiteralExpression(QStringLiteral("dup")));
+    int idKeyExpr = f.addExpression(new LiteralExpression(static_cast<qint64>(0)));
+    int nodeOfTypeExpr = f.addExpression(new NodeOfTypeExpression(QStringLiteral("item"), ordinalExpr));
+    int countOfTypeExpr = f.addExpression(new NodeCountOfTypeExpression(QStringLiteral("item")));
+    int childByNameExpr = f.addExpression(new ChildNodeWithKeyExpression(QStringLiteral("item"), QStringLiteral("name"), ValueType::String, rootExpr, nameKeyExpr, ordinalExpr));
+    int countByNameExpr = f.addExpression(new ChildCountWithKeyExpression(QStringLiteral("item"), QStringLiteral("name"), ValueType::String, rootExpr, nameKeyExpr));
+    int childByIdExpr = f.addExpression(new ChildNodeWithKeyExpression(QStringLiteral("item"), QStringLiteral("id"), ValueType::Int64, rootExpr, idKeyExpr, ordinalExpr));
+    int countByTagExpr = f.addExpression(new ChildCountWithKeyExpression(QStringLiteral("item"), QStringLiteral("tag"), ValueType::String, rootExpr, nameKeyExpr));
+
+    // each result is a node index (-1 for null pointer) or a count; -2 if evaluation fails
+    QVector<qint64> results;
+    auto probe = [&](ExecutionContext& ctx)->void{
+        NodePtrType rootPtr;
+        ctx.getRootNodePtr(rootPtr);
+        QVariant root = QVariant::fromValue(rootPtr);
+        auto helper_evaluate = [&](int exprIndex, const QList<QVariant>& args)->void{
+            // the probe function is the only function in the task
+            QVariant value;
+            if(!ctx.getTask().getFunction(0).getExpression(exprIndex)->evaluate(ctx, value, args)){
+                results.push_back(-2);
+            }else if(value.canConvert<NodePtrType>()){
+                results.push_back(value.value<NodePtrType>().nodeIndex);
+            }else{
+                results.push_back(value.toLongLong());
+            }
+        };
+        helper_evaluate(countOfTypeExpr, QList<QVariant>());
+        for(qint64 ordinal : {0, 4, 5, -1}){
+            helper_evaluate(nodeOfTypeExpr, QList<QVariant>{ordinal});
+        }
+        for(const QString& key : {QStringLiteral("dup"), QStringLiteral("a"), missingKey}){
+            helper_evaluate(countByNameExpr, QList<QVariant>{root, key});
+        }
+        for(qint64 ordinal : {0, 1, 2, 3}){
+            helper_evaluate(childByNameExpr, QList<QVariant>{root, QStringLiteral("dup"), ordinal});
+        }
+        helper_evaluate(childByNameExpr, QList<QVariant>{root, missingKey, 0ll});
+        helper_evaluate(childByIdExpr, QList<QVariant>{root, 13ll, 0ll});
+        helper_evaluate(childByIdExpr, QList<QVariant>{root, 99ll, 0ll});
+        helper_evaluate(countByTagExpr, QList<QVariant>{root, QString()});
+    };
+    OutputStatement stmt;
+    stmt.exprIndex = f.addExpression(new ProbeExpression(probe));
+    f.addStatement(stmt);
+    t.addFunction(f);
+    t.setNodeCallback(ty.getNodeTypeIndex(QStringLiteral("root")), QStringLiteral("probe"), Task::CallbackType::OnEntry);
+    bool isTaskValidated = t.validate(diag);
+    Q_ASSERT(isTaskValidated);
+    Q_UNUSED(isTaskValidated)
+
+    TextRecordingDiagnosticEmitter recorder;
+    TextOutputHandler handler("utf-8");
+    {
+        std::unique_ptr<ExecutionContext> ctx(new ExecutionContext(t, *inst, recorder, handler));
+        ctx->continueExecution();
+    }
+    const QVector<qint64> expected{
+        5,                  // NodeCountOfType
+        1, 5, -1, -1,       // NodeOfType; out of range ordinals give null pointer
+        3, 1, 0,            // ChildCountWithKey; a key not in the string pool matches nothing
+        2, 4, 5, -1,        // ChildNodeWithKey on duplicated keys, in document order
+        -1,                 // ChildNodeWithKey with a key not in the string pool
+        4, -1,              // ChildNodeWithKey on the unique Int64 parameter (id 13, 99)
+        -2                  // "tag" is neither unique nor indexed
+    };
+    Q_ASSERT(results == expected);
+    Q_ASSERT(recorder.contains(Diag::Error_Exec_BadTraverse_ParameterNotIndexed));
+
+    // the secondary index follows parameter edits
+    inst->getNode(4).setParameter(nameParam, QStringLiteral("b"));
+    isValidated = inst->revalidate(diag);
+    Q_ASSERT(isValidated);
+    Q_UNUSED(isValidated)
+    IRRootInstanceReader reader(*inst);
+    Q_ASSERT(reader.getNumChildNodeWithKey(0, 0, nameParam, QVariant(QStringLiteral("dup"))) == 2);
+    Q_ASSERT(reader.getChildNodeIndexWithKey(0, 0, nameParam, QVariant(QStringLiteral("dup")), 1) == 5);
+    Q_ASSERT(reader.getChildNodeIndexWithKey(0, 0, nameParam, QVariant(QStringLiteral("b")), 1) == 4);
+    Q_UNUSED(reader)
+    Q_UNUSED(expected)
 }
 
 void bundleTest(){
@@ -232,7 +757,378 @@ void bundleTest(){
     qDebug()<< handler.getResult();
 }
 
+// build, validate and do an XML round trip of a million-deep chain and a million-wide fan-out of the same type
+// time and memory per stage are printed, so the cost of depth can be compared with the cost of width
+void stressTestEntry(){
+    ConsoleDiagnosticEmitter diag;
+    IRRootType ty("stress");
+    {
+        IRNodeType item("item");
+        item.addParameter("value", ValueType::Int64, false);
+        item.addChildNode("item");
+        ty.addNodeTypeDefinition(item);
+        ty.setRootNodeType("item");
+    }
+    // no side effect in Q_ASSERT; this is meant to be run in release build
+    bool isTypeValidated = ty.validate(diag);
+    Q_ASSERT(isTypeValidated);
+    Q_UNUSED(isTypeValidated)
+    const int numNode = 1000000;
+    for(int shape = 0; shape < 2; ++shape){
+        bool isDeep = (shape == 0);
+        QElapsedTimer timer;
+        timer.start();
+        IRBuilder builder(ty, numNode);
+        for(int i = 0; i < numNode; ++i){
+            int nodeIndex = builder.addNode(0, (i == 0)? -1 : (isDeep? i-1 : 0));
+            builder.setParameter(nodeIndex, 0, static_cast<qint64>(i));
+        }
+        std::unique_ptr<IRRootInstance> inst(builder.finish());
+        qint64 buildTime = timer.restart();
+        // also covers worker threads, which have smaller stacks than the main thread
+        inst->setParallelValidation(numNode / 4);
+        bool isValidated = inst->validate(diag);
+        Q_ASSERT(isValidated);
+        Q_UNUSED(isValidated)
+        qint64 validateTime = timer.restart();
+        QBuffer buffer;
+        buffer.open(QIODevice::ReadWrite);
+        XML::writeIRInstance(*inst, &buffer);
+        qint64 writeTime = timer.restart();
+        buffer.seek(0);
+        std::unique_ptr<IRRootInstance> readBack(XML::readIRInstance(ty, diag, &buffer));
+        Q_ASSERT(readBack && readBack->getNumNode() == numNode);
+        qint64 readTime = timer.restart();
+        qDebug() << (isDeep? "deep:" : "wide:") << numNode << "nodes;"
+                 << "build" << buildTime << "ms, validate" << validateTime << "ms, XML write" << writeTime
+                 << "ms (" << buffer.size() << "bytes), XML read" << readTime << "ms;"
+                 << "IR memory" << inst->getMemoryUsage().getTotal() << "bytes";
+    }
+}
+
+// validate an IR with errors in many subtrees serially and in parallel; diagnostics must be the same
+void testParallelValidation(){
+    ConsoleDiagnosticEmitter diag;
+    IRRootType ty("parallel");
+    {
+        IRNodeType item("item");
+        item.addParameter("key", ValueType::Int64, true);
+        item.addChildNode("item");
+        ty.addNodeTypeDefinition(item);
+        ty.setRootNodeType("item");
+    }
+    bool isTypeValidated = ty.validate(diag);
+    Q_ASSERT(isTypeValidated);
+    Q_UNUSED(isTypeValidated)
+    // 64 subtrees under root, each a node with 32 children; some children have duplicated keys
+    const int numSubtree = 64;
+    const int numLeaf = 32;
+    IRBuilder builder(ty, 1 + numSubtree * (numLeaf + 1));
+    builder.addNode(0, -1);
+    builder.setParameter(0, 0, static_cast<qint64>(-1));
+    QVector<int> badNodes;
+    for(int i = 0; i < numSubtree; ++i){
+        int subtree = builder.addNode(0, 0);
+        builder.setParameter(subtree, 0, static_cast<qint64>(i));
+        for(int j = 0; j < numLeaf; ++j){
+            int leaf = builder.addNode(0, subtree);
+            builder.setParameter(leaf, 0, static_cast<qint64>((i % 3 == 0 && j == 1)? 0 : j));
+            if(i % 5 == 0 && j == 2){
+                badNodes.push_back(leaf);
+            }
+        }
+    }
+    std::unique_ptr<IRRootInstance> inst(builder.finish());
+    for(int nodeIndex : badNodes){
+        // wrong parameter count; recorded in badParameterTypes
+        inst->getNode(nodeIndex).setParameters(QList<QVariant>());
+    }
+
+    TextRecordingDiagnosticEmitter serialDiag;
+    bool isSerialValidated = inst->validate(serialDiag);
+    // share storage with a snapshot, so that a detach on worker threads would race
+    std::unique_ptr<IRRootInstance> snapshot(inst->createSnapshot());
+    inst->setParallelValidation(1, 4);
+    TextRecordingDiagnosticEmitter parallelDiag;
+    bool isParallelValidated = inst->validate(parallelDiag);
+    Q_ASSERT(!isSerialValidated && !isParallelValidated);
+    Q_ASSERT(!serialDiag.records.isEmpty() && serialDiag.records == parallelDiag.records);
+    Q_UNUSED(isSerialValidated)
+    Q_UNUSED(isParallelValidated)
+}
+
+// duplicated keys of a unique parameter are reported in document order, not in key order
+void testUniqueKeyReportOrder(){
+    ConsoleDiagnosticEmitter diag;
+    IRRootType ty("unique");
+    {
+        IRNodeType item("item");
+        item.addParameter("key", ValueType::Int64, true);
+        item.addChildNode("item");
+        ty.addNodeTypeDefinition(item);
+        ty.setRootNodeType("item");
+    }
+    bool isTypeValidated = ty.validate(diag);
+    Q_ASSERT(isTypeValidated);
+    Q_UNUSED(isTypeValidated)
+
+    // children 1 to 5 have keys 5, 1, 5, 1, 1
+    const qint64 keys[] = {5, 1, 5, 1, 1};
+    IRBuilder builder(ty, 6);
+    builder.addNode(0, -1);
+    builder.setParameter(0, 0, static_cast<qint64>(-1));
+    for(qint64 key : keys){
+        int child = builder.addNode(0, 0);
+        builder.setParameter(child, 0, key);
+    }
+    std::unique_ptr<IRRootInstance> inst(builder.finish());
+    TextRecordingDiagnosticEmitter recorder;
+    bool isValidated = inst->validate(recorder);
+    Q_ASSERT(!isValidated);
+    Q_UNUSED(isValidated)
+    QString prefix = QString::number(static_cast<int>(Diag::Error_IR_BadTree_BrokenConstraint_ParamNotUnique));
+    QStringList expected{
+        prefix + QStringLiteral(" item key 1 3 5"),
+        prefix + QStringLiteral(" item key 2 4 1"),
+        prefix + QStringLiteral(" item key 2 5 1")
+    };
+    Q_ASSERT(recorder.getRecords(Diag::Error_IR_BadTree_BrokenConstraint_ParamNotUnique) == expected);
+    Q_UNUSED(expected)
+}
+
+// nodes whose parameters are never set, or set with the wrong type, must fail validation
+void testParameterValidation(){
+    ConsoleDiagnosticEmitter diag;
+    IRRootType ty("param");
+    {
+        IRNodeType item("item");
+        item.addParameter("text", ValueType::String, false);
+        item.addParameter("value", ValueType::Int64, false);
+        item.addChildNode("item");
+        ty.addNodeTypeDefinition(item);
+        ty.setRootNodeType("item");
+    }
+    bool isTypeValidated = ty.validate(diag);
+    Q_ASSERT(isTypeValidated);
+    Q_UNUSED(isTypeValidated)
+
+    IRBuilder builder(ty, 2);
+    builder.addNode(0, -1);
+    builder.setParameters(0, QList<IRParameterValue>{IRParameterValue(QStringLiteral("root")), IRParameterValue(static_cast<qint64>(0))});
+    int child = builder.addNode(0, 0);
+    std::unique_ptr<IRRootInstance> inst(builder.finish());
+    {
+        // parameters of child are not set
+        TextRecordingDiagnosticEmitter recorder;
+        bool isValidated = inst->validate(recorder);
+        Q_ASSERT(!isValidated && recorder.contains(Diag::Error_IR_BadParameterList_Count));
+        Q_UNUSED(isValidated)
+    }
+    {
+        // only one of the parameters is set, and with the wrong type; nothing is written
+        inst->getNode(child).setParameter(0, static_cast<qint64>(1));
+        TextRecordingDiagnosticEmitter recorder;
+        bool isValidated = inst->validate(recorder);
+        Q_ASSERT(!isValidated && recorder.contains(Diag::Error_IR_BadParameterList_Type));
+        Q_ASSERT(inst->getNode(child).getParameterAs<QString>(0).isEmpty());
+        Q_UNUSED(isValidated)
+    }
+    {
+        inst->getNode(child).setParameter(0, QStringLiteral("child"));
+        inst->getNode(child).setParameter(1, static_cast<qint64>(1));
+        bool isValidated = inst->validate(diag);
+        Q_ASSERT(isValidated);
+        Q_UNUSED(isValidated)
+    }
+}
+
+// run a subtree-local task before and after an edit with ExecutionCache; output must match a run without cache
+void testExecutionCache(){
+    ConsoleDiagnosticEmitter diag;
+    IRRootType ty("cache");
+    {
+        IRNodeType item("item");
+        item.addParameter("text", ValueType::String, false);
+        item.addChildNode("item");
+        ty.addNodeTypeDefinition(item);
+        ty.setRootNodeType("item");
+    }
+    bool isTypeValidated = ty.validate(diag);
+    Q_ASSERT(isTypeValidated);
+    Q_UNUSED(isTypeValidated)
+
+    // nodes not in pre-order are rejected, since subtrees would not be contiguous
+    {
+        IRBuilder builder(ty, 5);
+        builder.addNode(0, -1);
+        builder.addNode(0, 0);
+        builder.addNode(0, 0);
+        builder.addNode(0, 1);
+        builder.addNode(0, 2);
+        std::unique_ptr<IRRootInstance> breadthFirst(builder.finish());
+        RecordingDiagnosticEmitter silent;
+        bool isBreadthFirstValidated = breadthFirst->validate(silent);
+        Q_ASSERT(!isBreadthFirstValidated);
+        Q_UNUSED(isBreadthFirstValidated)
+    }
+
+    // root with 4 subtrees of 12 nodes; subtree 0 and 2 have the same content
+    IRBuilder builder(ty, 1 + 4 * 12);
+    builder.addNode(0, -1);
+    builder.setParameter(0, 0, QStringLiteral("root"));
+    int editedNode = -1;
+    for(int i = 0; i < 4; ++i){
+        int subtree = builder.addNode(0, 0);
+        builder.setParameter(subtree, 0, QStringLiteral("s%1").arg(i % 2));
+        for(int j = 0; j < 11; ++j){
+            int leaf = builder.addNode(0, subtree);
+            builder.setParameter(leaf, 0, QStringLiteral("s%1.%2").arg(i % 2).arg(j));
+            if(i == 3 && j == 5){
+                editedNode = leaf;
+            }
+        }
+    }
+    std::unique_ptr<IRRootInstance> inst(builder.finish());
+    inst->setSubtreeHashEnabled(true);
+    bool isValidated = inst->validate(diag);
+    Q_ASSERT(isValidated && inst->hasSubtreeHash());
+
+    // callbacks executed in a run; callbacks in reused subtrees are not
+    int numCallback = 0;
+    Task t(ty);
+    {
+        Function f(QStringLiteral("emit"));
+        f.addExternVariable(QStringLiteral("text"), ValueType::String);
+        OutputStatement stmt;
+        stmt.exprIndex = f.addExpression(new VariableReadExpression(ValueType::String, QStringLiteral("text")));
+        f.addStatement(stmt);
+        OutputStatement countStmt;
+        countStmt.exprIndex = f.addExpression(new ProbeExpression([&numCallback](ExecutionContext&)->void{numCallback += 1;}, true));
+        f.addStatement(countStmt);
+        t.addFunction(f);
+        t.setNodeCallback(0, QStringLiteral("emit"), Task::CallbackType::OnEntry);
+    }
+    bool isTaskValidated = t.validate(diag);
+    Q_ASSERT(isTaskValidated && t.isSubtreeLocal());
+    Q_UNUSED(isTaskValidated)
+
+    ExecutionCache cache;
+    auto run = [&](ExecutionCache* cachePtr)->QByteArray{
+        numCallback = 0;
+        TextOutputHandler handler("utf-8");
+        std::unique_ptr<ExecutionContext> ctx(new ExecutionContext(t, *inst, diag, handler));
+        ctx->setExecutionCache(cachePtr);
+        ctx->continueExecution();
+        return handler.getResult();
+    };
+    const int numNode = inst->getNumNode();
+    QByteArray firstUncached = run(nullptr);
+    Q_ASSERT(numCallback == numNode);
+    // subtrees 2 and 3 are replayed from subtrees 0 and 1 in the same run
+    QByteArray firstCached = run(&cache);
+    Q_ASSERT(firstCached == firstUncached && cache.getNumEntry() > 0 && numCallback == numNode - 2 * 12);
+
+    inst->getNode(editedNode).setParameter(0, QStringLiteral("edited"));
+    isValidated = inst->revalidate(diag);
+    Q_ASSERT(isValidated && inst->hasSubtreeHash());
+    Q_UNUSED(isValidated)
+    // only the root and the edited subtree are executed
+    QByteArray secondCached = run(&cache);
+    Q_ASSERT(numCallback == 1 + 12);
+    QByteArray secondUncached = run(nullptr);
+    Q_ASSERT(secondCached == secondUncached && secondCached != firstCached && secondCached.contains("edited"));
+
+    // validating the task again gives it a new generation, so the cache is dropped instead of reused;
+    // only subtree 2 is replayed now, from subtree 0
+    quint64 generation = t.getGeneration();
+    isTaskValidated = t.validate(diag);
+    Q_ASSERT(isTaskValidated && t.getGeneration() != generation);
+    QByteArray thirdCached = run(&cache);
+    Q_ASSERT(thirdCached == secondUncached && numCallback == numNode - 12);
+    Q_UNUSED(firstCached)
+    Q_UNUSED(firstUncached)
+    Q_UNUSED(secondUncached)
+    Q_UNUSED(thirdCached)
+    Q_UNUSED(generation)
+    Q_UNUSED(numNode)
+}
+
+// edit a snapshot of a large IR; the source must be unchanged and storage not written to must stay shared
+void testSnapshotSharing(){
+    ConsoleDiagnosticEmitter diag;
+    IRRootType ty("snapshot");
+    {
+        IRNodeType item("item");
+        item.addParameter("text", ValueType::String, false);
+        item.addParameter("value", ValueType::Int64, false);
+        item.addChildNode("item");
+        ty.addNodeTypeDefinition(item);
+        ty.setRootNodeType("item");
+    }
+    bool isTypeValidated = ty.validate(diag);
+    Q_ASSERT(isTypeValidated);
+    Q_UNUSED(isTypeValidated)
+
+    // enough nodes for several chunks; node index and row are the same since there is one node type
+    const int numNode = 4 * ChunkedVector<int>::ChunkSize;
+    IRBuilder builder(ty, numNode);
+    builder.addNode(0, -1);
+    builder.setParameters(0, QList<IRParameterValue>{IRParameterValue(QStringLiteral("root")), IRParameterValue(static_cast<qint64>(0))});
+    for(int i = 1; i < numNode; ++i){
+        builder.addNode(0, 0);
+        builder.setParameters(i, QList<IRParameterValue>{IRParameterValue(QStringLiteral("n%1").arg(i)), IRParameterValue(static_cast<qint64>(i))});
+    }
+    std::unique_ptr<IRRootInstance> inst(builder.finish());
+    bool isValidated = inst->validate(diag);
+    Q_ASSERT(isValidated);
+
+    std::unique_ptr<IRRootInstance> snapshot(inst->createSnapshot());
+    const int editedNode = 1;
+    const int farNode = numNode - 1;
+    snapshot->getNode(editedNode).setParameter(0, QStringLiteral("edited"));
+    snapshot->getNode(editedNode).setParameter(1, static_cast<qint64>(-1));
+    isValidated = snapshot->revalidate(diag);
+    Q_ASSERT(isValidated);
+    Q_UNUSED(isValidated)
+
+    const IRRootInstance& source = *inst;
+    const IRRootInstance& edited = *snapshot;
+    Q_ASSERT(edited.getNode(editedNode).getParameterAs<QString>(0) == QStringLiteral("edited"));
+    Q_ASSERT(edited.getNode(editedNode).getParameterAs<qint64>(1) == -1);
+    Q_ASSERT(source.getNode(editedNode).getParameterAs<QString>(0) == QStringLiteral("n1"));
+    Q_ASSERT(source.getNode(editedNode).getParameterAs<qint64>(1) == 1);
+    Q_ASSERT(source.getStringPool().find(QStringLiteral("edited")) < 0);
+
+    Q_ASSERT(!edited.isParameterStorageShared(source, editedNode, 0) && !edited.isParameterStorageShared(source, editedNode, 1));
+    Q_ASSERT(edited.isParameterStorageShared(source, farNode, 0) && edited.isParameterStorageShared(source, farNode, 1));
+    const ChunkedVector<int>& sourceNodes = source.getNodeListOfType(0);
+    const ChunkedVector<int>& editedNodes = edited.getNodeListOfType(0);
+    Q_ASSERT(sourceNodes.getNumChunk() == 4);
+    for(int i = 0, n = sourceNodes.getNumChunk(); i < n; ++i){
+        Q_ASSERT(editedNodes.isChunkSharedWith(sourceNodes, i));
+    }
+    Q_UNUSED(farNode)
+    Q_UNUSED(sourceNodes)
+    Q_UNUSED(editedNodes)
+}
+
 void testerEntry(){
+    testWriteXML();
+    testBinaryRoundTrip();
+    testPagedInstance();
+    testCodegen();
+    testNodeOrdinal();
+    testGraft();
+    testUtf8StringPool();
     testParser();
+    testParserAmbiguity();
+    testParallelPatternMatch();
+    testPatternOrder();
+    testParameterValidation();
+    testParallelValidation();
+    testUniqueKeyReportOrder();
+    testSnapshotSharing();
+    testExecutionCache();
+    testKeyedLookup();
     return;
 }
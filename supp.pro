@@ -18,8 +18,13 @@ DEFINES += QT_DEPRECATED_WARNINGS
 SOURCES += \
     core/Bundle.cpp \
     core/DiagnosticEmitter.cpp \
+    core/ExecutionCache.cpp \
     core/ExecutionContext.cpp \
     core/Expression.cpp \
+    core/IR.cpp \
+    core/IRBinary.cpp \
+    core/IRBuilder.cpp \
+    core/IRCodegen.cpp \
     core/IRValidate.cpp \
     core/OutputHandler.cpp \
     core/Parser.cpp \
@@ -39,11 +44,18 @@ HEADERS += \
     core/XML.h \
     ui/PlainTextDocumentWidget.h \
     util/ADT.h \
+    util/ChunkedVector.h \
+    util/MemoryUsage.h \
     core/Bundle.h \
+    core/ExecutionCache.h \
     core/ExecutionContext.h \
     core/Expression.h \
     core/IR.h \
+    core/IRBinary.h \
+    core/IRBuilder.h \
+    core/IRCodegen.h \
     core/OutputHandlerBase.h \
+    core/SymbolTable.h \
     core/Task.h \
     core/Value.h \
     core/DiagnosticEmitter.h \
@@ -15,6 +15,12 @@ int main(int argc, char *argv[])
     QCommandLineParser parser;
     QCommandLineOption testOption(QStringList() << "t" << "test", QCoreApplication::tr("Run self test"));
     parser.addOption(testOption);
+    QCommandLineOption stressTestOption(QStringList() << "stress-test", QCoreApplication::tr("Run stress test on very deep and very wide IR trees"));
+    parser.addOption(stressTestOption);
+    QCommandLineOption irHeaderOption(QStringList() << "ir-header", QCoreApplication::tr("Generate C++ accessor headers for IR types in <bundle>"), "bundle");
+    parser.addOption(irHeaderOption);
+    QCommandLineOption outputDirOption(QStringList() << "o" << "output-dir", QCoreApplication::tr("Directory for generated files"), "directory", ".");
+    parser.addOption(outputDirOption);
     parser.process(a);
 
     bool isTest = parser.isSet(testOption);
@@ -23,6 +29,14 @@ int main(int argc, char *argv[])
         testerEntry();
         return 0;
     }
+    if(parser.isSet(stressTestOption)){
+        stressTestEntry();
+        return 0;
+    }
+
+    if(parser.isSet(irHeaderOption)){
+        return generateIRHeaderEntry(parser.value(irHeaderOption), parser.value(outputDirOption));
+    }
 
     MainWindow w;
     w.show();
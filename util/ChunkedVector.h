@@ -0,0 +1,143 @@
+#ifndef CHUNKEDVECTOR_H
+#define CHUNKEDVECTOR_H
+
+#include <QVector>
+#include <QtGlobal>
+
+#include <cstddef>
+#include <iterator>
+
+// a vector stored in fixed-size chunks, each an implicitly shared QVector
+// copying it only shares the chunks; a write detaches the chunk it goes to (and the chunk directory, which is
+// one pointer per chunk), so two copies that are edited in few places still share all other chunks
+// element access has one more indirection than QVector; data is not contiguous across chunks
+template<typename T, int ChunkShift = 10>
+class ChunkedVector{
+public:
+    enum : int{
+        ChunkSize = 1 << ChunkShift
+    };
+
+    class const_iterator{
+    public:
+        typedef std::random_access_iterator_tag iterator_category;
+        typedef T value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const T* pointer;
+        typedef const T& reference;
+
+        const_iterator(): vec(nullptr), index(0){}
+        const_iterator(const ChunkedVector* vec, int index): vec(vec), index(index){}
+        const T& operator*() const {return vec->at(index);}
+        const T* operator->() const {return &vec->at(index);}
+        const T& operator[](difference_type offset) const {return vec->at(index + static_cast<int>(offset));}
+        const_iterator& operator++(){++index; return *this;}
+        const_iterator operator++(int){const_iterator result(*this); ++index; return result;}
+        const_iterator& operator--(){--index; return *this;}
+        const_iterator operator--(int){const_iterator result(*this); --index; return result;}
+        const_iterator& operator+=(difference_type offset){index += static_cast<int>(offset); return *this;}
+        const_iterator& operator-=(difference_type offset){index -= static_cast<int>(offset); return *this;}
+        const_iterator operator+(difference_type offset) const {return const_iterator(vec, index + static_cast<int>(offset));}
+        const_iterator operator-(difference_type offset) const {return const_iterator(vec, index - static_cast<int>(offset));}
+        difference_type operator-(const const_iterator& rhs) const {return index - rhs.index;}
+        bool operator==(const const_iterator& rhs) const {return index == rhs.index;}
+        bool operator!=(const const_iterator& rhs) const {return index != rhs.index;}
+        bool operator<(const const_iterator& rhs) const {return index < rhs.index;}
+        bool operator>(const const_iterator& rhs) const {return index > rhs.index;}
+        bool operator<=(const const_iterator& rhs) const {return index <= rhs.index;}
+        bool operator>=(const const_iterator& rhs) const {return index >= rhs.index;}
+    private:
+        const ChunkedVector* vec;
+        int index;
+    };
+
+    ChunkedVector(){}
+    ChunkedVector(int size, const T& value){fill(value, size);}
+
+    int size() const {return count;}
+    bool isEmpty() const {return count == 0;}
+
+    const T& at(int index) const {
+        Q_ASSERT(index >= 0 && index < count);
+        return chunks.at(index >> ChunkShift).at(index & ChunkMask);
+    }
+    const T& operator[](int index) const {return at(index);}
+    // detaches only the chunk holding the element
+    T& operator[](int index){
+        Q_ASSERT(index >= 0 && index < count);
+        return chunks[index >> ChunkShift][index & ChunkMask];
+    }
+    const T& back() const {return at(count - 1);}
+
+    const_iterator begin() const {return const_iterator(this, 0);}
+    const_iterator end() const {return const_iterator(this, count);}
+    const_iterator constBegin() const {return begin();}
+    const_iterator constEnd() const {return end();}
+
+    void reserve(int size){
+        chunks.reserve((size + ChunkMask) >> ChunkShift);
+    }
+    void push_back(const T& value){
+        if((count & ChunkMask) == 0){
+            chunks.push_back(QVector<T>());
+        }
+        chunks.last().push_back(value);
+        count += 1;
+    }
+    // append size elements from a contiguous array
+    void append(const T* data, int size){
+        while(size > 0){
+            if((count & ChunkMask) == 0){
+                chunks.push_back(QVector<T>());
+            }
+            QVector<T>& chunk = chunks.last();
+            int n = static_cast<int>(ChunkSize) - chunk.size();
+            if(n > size){
+                n = size;
+            }
+            chunk.reserve(chunk.size() + n);
+            for(int i = 0; i < n; ++i){
+                chunk.push_back(data[i]);
+            }
+            data += n;
+            size -= n;
+            count += n;
+        }
+    }
+    // set size elements, all to value
+    void fill(const T& value, int size){
+        clear();
+        reserve(size);
+        for(int start = 0; start < size; start += ChunkSize){
+            int n = size - start;
+            chunks.push_back(QVector<T>((n < ChunkSize)? n : static_cast<int>(ChunkSize), value));
+        }
+        count = size;
+    }
+    void clear(){
+        chunks.clear();
+        count = 0;
+    }
+    void swap(ChunkedVector& other){
+        chunks.swap(other.chunks);
+        qSwap(count, other.count);
+    }
+
+    // chunks, for bulk copy; chunk i holds elements [i * ChunkSize, i * ChunkSize + getChunk(i).size())
+    int getNumChunk() const {return chunks.size();}
+    const QVector<T>& getChunk(int chunkIndex) const {return chunks.at(chunkIndex);}
+    // whether the given chunk is the same (shared) storage in both vectors
+    bool isChunkSharedWith(const ChunkedVector& other, int chunkIndex) const {
+        return chunkIndex < chunks.size() && chunkIndex < other.chunks.size()
+            && chunks.at(chunkIndex).constData() == other.chunks.at(chunkIndex).constData();
+    }
+
+private:
+    enum : int{
+        ChunkMask = ChunkSize - 1
+    };
+    QVector<QVector<T>> chunks;
+    int count = 0;
+};
+
+#endif // CHUNKEDVECTOR_H
@@ -0,0 +1,94 @@
+#ifndef MEMORYUSAGE_H
+#define MEMORYUSAGE_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <QVariant>
+#include <QVector>
+
+#include "util/ChunkedVector.h"
+
+// estimates of heap memory owned by Qt containers, for getMemoryUsage() reports
+// the container object itself is not included; the caller counts it as part of the enclosing object
+// implicitly shared data is counted by every owner, so reports of objects sharing data add up to more than what is used
+namespace MemoryUsage{
+
+inline qint64 ofString(const QString& str)
+{
+    // the shared null / empty string has no allocation
+    if(str.capacity() == 0)
+        return 0;
+    return static_cast<qint64>(sizeof(QArrayData)) + static_cast<qint64>(str.capacity() + 1) * static_cast<qint64>(sizeof(QChar));
+}
+
+inline qint64 ofByteArray(const QByteArray& data)
+{
+    if(data.capacity() == 0)
+        return 0;
+    return static_cast<qint64>(sizeof(QArrayData)) + static_cast<qint64>(data.capacity() + 1);
+}
+
+// only values holding a string own heap data that is counted; other types are considered to be stored inline
+inline qint64 ofVariant(const QVariant& val)
+{
+    if(val.userType() == QMetaType::QString)
+        return ofString(val.toString());
+    return 0;
+}
+
+template<typename T>
+qint64 ofVector(const QVector<T>& vec)
+{
+    if(vec.capacity() == 0)
+        return 0;
+    return static_cast<qint64>(sizeof(QArrayData)) + static_cast<qint64>(vec.capacity()) * static_cast<qint64>(sizeof(T));
+}
+
+template<typename T, int ChunkShift>
+qint64 ofChunkedVector(const ChunkedVector<T, ChunkShift>& vec)
+{
+    if(vec.getNumChunk() == 0)
+        return 0;
+    // chunk directory + each chunk
+    qint64 usage = static_cast<qint64>(sizeof(QArrayData)) + static_cast<qint64>(vec.getNumChunk()) * static_cast<qint64>(sizeof(QVector<T>));
+    for(int i = 0, n = vec.getNumChunk(); i < n; ++i){
+        usage += ofVector(vec.getChunk(i));
+    }
+    return usage;
+}
+
+template<typename T>
+qint64 ofList(const QList<T>& list)
+{
+    // QList stores a pointer per item; items larger than a pointer are allocated separately
+    if(list.isEmpty())
+        return 0;
+    qint64 itemSize = static_cast<qint64>(sizeof(void*));
+    if(sizeof(T) > sizeof(void*)){
+        itemSize += static_cast<qint64>(sizeof(T));
+    }
+    return static_cast<qint64>(sizeof(QArrayData)) + static_cast<qint64>(list.size()) * itemSize;
+}
+
+template<typename K, typename V>
+qint64 ofHash(const QHash<K,V>& hash)
+{
+    // bucket array + one node (next, hash, key, value) per entry
+    return static_cast<qint64>(hash.capacity()) * static_cast<qint64>(sizeof(void*))
+         + static_cast<qint64>(hash.size()) * static_cast<qint64>(sizeof(void*) + sizeof(uint) + sizeof(K) + sizeof(V));
+}
+
+inline qint64 ofVariantList(const QList<QVariant>& list)
+{
+    qint64 usage = ofList(list);
+    for(const auto& val : list){
+        usage += ofVariant(val);
+    }
+    return usage;
+}
+
+}
+
+#endif // MEMORYUSAGE_H